@@ -13,20 +13,24 @@ else
 fi
 
 # Check if required variables are set
-if [ -z "$DOOR_WIFI_SSID" ] || [ -z "$DOOR_WIFI_PASSWORD" ] || [ -z "$DOOR_PHONE_BT_MAC" ] || [ -z "$DOOR_NTFY_URL" ]; then
+if [ -z "$DOOR_WIFI_SSID" ] || [ -z "$DOOR_WIFI_PASSWORD" ] || [ -z "$DOOR_PHONE_BT_MAC$DOOR_AUTHORIZED_DEVICES" ] || [ -z "$DOOR_NTFY_URL" ]; then
     echo "Error: Missing required environment variables in .env file"
-    echo "Required: DOOR_WIFI_SSID, DOOR_WIFI_PASSWORD, DOOR_PHONE_BT_MAC, DOOR_NTFY_URL"
+    echo "Required: DOOR_WIFI_SSID, DOOR_WIFI_PASSWORD, DOOR_PHONE_BT_MAC (or DOOR_AUTHORIZED_DEVICES), DOOR_NTFY_URL"
     exit 1
 fi
 
 echo "Building with credentials for SSID: $DOOR_WIFI_SSID"
 echo "Phone MAC: $DOOR_PHONE_BT_MAC"
+if [ -n "$DOOR_AUTHORIZED_DEVICES" ]; then
+    echo "Authorized devices: $DOOR_AUTHORIZED_DEVICES"
+fi
 
 # Generate sdkconfig.defaults from template with environment variables
 echo "Generating sdkconfig.defaults from template..."
 sed -e "s/__WIFI_SSID__/$DOOR_WIFI_SSID/g" \
     -e "s/__WIFI_PASSWORD__/$DOOR_WIFI_PASSWORD/g" \
     -e "s/__PHONE_BT_MAC__/$DOOR_PHONE_BT_MAC/g" \
+    -e "s|__AUTHORIZED_DEVICES__|$DOOR_AUTHORIZED_DEVICES|g" \
     -e "s|__NTFY_URL__|$DOOR_NTFY_URL|g" \
     sdkconfig.defaults.template > sdkconfig.defaults.tmp
 
@@ -0,0 +1,778 @@
+/**
+ * Host simulation of the door monitor pipeline.
+ *
+ * Replays reed switch edges - from a trace file or a generated scenario -
+ * through the same debounce filter, batch window, batcher, record packing,
+ * retry backlog and delivery decisions the firmware uses, in virtual time.
+ * The delivery task of notifier.c is an event handler driving delivery.c;
+ * the sensor loop of door_monitor.c - batch timers, held entries and submit
+ * - is modelled around the shared batching code, so changes to that
+ * sequencing have to be made here as well. GPIO, Bluetooth, WiFi and the
+ * clock are stand-ins:
+ *   - GPIO: the edge trace, one line per edge: <time_ms> <channel> <level>
+ *     (level 1 = open, '#' starts a comment)
+ *   - Bluetooth: every probe answers at once, a phone is present with
+ *     probability -p, so notifications are never held for a probe
+ *   - WiFi: online except during the -o windows
+ *   - ntfy: a latency/failure model, or a real HTTP server (mock_ntfy) with -u
+ *
+ * Reports events per second of CPU time, latency percentiles from the first
+ * edge of a notification to its delivery and from submit to delivery, and
+ * every place a notification can be lost.
+ *
+ *   door_sim [-t trace | -g normal|busy|rattle] [options]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include "debounce.h"
+#include "batcher.h"
+#include "batch_window.h"
+#include "door_record.h"
+#include "delivery.h"
+#include "ntfy_http.h"
+
+// Firmware defaults (see Kconfig.projbuild and door_monitor.c)
+#define SIM_DEBOUNCE_SETTLE_MS 50
+#define SIM_DEBOUNCE_MIN_HOLD_MS 250
+#define SIM_BATCH_WINDOW_PERCENTILE 90
+#define SIM_BATCH_WINDOW_MIN_MS 5000
+#define SIM_BATCH_WINDOW_MAX_MS 60000
+#define SIM_RUN_FLUSH_CHECK_MS 250
+#define SIM_NOTIFY_QUEUE_LEN 8
+#define SIM_FLUSH_MAX_BYTES 1024
+#define SIM_SEND_GAP_MS 500
+
+#define SIM_MAX_CHANNELS 8
+#define SIM_MAX_OFFLINE 8
+#define SIM_EPOCH 1767225600LL          // Wall clock at virtual time zero (2026-01-01 UTC)
+#define SIM_DRAIN_LIMIT_US (24LL * 3600 * 1000000)  // Give up this long after the last edge
+#define NEVER INT64_MAX
+
+#define DOOR_OPEN 1
+#define DOOR_CLOSED 0
+
+// One raw reed switch edge
+typedef struct {
+    int64_t time_us;
+    uint8_t channel;
+    uint8_t level;
+} sim_edge_t;
+
+// One reed switch with its firmware state
+typedef struct {
+    debounce_t debounce;
+    batch_window_t window;
+    batcher_t batch;
+    int door_state;
+    int64_t opened_ms;
+    int64_t timer_at;               // Batch timer expiry, NEVER if stopped
+} sim_channel_t;
+
+// Notification waiting in the submit queue or the backlog
+typedef struct {
+    door_record_t record;
+    uint32_t id;                    // Index into messages[]
+} sim_queued_t;
+
+// Bookkeeping for one submitted notification
+typedef struct {
+    int64_t first_edge_us;          // First edge of the batch entry
+    int64_t submit_us;
+} sim_message_t;
+
+typedef enum {
+    PHASE_WAITING,                  // Blocked on the submit queue, with a retry timeout if backlog is left
+    PHASE_SENDING,                  // A request is on the wire
+    PHASE_GAP,                      // Pause between backlog messages
+} delivery_phase_t;
+
+// Growable array of int64_t
+typedef struct {
+    int64_t* items;
+    size_t count;
+    size_t capacity;
+} sim_vec_t;
+
+// Options
+static double presence_rate = 0.8;
+static double latency_ms = 300;
+static double jitter_ms = 200;
+static double fail_rate = 0.0;
+static bool coalesce = true;
+static bool verbose = false;
+static int64_t offline_start_us[SIM_MAX_OFFLINE];
+static int64_t offline_end_us[SIM_MAX_OFFLINE];
+static int offline_count = 0;
+static ntfy_http_t http;
+static bool use_http = false;
+
+// Input
+static sim_edge_t* edges = NULL;
+static size_t edge_count = 0;
+static size_t edge_capacity = 0;
+
+// Sensor side
+static sim_channel_t channels[SIM_MAX_CHANNELS];
+static int channel_count = 1;
+static sim_vec_t edge_times;        // Committed edge time by probe ticket - 1
+static uint8_t* ticket_person = NULL;
+static size_t ticket_person_capacity = 0;
+
+// Delivery side
+static sim_queued_t submit_queue[SIM_NOTIFY_QUEUE_LEN];
+static int submit_head = 0;
+static int submit_count = 0;
+static delivery_t delivery;
+static delivery_phase_t phase = PHASE_WAITING;
+static int64_t delivery_at = NEVER;     // Send completes, gap ends or retry timeout passes
+static int64_t delivery_now_us = 0;     // Virtual time for the delivery hooks
+static bool send_ok = false;
+static sim_message_t* messages = NULL;
+static size_t message_count = 0;
+static size_t message_capacity = 0;
+static char body[SIM_FLUSH_MAX_BYTES + 1];
+
+// Results
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+static unsigned long door_events = 0;
+static unsigned long rejected = 0;
+static unsigned long evicted = 0;
+static unsigned long delivered = 0;
+static unsigned long publishes = 0;
+static unsigned long attempts = 0;
+static unsigned long failed_attempts = 0;
+static sim_vec_t alert_latency;
+static sim_vec_t delivery_latency;
+
+/**
+ * Append to a growable array, exiting if memory runs out
+ */
+static void *grow(void* items, size_t* capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) {
+        return items;
+    }
+    size_t capacity_new = *capacity ? *capacity * 2 : 256;
+    while (capacity_new < needed) {
+        capacity_new *= 2;
+    }
+    items = realloc(items, capacity_new * item_size);
+    if (items == NULL) {
+        fprintf(stderr, "door_sim: out of memory\n");
+        exit(1);
+    }
+    *capacity = capacity_new;
+    return items;
+}
+
+static void vec_push(sim_vec_t* vec, int64_t value) {
+    vec->items = grow(vec->items, &vec->capacity, vec->count + 1, sizeof(int64_t));
+    vec->items[vec->count++] = value;
+}
+
+/**
+ * xorshift64* - reproducible for a given seed on every host
+ */
+static double uniform(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 0x2545f4914f6cdd1dULL) >> 11) / 9007199254740992.0;
+}
+
+static double uniform_range(double lo, double hi) {
+    return lo + (hi - lo) * uniform();
+}
+
+static double exponential(double mean) {
+    return -mean * log(1.0 - uniform());
+}
+
+static double lognormal(double median, double sigma) {
+    // Box-Muller
+    double z = sqrt(-2.0 * log(1.0 - uniform())) * cos(2.0 * M_PI * uniform());
+    return median * exp(sigma * z);
+}
+
+static void add_edge(int64_t time_us, int channel, int level) {
+    edges = grow(edges, &edge_capacity, edge_count + 1, sizeof(sim_edge_t));
+    edges[edge_count++] = (sim_edge_t){ .time_us = time_us, .channel = (uint8_t)channel, .level = (uint8_t)level };
+}
+
+static int compare_edges(const void* a, const void* b) {
+    int64_t ta = ((const sim_edge_t*)a)->time_us;
+    int64_t tb = ((const sim_edge_t*)b)->time_us;
+    return (ta > tb) - (ta < tb);
+}
+
+static int compare_int64(const void* a, const void* b) {
+    int64_t va = *(const int64_t*)a;
+    int64_t vb = *(const int64_t*)b;
+    return (va > vb) - (va < vb);
+}
+
+/**
+ * Load a trace file: <time_ms> <channel> <level> per line
+ */
+static bool load_trace(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char* hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        double time_ms;
+        int channel, level;
+        int fields = sscanf(line, "%lf %d %d", &time_ms, &channel, &level);
+        if (fields <= 0) {
+            continue;
+        }
+        if (fields != 3 || channel < 0 || channel >= SIM_MAX_CHANNELS || (level != 0 && level != 1)) {
+            fprintf(stderr, "%s:%d: expected <time_ms> <channel 0-%d> <level 0|1>\n", path, line_no,
+                    SIM_MAX_CHANNELS - 1);
+            fclose(f);
+            return false;
+        }
+        add_edge((int64_t)(time_ms * 1000), channel, level);
+        if (channel >= channel_count) {
+            channel_count = channel + 1;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/**
+ * One mechanical transition - the real edge followed by contact bounce
+ */
+static void generate_transition(int64_t t_us, int channel, int level) {
+    int bounces = (int)uniform_range(0, 5);
+    for (int i = 0; i < bounces; i++) {
+        add_edge(t_us, channel, level);
+        t_us += (int64_t)uniform_range(200, 2000);
+        add_edge(t_us, channel, !level);
+        t_us += (int64_t)uniform_range(200, 2000);
+    }
+    add_edge(t_us, channel, level);
+}
+
+/**
+ * Generate a scenario:
+ *   normal - visits a few minutes apart, most doors closed within seconds, some left open
+ *   busy   - bursts of rapid open/close cycles (a door propped by traffic)
+ *   rattle - normal visits plus wind rattle blips the debounce filter must reject
+ */
+static bool generate(const char* scenario, int count) {
+    int64_t t_us = 1000000;
+
+    for (int i = 0; i < count; i++) {
+        int channel = (int)uniform_range(0, channel_count);
+
+        if (strcmp(scenario, "busy") == 0) {
+            int cycles = (int)uniform_range(20, 60);
+            for (int c = 0; c < cycles; c++) {
+                generate_transition(t_us, channel, DOOR_OPEN);
+                t_us += (int64_t)(uniform_range(0.8, 1.5) * 1e6);
+                generate_transition(t_us, channel, DOOR_CLOSED);
+                t_us += (int64_t)(uniform_range(0.7, 1.5) * 1e6);
+            }
+            t_us += (int64_t)(uniform_range(30, 120) * 1e6);
+            continue;
+        }
+
+        if (strcmp(scenario, "rattle") == 0 && uniform() < 0.5) {
+            // Blip shorter than the minimum hold time
+            add_edge(t_us, channel, DOOR_OPEN);
+            add_edge(t_us + (int64_t)uniform_range(20, 200) * 1000, channel, DOOR_CLOSED);
+            t_us += (int64_t)(exponential(20) * 1e6) + 1000000;
+            continue;
+        }
+        if (strcmp(scenario, "normal") != 0 && strcmp(scenario, "rattle") != 0) {
+            fprintf(stderr, "door_sim: unknown scenario '%s'\n", scenario);
+            return false;
+        }
+
+        double roll = uniform();
+        double open_s = (roll < 0.80) ? lognormal(6, 0.5) :
+                        (roll < 0.95) ? uniform_range(20, 40) : uniform_range(120, 600);
+        generate_transition(t_us, channel, DOOR_OPEN);
+        t_us += (int64_t)(open_s * 1e6);
+        generate_transition(t_us, channel, DOOR_CLOSED);
+        t_us += (int64_t)(exponential(120) * 1e6) + 1000000;
+    }
+
+    // Bounce sequences of different channels may interleave
+    qsort(edges, edge_count, sizeof(sim_edge_t), compare_edges);
+    return true;
+}
+
+/**
+ * Write the edges in trace format
+ */
+static bool write_trace(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "# time_ms channel level\n");
+    for (size_t i = 0; i < edge_count; i++) {
+        fprintf(f, "%.3f %d %d\n", edges[i].time_us / 1000.0, edges[i].channel, edges[i].level);
+    }
+    fclose(f);
+    return true;
+}
+
+static int64_t wall_ms(int64_t t_us) {
+    return SIM_EPOCH * 1000 + t_us / 1000;
+}
+
+static bool network_online(int64_t now_us) {
+    for (int i = 0; i < offline_count; i++) {
+        if (now_us >= offline_start_us[i] && now_us < offline_end_us[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ---- Delivery task (notifier.c) ---- */
+
+static void delivery_loop_top(int64_t now_us);
+
+/**
+ * Whether door_monitor.c would see delivery as busy
+ */
+static bool delivery_busy(void) {
+    return submit_count > 0 || phase == PHASE_SENDING || delivery.backlog.count > 0;
+}
+
+/**
+ * Delivery hook - log_seq has no flash log to point into here, it carries the message id
+ */
+static void message_delivered(void* ctx, const backlog_entry_t* entry) {
+    delivered++;
+    vec_push(&alert_latency, delivery_now_us - messages[entry->log_seq].first_edge_us);
+    vec_push(&delivery_latency, delivery_now_us - messages[entry->log_seq].submit_us);
+}
+
+static void message_evicted(void* ctx, const backlog_entry_t* entry) {
+    evicted++;
+}
+
+/**
+ * Put a request on the wire - modelled, or posted to the HTTP server
+ */
+static void start_send(int64_t now_us, const char* text) {
+    attempts++;
+    int64_t took_us;
+    if (use_http) {
+        struct timespec start, end;
+        int status;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        send_ok = ntfy_http_post(&http, text, &status);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        took_us = (end.tv_sec - start.tv_sec) * 1000000LL + (end.tv_nsec - start.tv_nsec) / 1000;
+    } else {
+        send_ok = uniform() >= fail_rate;
+        took_us = (int64_t)((latency_ms + uniform() * jitter_ms) * 1000);
+    }
+    if (!send_ok) {
+        failed_attempts++;
+    }
+    if (verbose) {
+        printf("%10.3f s  %s  %s\n", now_us / 1e6, send_ok ? "sent  " : "FAILED", text);
+    }
+
+    phase = PHASE_SENDING;
+    delivery_at = now_us + took_us;
+}
+
+/**
+ * Send whatever delivery.c picks next, or go back to the submit queue
+ */
+static void delivery_send_next(int64_t now_us) {
+    delivery_send_t send;
+    if (!delivery_next(&delivery, network_online(now_us), &send)) {
+        delivery_loop_top(now_us);
+        return;
+    }
+
+    // ntfy has a window of one - a single record or the coalesced backlog head
+    if (send.body == NULL) {
+        door_record_render(&send.entries[0]->record, body, sizeof(body));
+    }
+    start_send(now_us, send.body ? send.body : body);
+}
+
+/**
+ * A send finished
+ */
+static void delivery_send_done(int64_t now_us) {
+    if (send_ok) {
+        publishes++;
+    }
+    delivery_now_us = now_us;
+    if (delivery_sent(&delivery, send_ok ? 1 : 0, network_online(now_us))) {
+        phase = PHASE_GAP;
+        delivery_at = now_us + SIM_SEND_GAP_MS * 1000LL;
+        return;
+    }
+    delivery_loop_top(now_us);
+}
+
+/**
+ * Top of the delivery task loop - take the next record or wait
+ */
+static void delivery_loop_top(int64_t now_us) {
+    if (submit_count > 0) {
+        sim_queued_t queued = submit_queue[submit_head];
+        submit_head = (submit_head + 1) % SIM_NOTIFY_QUEUE_LEN;
+        submit_count--;
+
+        backlog_entry_t entry = { .record = queued.record, .log_seq = queued.id };
+        delivery_receive(&delivery, &entry);
+        delivery_send_next(now_us);
+        return;
+    }
+
+    uint32_t wait_ms = delivery_wait_ms(&delivery);
+    phase = PHASE_WAITING;
+    delivery_at = (wait_ms == DELIVERY_WAIT_FOREVER) ? NEVER : now_us + wait_ms * 1000LL;
+}
+
+/**
+ * Timed delivery event - send done, gap over or retry timeout
+ */
+static void delivery_timeout(int64_t now_us) {
+    switch (phase) {
+    case PHASE_SENDING:
+        delivery_send_done(now_us);
+        break;
+    case PHASE_GAP:
+        delivery_send_next(now_us);
+        break;
+    case PHASE_WAITING:
+        delivery_wake(&delivery);
+        delivery_send_next(now_us);
+        break;
+    }
+}
+
+/* ---- Sensor loop (door_monitor.c) ---- */
+
+/**
+ * Hand a batch entry to the delivery task (notifier_submit)
+ */
+static void submit_entry(const batch_entry_t* entry, int channel, int64_t now_us) {
+    uint8_t person = (entry->probe_ticket != 0) ? ticket_person[entry->probe_ticket - 1] : 0;
+    door_record_t record = door_record_from_entry(entry, (uint8_t)channel, person);
+
+    if (submit_count >= SIM_NOTIFY_QUEUE_LEN) {
+        rejected++;
+        return;
+    }
+
+    messages = grow(messages, &message_capacity, message_count + 1, sizeof(sim_message_t));
+    messages[message_count] = (sim_message_t){
+        .first_edge_us = (entry->probe_ticket != 0) ? edge_times.items[entry->probe_ticket - 1] : now_us,
+        .submit_us = now_us,
+    };
+    submit_queue[(submit_head + submit_count) % SIM_NOTIFY_QUEUE_LEN] =
+        (sim_queued_t){ .record = record, .id = (uint32_t)message_count };
+    message_count++;
+    submit_count++;
+
+    if (phase == PHASE_WAITING) {
+        delivery_loop_top(now_us);
+    }
+}
+
+static void update_batch_timer(sim_channel_t* channel, int64_t now_us) {
+    channel->timer_at = (channel->batch.count == 0) ? NEVER :
+                        now_us + batch_window_timeout_ms(&channel->window) * 1000LL;
+}
+
+/**
+ * A debounced door state change (handle_door_change + add_event_to_batch)
+ */
+static void door_change(int index, int door_state, int64_t edge_us, int64_t now_us) {
+    sim_channel_t* channel = &channels[index];
+    if (door_state == channel->door_state) {
+        return;
+    }
+    channel->door_state = door_state;
+    door_events++;
+
+    int64_t when_ms = wall_ms(edge_us);
+    if (door_state == DOOR_OPEN) {
+        channel->opened_ms = when_ms;
+    } else if (channel->opened_ms != 0) {
+        batch_window_add(&channel->window, (uint32_t)(when_ms - channel->opened_ms));
+        channel->opened_ms = 0;
+    }
+
+    // Every edge starts a probe; here the ticket also finds the edge time again
+    vec_push(&edge_times, edge_us);
+    ticket_person = grow(ticket_person, &ticket_person_capacity, edge_times.count, 1);
+    ticket_person[edge_times.count - 1] = (uniform() < presence_rate) ? 1 : 0;
+    uint32_t ticket = (uint32_t)edge_times.count;
+
+    batch_entry_t entry;
+    if (batcher_add(&channel->batch, door_state == DOOR_OPEN, (uint32_t)(when_ms / 1000), TIME_QUALITY_SYNCED, ticket,
+                    &entry)) {
+        submit_entry(&entry, index, now_us);
+    }
+    if (door_state == DOOR_CLOSED && batcher_take_pair(&channel->batch, delivery_busy(), &entry)) {
+        submit_entry(&entry, index, now_us);
+    }
+    update_batch_timer(channel, now_us);
+}
+
+/**
+ * Main loop housekeeping - debounce commits, batch timers, held entries
+ */
+static void sensor_poll(int64_t now_us) {
+    for (int i = 0; i < channel_count; i++) {
+        sim_channel_t* channel = &channels[i];
+        int level;
+        int64_t since_us;
+        if (debounce_poll(&channel->debounce, now_us, &level, &since_us)) {
+            door_change(i, level, since_us, now_us);
+        }
+
+        batch_entry_t entry;
+        if (channel->timer_at <= now_us) {
+            channel->timer_at = NEVER;
+            while (batcher_pop_oldest(&channel->batch, &entry)) {
+                submit_entry(&entry, i, now_us);
+            }
+        }
+        if (batcher_take_held(&channel->batch, delivery_busy(), &entry)) {
+            submit_entry(&entry, i, now_us);
+            update_batch_timer(channel, now_us);
+        }
+    }
+}
+
+/**
+ * Earliest time the sensor loop has work to do
+ */
+static int64_t sensor_next(int64_t now_us) {
+    int64_t next = NEVER;
+    for (int i = 0; i < channel_count; i++) {
+        int64_t deadline = debounce_deadline(&channels[i].debounce);
+        if (deadline >= 0 && deadline < next) {
+            next = deadline;
+        }
+        if (channels[i].timer_at < next) {
+            next = channels[i].timer_at;
+        }
+        if (batcher_held(&channels[i].batch) && now_us + SIM_RUN_FLUSH_CHECK_MS * 1000LL < next) {
+            next = now_us + SIM_RUN_FLUSH_CHECK_MS * 1000LL;
+        }
+    }
+    return next;
+}
+
+/**
+ * Run the event loop until the trace is replayed and delivery is idle
+ */
+static int64_t run(void) {
+    int64_t now_us = 0;
+    size_t next_edge = 0;
+    int64_t give_up_us = (edge_count ? edges[edge_count - 1].time_us : 0) + SIM_DRAIN_LIMIT_US;
+
+    for (int i = 0; i < channel_count; i++) {
+        sim_channel_t* channel = &channels[i];
+        debounce_init(&channel->debounce, SIM_DEBOUNCE_SETTLE_MS, SIM_DEBOUNCE_MIN_HOLD_MS);
+        batch_window_init(&channel->window, SIM_BATCH_WINDOW_PERCENTILE, SIM_BATCH_WINDOW_MIN_MS,
+                          SIM_BATCH_WINDOW_MAX_MS);
+        batcher_init(&channel->batch);
+        channel->door_state = DOOR_CLOSED;
+        channel->timer_at = NEVER;
+        // Boot with every door closed, like the firmware seeding its filters
+        debounce_feed(&channel->debounce, DOOR_CLOSED, 0);
+    }
+    static const delivery_hooks_t hooks = { .delivered = message_delivered, .evicted = message_evicted };
+    delivery_init(&delivery, 1, coalesce ? body : NULL, SIM_FLUSH_MAX_BYTES, &hooks);
+
+    while (1) {
+        int64_t next = sensor_next(now_us);
+        if (delivery_at < next) {
+            next = delivery_at;
+        }
+        if (next_edge < edge_count && edges[next_edge].time_us < next) {
+            next = edges[next_edge].time_us;
+        }
+        if (next == NEVER || next > give_up_us) {
+            break;
+        }
+        now_us = (next > now_us) ? next : now_us;
+
+        while (next_edge < edge_count && edges[next_edge].time_us <= now_us) {
+            sim_edge_t* edge = &edges[next_edge++];
+            debounce_feed(&channels[edge->channel].debounce, edge->level, edge->time_us);
+        }
+        if (delivery_at <= now_us) {
+            delivery_timeout(now_us);
+        }
+        sensor_poll(now_us);
+    }
+    return now_us;
+}
+
+/**
+ * Print p50/p90/p99/max of a latency set in milliseconds
+ */
+static void print_percentiles(const char* label, sim_vec_t* vec) {
+    if (vec->count == 0) {
+        printf("%-18s none\n", label);
+        return;
+    }
+    qsort(vec->items, vec->count, sizeof(int64_t), compare_int64);
+    size_t n = vec->count;
+    printf("%-18s p50 %8.1f ms   p90 %8.1f ms   p99 %8.1f ms   max %8.1f ms\n", label,
+           vec->items[n / 2] / 1000.0, vec->items[(n * 9) / 10] / 1000.0,
+           vec->items[(n * 99) / 100] / 1000.0, vec->items[n - 1] / 1000.0);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s (-t trace | -g normal|busy|rattle) [options]\n"
+            "  -t file       replay edges from a trace file (<time_ms> <channel> <level> per line)\n"
+            "  -g scenario   generate edges: normal, busy or rattle\n"
+            "  -n count      visits or bursts to generate (default 1000)\n"
+            "  -C channels   sensor channels to generate for (default 1)\n"
+            "  -w file       write the edges replayed to a trace file\n"
+            "  -s seed       random seed (default 1)\n"
+            "  -p rate       chance an authorized phone answers a probe (default 0.8)\n"
+            "  -l ms         modelled ntfy latency (default 300)\n"
+            "  -j ms         modelled ntfy latency jitter (default 200)\n"
+            "  -f rate       modelled ntfy failure rate (default 0)\n"
+            "  -o start:len  WiFi offline from start s for len s (repeatable)\n"
+            "  -u url        post to a real HTTP server instead, e.g. http://127.0.0.1:8080/door\n"
+            "  -x            send the backlog one message at a time (no coalescing)\n"
+            "  -v            print every send\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    const char* trace = NULL;
+    const char* scenario = NULL;
+    const char* write_path = NULL;
+    int count = 1000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:g:n:C:w:s:p:l:j:f:o:u:xv")) != -1) {
+        switch (opt) {
+        case 't': trace = optarg; break;
+        case 'g': scenario = optarg; break;
+        case 'n': count = atoi(optarg); break;
+        case 'C':
+            channel_count = atoi(optarg);
+            if (channel_count < 1 || channel_count > SIM_MAX_CHANNELS) {
+                fprintf(stderr, "door_sim: 1 to %d channels\n", SIM_MAX_CHANNELS);
+                return 2;
+            }
+            break;
+        case 'w': write_path = optarg; break;
+        case 's': rng_state ^= strtoull(optarg, NULL, 10) * 0xbf58476d1ce4e5b9ULL; break;
+        case 'p': presence_rate = atof(optarg); break;
+        case 'l': latency_ms = atof(optarg); break;
+        case 'j': jitter_ms = atof(optarg); break;
+        case 'f': fail_rate = atof(optarg); break;
+        case 'o': {
+            double start_s, len_s;
+            if (offline_count == SIM_MAX_OFFLINE || sscanf(optarg, "%lf:%lf", &start_s, &len_s) != 2) {
+                fprintf(stderr, "door_sim: -o start_s:length_s, up to %d windows\n", SIM_MAX_OFFLINE);
+                return 2;
+            }
+            offline_start_us[offline_count] = (int64_t)(start_s * 1e6);
+            offline_end_us[offline_count++] = (int64_t)((start_s + len_s) * 1e6);
+            break;
+        }
+        case 'u':
+            if (!ntfy_http_init(&http, optarg)) {
+                fprintf(stderr, "door_sim: only plain http://host[:port]/path URLs are supported\n");
+                return 2;
+            }
+            use_http = true;
+            break;
+        case 'x': coalesce = false; break;
+        case 'v': verbose = true; break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((trace == NULL) == (scenario == NULL)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (trace ? !load_trace(trace) : !generate(scenario, count)) {
+        return 1;
+    }
+    if (write_path && !write_trace(write_path)) {
+        return 1;
+    }
+
+    // Render times the same everywhere
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    static char names[SIM_MAX_CHANNELS][16];
+    for (int i = 0; i < channel_count; i++) {
+        snprintf(names[i], sizeof(names[i]), channel_count == 1 ? "Door" : "Door %d", i + 1);
+        door_record_set_channel_name((uint8_t)i, names[i]);
+    }
+    door_record_set_person_name(1, "Alice");
+
+    clock_t cpu_start = clock();
+    int64_t end_us = run();
+    double cpu_s = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    unsigned long glitches = 0, bounces = 0, merged = 0, batch_evicted = 0;
+    for (int i = 0; i < channel_count; i++) {
+        glitches += channels[i].debounce.glitches;
+        bounces += channels[i].debounce.bounces;
+        merged += channels[i].batch.merged;
+        batch_evicted += channels[i].batch.evicted;
+    }
+    unsigned long undelivered = (unsigned long)(message_count - delivered);
+
+    printf("Edges             %zu raw, %lu bounces absorbed, %lu glitches rejected\n", edge_count, bounces, glitches);
+    printf("Door events       %lu committed, %lu cycles merged into runs, %lu batch entries evicted early\n",
+           door_events, merged, batch_evicted);
+    printf("Notifications     %zu submitted, %lu delivered in %lu publishes\n", message_count, delivered, publishes);
+    printf("Losses            %lu rejected (queue full), %lu evicted (backlog full), %lu undelivered at end\n",
+           rejected, evicted, undelivered);
+    printf("Sends             %lu attempts, %lu failed\n", attempts, failed_attempts);
+    print_percentiles("Edge to delivery", &alert_latency);
+    print_percentiles("Submit to delivery", &delivery_latency);
+    for (int i = 0; i < channel_count; i++) {
+        printf("Batch window      %s: %lu ms\n", names[i],
+               (unsigned long)batch_window_timeout_ms(&channels[i].window));
+    }
+    printf("Simulated         %.1f h in %.3f s CPU (%.0f events/s)\n", end_us / 3.6e9, cpu_s,
+           cpu_s > 0 ? door_events / cpu_s : 0.0);
+
+    if (use_http) {
+        ntfy_http_close(&http);
+    }
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * Local stand-in for an ntfy server.
+ *
+ * Accepts plain HTTP POSTs on any path, one keep-alive connection at a
+ * time, and answers each after a configurable latency. A share of requests
+ * can be refused with 500 or have the connection dropped without an answer,
+ * to exercise the retry backlog. Prints every message it receives and a
+ * summary on Ctrl-C.
+ *
+ *   mock_ntfy [-p port] [-l latency_ms] [-j jitter_ms] [-f fail_rate] [-d drop_rate] [-s seed] [-q]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define REQUEST_MAX 8192
+
+static volatile sig_atomic_t stop = 0;
+
+static unsigned long received = 0;
+static unsigned long answered = 0;
+static unsigned long failed = 0;
+static unsigned long dropped = 0;
+
+/**
+ * Ctrl-C - stop accepting and print the summary
+ */
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+/**
+ * Uniform random number in [0, 1)
+ */
+static double uniform(void) {
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+/**
+ * Sleep for a number of milliseconds
+ */
+static void sleep_ms(long ms) {
+    if (ms <= 0) {
+        return;
+    }
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Read one request into buf and return its body, NULL once the connection is done
+ * (requests are not pipelined - the client waits for each answer)
+ */
+static char* read_request(int fd, char* buf) {
+    size_t len = 0;
+    char* body = NULL;
+
+    while (1) {
+        buf[len] = '\0';
+        body = strstr(buf, "\r\n\r\n");
+        if (body != NULL) {
+            break;
+        }
+        if (len == REQUEST_MAX) {
+            return NULL;
+        }
+        ssize_t got = recv(fd, buf + len, REQUEST_MAX - len, 0);
+        if (got <= 0) {
+            return NULL;
+        }
+        len += got;
+    }
+    body += 4;
+
+    size_t content_length = 0;
+    for (char* line = strstr(buf, "\r\n"); line != NULL && line + 2 < body; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            content_length = strtoul(line + 17, NULL, 10);
+        }
+    }
+    if ((size_t)(body - buf) + content_length > REQUEST_MAX) {
+        return NULL;
+    }
+    while (len < (size_t)(body - buf) + content_length) {
+        ssize_t got = recv(fd, buf + len, REQUEST_MAX - len, 0);
+        if (got <= 0) {
+            return NULL;
+        }
+        len += got;
+    }
+
+    body[content_length] = '\0';
+    return body;
+}
+
+/**
+ * Answer requests on one connection until the client closes it
+ */
+static void serve(int fd, long latency_ms, long jitter_ms, double fail_rate, double drop_rate, int quiet) {
+    static char buf[REQUEST_MAX + 1];
+
+    while (!stop) {
+        char* body = read_request(fd, buf);
+        if (body == NULL) {
+            return;
+        }
+        received++;
+
+        sleep_ms(latency_ms + (jitter_ms > 0 ? (long)(uniform() * jitter_ms) : 0));
+
+        double roll = uniform();
+        if (roll < drop_rate) {
+            dropped++;
+            if (!quiet) {
+                printf("[%lu] dropped\n", received);
+            }
+            return;
+        }
+
+        int status = (roll < drop_rate + fail_rate) ? 500 : 200;
+        char reply[256];
+        const char* payload = (status == 200) ? "{\"event\":\"message\"}" : "{\"error\":\"mock failure\"}";
+        int reply_len = snprintf(reply, sizeof(reply),
+                                 "HTTP/1.1 %d %s\r\n"
+                                 "Content-Type: application/json\r\n"
+                                 "Content-Length: %zu\r\n"
+                                 "\r\n%s",
+                                 status, status == 200 ? "OK" : "Internal Server Error", strlen(payload), payload);
+        if (send(fd, reply, reply_len, MSG_NOSIGNAL) != reply_len) {
+            return;
+        }
+
+        if (status == 200) {
+            answered++;
+        } else {
+            failed++;
+        }
+        if (!quiet) {
+            printf("[%lu] %d: %s\n", received, status, body);
+            fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int port = 8080;
+    long latency_ms = 100;
+    long jitter_ms = 0;
+    double fail_rate = 0.0;
+    double drop_rate = 0.0;
+    unsigned seed = (unsigned)time(NULL);
+    int quiet = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:l:j:f:d:s:q")) != -1) {
+        switch (opt) {
+        case 'p': port = atoi(optarg); break;
+        case 'l': latency_ms = atol(optarg); break;
+        case 'j': jitter_ms = atol(optarg); break;
+        case 'f': fail_rate = atof(optarg); break;
+        case 'd': drop_rate = atof(optarg); break;
+        case 's': seed = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'q': quiet = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-l latency_ms] [-j jitter_ms] [-f fail_rate] "
+                            "[-d drop_rate] [-s seed] [-q]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 4) != 0) {
+        perror("mock_ntfy: bind");
+        return 1;
+    }
+    printf("mock_ntfy listening on http://127.0.0.1:%d/ (latency %ld+%ld ms, fail %.2f, drop %.2f)\n",
+           port, latency_ms, jitter_ms, fail_rate, drop_rate);
+    fflush(stdout);
+
+    while (!stop) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        serve(fd, latency_ms, jitter_ms, fail_rate, drop_rate, quiet);
+        close(fd);
+    }
+
+    close(listen_fd);
+    printf("\n%lu requests: %lu answered 200, %lu failed with 500, %lu dropped\n",
+           received, answered, failed, dropped);
+    return 0;
+}
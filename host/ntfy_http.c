@@ -0,0 +1,199 @@
+#include "ntfy_http.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define RESPONSE_MAX 4096
+
+/**
+ * Parse an http://host[:port]/path URL
+ */
+bool ntfy_http_init(ntfy_http_t* client, const char* url) {
+    client->fd = -1;
+    if (strncmp(url, "http://", 7) != 0) {
+        return false;
+    }
+    const char* host = url + 7;
+    const char* path = strchr(host, '/');
+    size_t host_len = path ? (size_t)(path - host) : strlen(host);
+    if (path == NULL) {
+        path = "/";
+    }
+    const char* colon = memchr(host, ':', host_len);
+    size_t name_len = colon ? (size_t)(colon - host) : host_len;
+    size_t port_len = colon ? host_len - name_len - 1 : 2;
+
+    if (name_len == 0 || name_len >= sizeof(client->host) || port_len >= sizeof(client->port) ||
+        strlen(path) >= sizeof(client->path)) {
+        return false;
+    }
+    memcpy(client->host, host, name_len);
+    client->host[name_len] = '\0';
+    if (colon) {
+        memcpy(client->port, colon + 1, port_len);
+        client->port[port_len] = '\0';
+    } else {
+        strcpy(client->port, "80");
+    }
+    strcpy(client->path, path);
+    return true;
+}
+
+/**
+ * Open a connection to the server
+ */
+static bool http_connect(ntfy_http_t* client) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* result;
+    if (getaddrinfo(client->host, client->port, &hints, &result) != 0) {
+        return false;
+    }
+
+    for (struct addrinfo* ai = result; ai != NULL; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            client->fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(result);
+    return client->fd >= 0;
+}
+
+/**
+ * Write the whole buffer
+ * @param written Set once any byte has been written
+ */
+static bool send_all(int fd, const char* data, size_t len, bool* written) {
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        *written = true;
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+/**
+ * Read one response and return its status code, 0 if the connection broke
+ */
+static int read_response(int fd) {
+    char buf[RESPONSE_MAX + 1];
+    size_t len = 0;
+    char* body = NULL;
+
+    while (body == NULL) {
+        if (len == RESPONSE_MAX) {
+            return 0;
+        }
+        ssize_t got = recv(fd, buf + len, RESPONSE_MAX - len, 0);
+        if (got <= 0) {
+            return 0;
+        }
+        len += got;
+        buf[len] = '\0';
+        body = strstr(buf, "\r\n\r\n");
+    }
+    body += 4;
+
+    int status = 0;
+    if (sscanf(buf, "HTTP/1.%*d %d", &status) != 1) {
+        return 0;
+    }
+
+    // Consume the body so the next response starts cleanly
+    size_t content_length = 0;
+    for (char* line = strstr(buf, "\r\n"); line != NULL && line + 2 < body; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            content_length = strtoul(line + 17, NULL, 10);
+        }
+    }
+    size_t have = len - (size_t)(body - buf);
+    while (have < content_length) {
+        char skip[512];
+        size_t want = content_length - have < sizeof(skip) ? content_length - have : sizeof(skip);
+        ssize_t got = recv(fd, skip, want, 0);
+        if (got <= 0) {
+            return 0;
+        }
+        have += got;
+    }
+    return status;
+}
+
+/**
+ * Send one request on the open connection
+ * @param written Set once any byte of the request has been written
+ */
+static int post_once(ntfy_http_t* client, const char* body, bool* written) {
+    char header[512];
+    size_t body_len = strlen(body);
+    int header_len = snprintf(header, sizeof(header),
+                              "POST %s HTTP/1.1\r\n"
+                              "Host: %s\r\n"
+                              "Content-Type: text/plain\r\n"
+                              "Title: Door Monitor\r\n"
+                              "Tags: door,security\r\n"
+                              "Content-Length: %zu\r\n"
+                              "\r\n",
+                              client->path, client->host, body_len);
+
+    if (!send_all(client->fd, header, header_len, written) || !send_all(client->fd, body, body_len, written)) {
+        return 0;
+    }
+    return read_response(client->fd);
+}
+
+/**
+ * Post one message body
+ */
+bool ntfy_http_post(ntfy_http_t* client, const char* body, int* status) {
+    bool reused = client->fd >= 0;
+    if (!reused && !http_connect(client)) {
+        *status = 0;
+        return false;
+    }
+
+    bool written = false;
+    *status = post_once(client, body, &written);
+
+    // The server may have closed an idle keep-alive socket - retry once on a
+    // fresh one, but only if nothing of the request was written. Once it was,
+    // the server may have acted on it, so fail rather than post twice.
+    if (*status == 0 && reused && !written) {
+        ntfy_http_close(client);
+        if (http_connect(client)) {
+            *status = post_once(client, body, &written);
+        }
+    }
+
+    if (*status != 200) {
+        ntfy_http_close(client);
+    }
+    return *status == 200;
+}
+
+/**
+ * Close the connection
+ */
+void ntfy_http_close(ntfy_http_t* client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
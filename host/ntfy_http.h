@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * Minimal blocking HTTP/1.1 client for posting to an ntfy server (or
+ * mock_ntfy) from the host simulation.
+ *
+ * Plain HTTP only. Like the firmware it keeps one keep-alive connection
+ * open, and retries once on a fresh socket when a reused one fails before
+ * any of the request was written. A request that failed after that is
+ * reported as failed, so the caller resends it rather than risk a duplicate.
+ */
+
+typedef struct {
+    char host[64];
+    char port[8];
+    char path[128];
+    int fd;                     // Open connection, -1 if none
+} ntfy_http_t;
+
+/**
+ * Parse an http://host[:port]/path URL
+ * @return false if the URL is not plain HTTP or too long
+ */
+bool ntfy_http_init(ntfy_http_t* client, const char* url);
+
+/**
+ * Post one message body
+ * @param status Set to the HTTP status code, 0 if no response arrived
+ * @return true if the server answered 200
+ */
+bool ntfy_http_post(ntfy_http_t* client, const char* body, int* status);
+
+/**
+ * Close the connection
+ */
+void ntfy_http_close(ntfy_http_t* client);
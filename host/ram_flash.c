@@ -0,0 +1,87 @@
+#include "ram_flash.h"
+#include <string.h>
+
+/**
+ * Take one step, or cut the power if the budget is spent
+ * @return false if the power is (now) off
+ */
+static bool step(ram_flash_t* flash) {
+    if (flash->dead) {
+        return false;
+    }
+    if (flash->budget == 0) {
+        flash->dead = true;
+        return false;
+    }
+    if (flash->budget > 0) {
+        flash->budget--;
+    }
+    flash->steps++;
+    return true;
+}
+
+static int ram_read(void* ctx, uint32_t offset, void* dst, size_t len) {
+    ram_flash_t* flash = ctx;
+    if (flash->dead || offset + len > flash->size) {
+        return -1;
+    }
+    memcpy(dst, flash->data + offset, len);
+    return 0;
+}
+
+static int ram_write(void* ctx, uint32_t offset, const void* src, size_t len) {
+    ram_flash_t* flash = ctx;
+    const uint8_t* bytes = src;
+    if (flash->dead || offset + len > flash->size) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!step(flash)) {
+            // Only some bits of the byte being programmed made it
+            flash->data[offset + i] &= bytes[i] | 0xf0;
+            return -1;
+        }
+        flash->data[offset + i] &= bytes[i];
+    }
+    return 0;
+}
+
+static int ram_erase(void* ctx, uint32_t offset, size_t len) {
+    ram_flash_t* flash = ctx;
+    if (flash->dead || offset + len > flash->size) {
+        return -1;
+    }
+    if (!step(flash)) {
+        memset(flash->data + offset, 0xff, len / 2);
+        return -1;
+    }
+    memset(flash->data + offset, 0xff, len);
+    return 0;
+}
+
+/**
+ * Wrap a buffer as flash, keeping its current contents
+ */
+void ram_flash_attach(ram_flash_t* flash, uint8_t* data, uint32_t sector_size, uint32_t sector_count,
+                      event_log_flash_t* ops) {
+    *flash = (ram_flash_t) {
+        .data = data,
+        .size = sector_size * sector_count,
+        .budget = -1,
+    };
+    *ops = (event_log_flash_t) {
+        .read = ram_read,
+        .write = ram_write,
+        .erase = ram_erase,
+        .ctx = flash,
+        .sector_size = sector_size,
+        .sector_count = sector_count,
+    };
+}
+
+/**
+ * Cut the power after budget more steps (-1 to never cut it)
+ */
+void ram_flash_cut_after(ram_flash_t* flash, int64_t budget) {
+    flash->budget = budget;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "event_log.h"
+
+/**
+ * NOR flash in RAM behind an event_log_flash_t, for host tests.
+ *
+ * Writes can only clear bits and erases set whole ranges back to 0xff, as
+ * on the real part. Power can be cut after a given number of steps - one
+ * step per byte programmed and per erase. The step that runs into the cut
+ * is left half done (a byte with only some bits cleared, a range only half
+ * erased) and every operation after it fails.
+ */
+
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+    int64_t budget;             // Steps left before the power cut, -1 for never
+    uint64_t steps;             // Steps done so far
+    bool dead;                  // Power is cut
+} ram_flash_t;
+
+/**
+ * Wrap a buffer as flash with sector_count sectors of sector_size bytes,
+ * keeping its current contents
+ */
+void ram_flash_attach(ram_flash_t* flash, uint8_t* data, uint32_t sector_size, uint32_t sector_count,
+                      event_log_flash_t* ops);
+
+/**
+ * Cut the power after budget more steps (-1 to never cut it)
+ */
+void ram_flash_cut_after(ram_flash_t* flash, int64_t budget);
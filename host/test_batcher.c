@@ -0,0 +1,199 @@
+/**
+ * Tests of the door event batcher (main/batcher.c): bursts folding into
+ * runs, eviction from a full ring, entries held while delivery is busy,
+ * and a randomized run driven the way the sensor loop drives it, checking
+ * that entries come out oldest first and no event is lost.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batcher.h"
+#include "check.h"
+
+/**
+ * Add one event, failing the test if the ring had to evict
+ */
+static void add(batcher_t* b, bool open, uint32_t timestamp) {
+    batch_entry_t evicted;
+    CHECK(!batcher_add(b, open, timestamp, 0, 0, &evicted), "unexpected eviction at %u", timestamp);
+}
+
+/**
+ * Door events an entry stands for
+ */
+static uint32_t entry_events(const batch_entry_t* entry) {
+    return (entry->kind == BATCH_CYCLES) ? 2u * entry->cycles : 1u;
+}
+
+/**
+ * Quick cycles while delivery is busy fold into one run
+ */
+static void test_burst(void) {
+    batcher_t b;
+    batch_entry_t entry;
+    batcher_init(&b);
+
+    for (uint32_t i = 0; i < 50; i++) {
+        add(&b, true, 100 + 2 * i);
+        add(&b, false, 101 + 2 * i);
+        CHECK(!batcher_take_pair(&b, true, &entry), "pair taken while delivery busy");
+    }
+    CHECK(b.count == 1 && b.merged == 49, "%u entries, %u merged", b.count, b.merged);
+    CHECK(batcher_held(&b), "run not held");
+    CHECK(!batcher_take_held(&b, true, &entry), "run taken while delivery busy");
+
+    CHECK(batcher_take_held(&b, false, &entry), "run not taken once idle");
+    CHECK(entry.kind == BATCH_CYCLES && entry.cycles == 50, "kind %u, %u cycles", entry.kind, entry.cycles);
+    CHECK(entry.first == 100 && entry.last == 199, "run %u..%u", entry.first, entry.last);
+    CHECK(b.count == 0 && !batcher_held(&b), "ring not empty");
+}
+
+/**
+ * A single pair goes out at once when delivery is idle, and keeps the
+ * worst clock quality of its two events
+ */
+static void test_pair(void) {
+    batcher_t b;
+    batch_entry_t entry, evicted;
+    batcher_init(&b);
+
+    CHECK(!batcher_add(&b, true, 10, 0, 7, &evicted), "eviction");
+    CHECK(!batcher_held(&b), "OPEN waiting for its CLOSE is held");
+    CHECK(!batcher_add(&b, false, 12, 2, 8, &evicted), "eviction");
+    CHECK(batcher_take_pair(&b, false, &entry), "pair not taken");
+    CHECK(entry.kind == BATCH_CYCLES && entry.cycles == 1 && entry.first == 10 && entry.last == 12,
+          "kind %u, %u cycles, %u..%u", entry.kind, entry.cycles, entry.first, entry.last);
+    CHECK(entry.time_quality == 2 && entry.probe_ticket == 7, "quality %u, ticket %u", entry.time_quality,
+          entry.probe_ticket);
+    CHECK(b.count == 0, "ring not empty");
+}
+
+/**
+ * Entries ahead of a pair go first - a lone CLOSE or an OPEN that will
+ * never see its CLOSE must not be overtaken
+ */
+static void test_held_order(void) {
+    batcher_t b;
+    batch_entry_t entry;
+    batcher_init(&b);
+
+    // CLOSE left behind when its OPEN went out on the batch timer
+    add(&b, false, 240);
+    CHECK(batcher_held(&b), "lone CLOSE not held");
+    add(&b, true, 300);
+    add(&b, false, 301);
+    CHECK(!batcher_take_pair(&b, false, &entry), "pair overtook the CLOSE before it");
+
+    CHECK(batcher_take_held(&b, false, &entry), "CLOSE not taken");
+    CHECK(entry.kind == BATCH_CLOSE && entry.first == 240, "kind %u at %u", entry.kind, entry.first);
+    CHECK(batcher_take_held(&b, false, &entry), "pair not taken");
+    CHECK(entry.kind == BATCH_CYCLES && entry.first == 300, "kind %u at %u", entry.kind, entry.first);
+
+    // OPEN followed by another OPEN - the CLOSE was missed
+    add(&b, true, 400);
+    add(&b, true, 410);
+    CHECK(batcher_take_held(&b, false, &entry), "stale OPEN not taken");
+    CHECK(entry.kind == BATCH_OPEN && entry.first == 400, "kind %u at %u", entry.kind, entry.first);
+    CHECK(!batcher_held(&b) && !batcher_take_held(&b, false, &entry), "newest OPEN taken before its CLOSE");
+    CHECK(b.count == 1, "%u entries left", b.count);
+}
+
+/**
+ * A full ring hands back its oldest entry and keeps the rest in order
+ */
+static void test_eviction(void) {
+    batcher_t b;
+    batch_entry_t entry, evicted;
+    batcher_init(&b);
+
+    // Lone CLOSEs never merge, so each takes a slot
+    for (uint32_t i = 0; i < BATCHER_SIZE; i++) {
+        add(&b, false, 1000 + i);
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        CHECK(batcher_add(&b, false, 2000 + i, 0, 0, &evicted), "full ring did not evict");
+        CHECK(evicted.kind == BATCH_CLOSE && evicted.first == 1000 + i, "evicted kind %u at %u", evicted.kind,
+              evicted.first);
+    }
+    CHECK(b.count == BATCHER_SIZE && b.evicted == 3, "%u entries, %u evicted", b.count, b.evicted);
+
+    uint32_t expected = 1003;
+    while (batcher_pop_oldest(&b, &entry)) {
+        CHECK(entry.first == expected, "got %u, expected %u", entry.first, expected);
+        expected = (expected == 1000 + BATCHER_SIZE - 1) ? 2000 : expected + 1;
+    }
+    CHECK(expected == 2003, "entries missing, next expected %u", expected);
+}
+
+/**
+ * Random traffic driven like the sensor loop: entries come out oldest
+ * first and every door event is accounted for
+ */
+static void test_random(void) {
+    batcher_t b;
+    batch_entry_t entry;
+    batcher_init(&b);
+    srand(1);
+
+    uint32_t added = 0;
+    uint32_t sent = 0;
+    uint32_t last_first = 0;
+    uint32_t now = 1;
+    bool open = false;
+
+    for (int step = 0; step < 200000; step++) {
+        now += 1 + rand() % 3;
+        bool busy = (rand() % 4) != 0;
+        batch_entry_t out[BATCHER_SIZE + 2];
+        int count = 0;
+
+        // Occasionally a missed edge repeats the last state
+        if (rand() % 16 != 0) {
+            open = !open;
+        }
+        if (batcher_add(&b, open, now, 0, 0, &out[count])) {
+            count++;
+        }
+        added++;
+        if (!open && batcher_take_pair(&b, busy, &out[count])) {
+            count++;
+        }
+        if (batcher_take_held(&b, (rand() % 4) != 0, &out[count])) {
+            count++;
+        }
+        // The batch timer sends everything
+        if (rand() % 500 == 0) {
+            while (batcher_pop_oldest(&b, &out[count])) {
+                count++;
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            CHECK(out[i].first >= last_first, "step %d: entry from %u sent after %u", step, out[i].first,
+                  last_first);
+            CHECK(out[i].last >= out[i].first, "step %d: entry ends before it starts", step);
+            last_first = out[i].first;
+            sent += entry_events(&out[i]);
+        }
+    }
+
+    uint32_t waiting = 0;
+    while (batcher_pop_oldest(&b, &entry)) {
+        CHECK(entry.first >= last_first, "entry from %u left behind %u", entry.first, last_first);
+        last_first = entry.first;
+        waiting += entry_events(&entry);
+    }
+    CHECK(sent + waiting == added, "%u events added, %u sent, %u waiting", added, sent, waiting);
+    printf("random: %u events, %u merged into runs, %u evicted\n", added, b.merged, b.evicted);
+}
+
+int main(void) {
+    test_burst();
+    test_pair();
+    test_held_order();
+    test_eviction();
+    test_random();
+    printf("test_batcher: ok\n");
+    return 0;
+}
@@ -0,0 +1,225 @@
+/**
+ * Tests of BLE address matching (main/ble_match.c): resolvable private
+ * address resolution against the Bluetooth Core spec sample data, the
+ * caches that keep AES work to one operation per address, and the "seen
+ * within the presence TTL" cutoff applied to door events.
+ *
+ * The firmware gets AES-128 from mbedTLS; here a small table-free
+ * implementation stands in, checked against FIPS-197 first.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ble_match.h"
+#include "check.h"
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static uint8_t xtime(uint8_t x) {
+    return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+}
+
+static int aes_calls = 0;
+
+/**
+ * AES-128 encryption of one block (FIPS-197), the ble_match_aes128_t the firmware gets from mbedTLS
+ */
+static void aes128(const uint8_t key[16], const uint8_t in[16], uint8_t out[16]) {
+    uint8_t round_key[16], state[16];
+    uint8_t rcon = 0x01;
+    memcpy(round_key, key, 16);
+    for (int i = 0; i < 16; i++) {
+        state[i] = in[i] ^ round_key[i];
+    }
+    aes_calls++;
+
+    for (int round = 1; round <= 10; round++) {
+        // SubBytes and ShiftRows - the state is column-major
+        uint8_t shifted[16];
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                shifted[c * 4 + r] = sbox[state[((c + r) % 4) * 4 + r]];
+            }
+        }
+        // MixColumns, skipped in the last round
+        if (round < 10) {
+            for (int c = 0; c < 4; c++) {
+                uint8_t* col = &shifted[c * 4];
+                uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+                uint8_t first = col[0];
+                col[0] ^= all ^ xtime(col[0] ^ col[1]);
+                col[1] ^= all ^ xtime(col[1] ^ col[2]);
+                col[2] ^= all ^ xtime(col[2] ^ col[3]);
+                col[3] ^= all ^ xtime(col[3] ^ first);
+            }
+        }
+        // Next round key
+        round_key[0] ^= sbox[round_key[13]] ^ rcon;
+        round_key[1] ^= sbox[round_key[14]];
+        round_key[2] ^= sbox[round_key[15]];
+        round_key[3] ^= sbox[round_key[12]];
+        for (int i = 4; i < 16; i++) {
+            round_key[i] ^= round_key[i - 4];
+        }
+        rcon = xtime(rcon);
+
+        for (int i = 0; i < 16; i++) {
+            state[i] = shifted[i] ^ round_key[i];
+        }
+    }
+    memcpy(out, state, 16);
+}
+
+/**
+ * Make a private address for an IRK from a 22-bit random part
+ */
+static void make_rpa(const uint8_t irk[16], uint32_t prand, uint8_t addr[6]) {
+    uint8_t plaintext[16] = { 0 };
+    uint8_t encrypted[16];
+    addr[0] = (uint8_t)(0x40 | ((prand >> 16) & 0x3f));
+    addr[1] = (uint8_t)(prand >> 8);
+    addr[2] = (uint8_t)prand;
+    memcpy(&plaintext[13], addr, 3);
+    aes128(irk, plaintext, encrypted);
+    memcpy(&addr[3], &encrypted[13], 3);
+}
+
+/**
+ * The AES stand-in against the FIPS-197 appendix C.1 example
+ */
+static void test_aes(void) {
+    const uint8_t key[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                              0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    const uint8_t plaintext[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    const uint8_t expected[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                                   0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+    uint8_t out[16];
+    aes128(key, plaintext, out);
+    CHECK(memcmp(out, expected, 16) == 0, "AES-128 does not match FIPS-197");
+}
+
+/**
+ * Core spec Vol 3 Part H appendix D.7 - ah() with
+ * IRK ec0234a357c8ad05341010a60a397d9b and prand 708194 gives hash 0dfbaa
+ */
+static void test_spec_vector(void) {
+    const uint8_t irk[16] = { 0xec, 0x02, 0x34, 0xa3, 0x57, 0xc8, 0xad, 0x05,
+                              0x34, 0x10, 0x10, 0xa6, 0x0a, 0x39, 0x7d, 0x9b };
+    const uint8_t rpa[6] = { 0x70, 0x81, 0x94, 0x0d, 0xfb, 0xaa };
+    const uint8_t phone[6] = { 0x00, 0x1a, 0x7d, 0xda, 0x71, 0x13 };
+    ble_match_t match;
+    ble_match_init(&match, aes128);
+
+    CHECK(ble_match_add(&match, phone, NULL) == 0, "add fixed address");
+    CHECK(ble_match_add(&match, NULL, irk) == 1, "add IRK");
+    CHECK(ble_match_is_rpa(rpa, true), "sample address not seen as private");
+
+    aes_calls = 0;
+    CHECK(ble_match_resolve(&match, rpa, true) == 1, "sample address not resolved with its IRK");
+    CHECK(match.resolutions == 1 && aes_calls == 1, "%u resolutions, %d AES calls", match.resolutions, aes_calls);
+
+    // A stream of advertisements from the same address costs no more AES
+    for (int i = 0; i < 10; i++) {
+        CHECK(ble_match_resolve(&match, rpa, true) == 1, "cached address lost");
+    }
+    CHECK(aes_calls == 1, "%d AES calls for one address", aes_calls);
+
+    // The same bytes as a public address are a different device
+    CHECK(ble_match_resolve(&match, rpa, false) == -1, "public address resolved with an IRK");
+    CHECK(ble_match_resolve(&match, phone, false) == 0, "fixed address not matched");
+
+    // Any bit of the hash wrong and it is someone else
+    for (int bit = 0; bit < 24; bit++) {
+        uint8_t other[6];
+        memcpy(other, rpa, 6);
+        other[3 + bit / 8] ^= (uint8_t)(1u << (bit % 8));
+        CHECK(ble_match_resolve(&match, other, true) == -1, "hash bit %d flipped still resolved", bit);
+    }
+}
+
+/**
+ * Strangers' private addresses are remembered, until a new IRK might claim them
+ */
+static void test_unknown_cache(void) {
+    const uint8_t irk_a[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    const uint8_t irk_b[16] = { 0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x06, 0x17,
+                                0x28, 0x39, 0x4a, 0x5b, 0x6c, 0x7d, 0x8e, 0x9f };
+    ble_match_t match;
+    ble_match_init(&match, aes128);
+    CHECK(ble_match_add(&match, NULL, irk_a) == 0, "add IRK A");
+
+    uint8_t a[6], b[6];
+    make_rpa(irk_a, 0x123456, a);
+    make_rpa(irk_b, 0x0abcde, b);
+    CHECK(ble_match_resolve(&match, a, true) == 0, "A's address not resolved");
+
+    aes_calls = 0;
+    CHECK(ble_match_resolve(&match, b, true) == -1, "B resolved before its IRK was added");
+    CHECK(ble_match_resolve(&match, b, true) == -1, "B resolved before its IRK was added");
+    CHECK(aes_calls == 1, "stranger cost %d AES calls", aes_calls);
+
+    CHECK(ble_match_add(&match, NULL, irk_b) == 1, "add IRK B");
+    CHECK(ble_match_resolve(&match, b, true) == 1, "B not resolved after its IRK was added");
+
+    // Static random addresses (top bits 11) are never resolved
+    uint8_t fixed[6] = { 0xc1, 0x02, 0x03, 0x04, 0x05, 0x06 };
+    CHECK(!ble_match_is_rpa(fixed, true) && ble_match_resolve(&match, fixed, true) == -1, "static address");
+}
+
+/**
+ * A door event counts a device seen less than the TTL ago, the newest first
+ */
+static void test_seen_cutoff(void) {
+    const time_t now = 1700000000;
+    const uint32_t ttl = 300;
+
+    time_t seen[4] = { 0, 0, 0, 0 };
+    CHECK(ble_match_most_recent(seen, 4, now, ttl) == -1, "never seen counted");
+
+    seen[2] = now - ttl + 1;
+    CHECK(ble_match_most_recent(seen, 4, now, ttl) == 2, "seen %u s ago not counted", ttl - 1);
+    seen[2] = now - ttl;
+    CHECK(ble_match_most_recent(seen, 4, now, ttl) == -1, "seen exactly %u s ago counted", ttl);
+    seen[2] = now;
+    CHECK(ble_match_most_recent(seen, 4, now, ttl) == 2, "seen just now not counted");
+
+    // The newest sighting wins, the first device on a tie
+    seen[0] = now - 100;
+    seen[1] = now - 10;
+    seen[2] = now - 50;
+    CHECK(ble_match_most_recent(seen, 4, now, ttl) == 1, "not the newest");
+    seen[3] = now - 10;
+    CHECK(ble_match_most_recent(seen, 4, now, ttl) == 1, "tie not the first");
+    CHECK(ble_match_most_recent(seen, 1, now, ttl) == 0, "count ignored");
+
+    // Stamped after now - the clock was stepped back since
+    time_t future[2] = { now + 5, now - 20 };
+    CHECK(ble_match_most_recent(future, 2, now, ttl) == 1, "sighting from the future counted");
+}
+
+int main(void) {
+    test_aes();
+    test_spec_vector();
+    test_unknown_cache();
+    test_seen_cutoff();
+    printf("test_ble_match: ok\n");
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * Replays edge traces through the debounce filter (main/debounce.c) and
+ * checks the result against expectations written into the trace:
+ *
+ *   #! commit <time_ms> <channel> <level>   next committed change, by the
+ *                                           time of its first edge
+ *   #! bounces <count>                      total over all channels
+ *   #! glitches <count>
+ *
+ * Each channel starts closed, as in door_sim, and is polled exactly when
+ * debounce_deadline() says it can make progress. The expectations are
+ * worked out by hand from the filter's rules with the default 50 ms settle
+ * window and 250 ms minimum hold, not recorded from a run.
+ *
+ * Usage: test_debounce <trace>...
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "debounce.h"
+#include "check.h"
+
+#define SETTLE_MS 50
+#define MIN_HOLD_MS 250
+#define MAX_CHANNELS 8
+#define MAX_COMMITS 256
+
+typedef struct {
+    int64_t since_us;
+    int channel;
+    int level;
+} commit_t;
+
+typedef struct {
+    const char* path;
+    debounce_t channels[MAX_CHANNELS];
+    commit_t expected[MAX_COMMITS];
+    int expected_count;
+    int committed;              // Commits seen so far
+    long bounces;               // Expected totals, -1 if the trace gives none
+    long glitches;
+} replay_t;
+
+/**
+ * Poll every channel whose deadline has come, up to and including until_us
+ */
+static void run_until(replay_t* r, int64_t until_us) {
+    while (1) {
+        int next = -1;
+        int64_t next_us = 0;
+        for (int c = 0; c < MAX_CHANNELS; c++) {
+            int64_t deadline = debounce_deadline(&r->channels[c]);
+            if (deadline >= 0 && deadline <= until_us && (next < 0 || deadline < next_us)) {
+                next = c;
+                next_us = deadline;
+            }
+        }
+        if (next < 0) {
+            return;
+        }
+
+        int level;
+        int64_t since_us;
+        if (!debounce_poll(&r->channels[next], next_us, &level, &since_us)) {
+            continue;
+        }
+        if (since_us == 0) {
+            continue;           // The closed level every channel starts from
+        }
+
+        CHECK(r->committed < r->expected_count, "%s: unexpected commit of %d on channel %d at %.3f ms", r->path,
+              level, next, since_us / 1000.0);
+        const commit_t* want = &r->expected[r->committed++];
+        CHECK(want->channel == next && want->level == level && want->since_us == since_us,
+              "%s: commit %d is %d on channel %d at %.3f ms, expected %d on channel %d at %.3f ms", r->path,
+              r->committed, level, next, since_us / 1000.0, want->level, want->channel, want->since_us / 1000.0);
+    }
+}
+
+/**
+ * Read an expectation line (after the "#!")
+ */
+static void parse_expectation(replay_t* r, const char* text, int line_no) {
+    double time_ms;
+    int channel, level;
+    long count;
+
+    if (sscanf(text, " commit %lf %d %d", &time_ms, &channel, &level) == 3) {
+        CHECK(r->expected_count < MAX_COMMITS, "%s:%d: too many commits", r->path, line_no);
+        r->expected[r->expected_count++] = (commit_t) { (int64_t)(time_ms * 1000 + 0.5), channel, level };
+    } else if (sscanf(text, " bounces %ld", &count) == 1) {
+        r->bounces = count;
+    } else if (sscanf(text, " glitches %ld", &count) == 1) {
+        r->glitches = count;
+    } else {
+        CHECK(0, "%s:%d: unknown expectation '%s'", r->path, line_no, text);
+    }
+}
+
+/**
+ * Replay one trace and check it
+ */
+static void check_trace(const char* path) {
+    static replay_t r;
+    memset(&r, 0, sizeof(r));
+    r.path = path;
+    r.bounces = -1;
+    r.glitches = -1;
+
+    // First pass - what the trace expects
+    FILE* f = fopen(path, "r");
+    CHECK(f != NULL, "cannot open %s", path);
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "#!", 2) == 0) {
+            parse_expectation(&r, line + 2, line_no);
+        }
+    }
+    CHECK(r.bounces >= 0 && r.glitches >= 0, "%s: no bounce and glitch counts to check", path);
+
+    for (int c = 0; c < MAX_CHANNELS; c++) {
+        debounce_init(&r.channels[c], SETTLE_MS, MIN_HOLD_MS);
+        debounce_feed(&r.channels[c], 0, 0);
+    }
+
+    // Second pass - the edges
+    rewind(f);
+    line_no = 0;
+    int edges = 0;
+    int64_t last_us = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char* hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        double time_ms;
+        int channel, level;
+        int fields = sscanf(line, "%lf %d %d", &time_ms, &channel, &level);
+        if (fields <= 0) {
+            continue;
+        }
+        CHECK(fields == 3 && channel >= 0 && channel < MAX_CHANNELS && (level == 0 || level == 1),
+              "%s:%d: expected <time_ms> <channel> <level>", path, line_no);
+        int64_t time_us = (int64_t)(time_ms * 1000 + 0.5);
+        CHECK(time_us >= last_us, "%s:%d: edge goes back in time", path, line_no);
+        last_us = time_us;
+
+        run_until(&r, time_us);
+        debounce_feed(&r.channels[channel], level, time_us);
+        edges++;
+    }
+    fclose(f);
+    run_until(&r, INT64_MAX);
+
+    long bounces = 0, glitches = 0;
+    for (int c = 0; c < MAX_CHANNELS; c++) {
+        bounces += r.channels[c].bounces;
+        glitches += r.channels[c].glitches;
+    }
+    CHECK(r.committed == r.expected_count, "%s: %d of %d expected commits", path, r.committed, r.expected_count);
+    CHECK(bounces == r.bounces, "%s: %ld bounces, expected %ld", path, bounces, r.bounces);
+    CHECK(glitches == r.glitches, "%s: %ld glitches, expected %ld", path, glitches, r.glitches);
+    printf("%s: %d edges, %d commits, %ld bounces, %ld glitches\n", path, edges, r.committed, bounces, glitches);
+}
+
+int main(int argc, char** argv) {
+    CHECK(argc > 1, "usage: test_debounce <trace>...");
+    for (int i = 1; i < argc; i++) {
+        check_trace(argv[i]);
+    }
+    printf("test_debounce: ok\n");
+    return 0;
+}
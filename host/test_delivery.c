@@ -0,0 +1,195 @@
+/**
+ * Tests of the delivery task's decisions (main/delivery.c): immediate sends,
+ * the backlog behind them, transport windows, coalescing, backoff and the
+ * hooks the flash log hangs off.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "delivery.h"
+#include "check.h"
+
+#define FLUSH_MAX_BYTES 1024
+
+typedef struct {
+    int stored;
+    int delivered;
+    int evicted;
+    uint32_t next_seq;
+    uint32_t delivered_seq[MAX_QUEUED_MESSAGES + 8];
+} hooks_seen_t;
+
+static hooks_seen_t seen;
+static char flush_body[FLUSH_MAX_BYTES + 1];
+
+static void on_stored(void* ctx, backlog_entry_t* entry) {
+    seen.stored++;
+    entry->log_seq = ++seen.next_seq;
+}
+
+static void on_delivered(void* ctx, const backlog_entry_t* entry) {
+    seen.delivered_seq[seen.delivered++] = entry->log_seq;
+}
+
+static void on_evicted(void* ctx, const backlog_entry_t* entry) {
+    seen.evicted++;
+}
+
+static const delivery_hooks_t hooks = { .stored = on_stored, .delivered = on_delivered, .evicted = on_evicted };
+
+static void setup(delivery_t* d, int window, bool coalesce) {
+    memset(&seen, 0, sizeof(seen));
+    delivery_init(d, window, coalesce ? flush_body : NULL, FLUSH_MAX_BYTES, &hooks);
+}
+
+static backlog_entry_t entry_at(uint32_t timestamp) {
+    backlog_entry_t entry = { .log_seq = 0 };
+    entry.record.timestamp = timestamp;
+    entry.record.pattern = DOOR_PATTERN_OPENED;
+    entry.record.count = 1;
+    return entry;
+}
+
+/**
+ * Feed a record and fail its immediate send, leaving it in the backlog
+ */
+static void fail_single(delivery_t* d, uint32_t timestamp) {
+    delivery_send_t send;
+    backlog_entry_t entry = entry_at(timestamp);
+    delivery_receive(d, &entry);
+    CHECK(delivery_next(d, true, &send) && !send.from_backlog, "record not sent on its own");
+    CHECK(!delivery_sent(d, 0, true), "more to send after a failure");
+}
+
+/**
+ * With nothing waiting a record goes out on its own and never touches the backlog
+ */
+static void test_immediate(void) {
+    delivery_t d;
+    setup(&d, 1, true);
+    backlog_entry_t entry = entry_at(1000);
+    delivery_receive(&d, &entry);
+
+    delivery_send_t send;
+    CHECK(delivery_next(&d, true, &send), "nothing to send");
+    CHECK(send.count == 1 && send.body == NULL && send.entries[0]->record.timestamp == 1000, "wrong send");
+    CHECK(!delivery_sent(&d, 1, true), "more to send");
+    CHECK(seen.delivered == 1 && seen.stored == 0 && d.backlog.count == 0, "%d delivered, %d stored",
+          seen.delivered, seen.stored);
+    CHECK(!delivery_next(&d, true, &send), "sent twice");
+    CHECK(delivery_wait_ms(&d) == DELIVERY_WAIT_FOREVER, "retry timeout with nothing left");
+}
+
+/**
+ * Failed sends back off while online, retry at once when the link returns,
+ * and later records queue behind the backlog in order
+ */
+static void test_backoff(void) {
+    delivery_t d;
+    setup(&d, 1, false);
+    fail_single(&d, 1000);
+    CHECK(d.backlog.count == 1 && seen.stored == 1, "failed record not in the backlog");
+    CHECK(delivery_wait_ms(&d) == 2 * BACKLOG_RETRY_MIN_MS, "retry in %u ms", delivery_wait_ms(&d));
+
+    // Behind the backlog, not on its own
+    backlog_entry_t entry = entry_at(1001);
+    delivery_receive(&d, &entry);
+    delivery_send_t send;
+    CHECK(delivery_next(&d, true, &send) && send.from_backlog && send.entries[0]->record.timestamp == 1000,
+          "backlog head not first");
+    CHECK(!delivery_sent(&d, 0, true), "more to send after a failure");
+    CHECK(delivery_wait_ms(&d) == 4 * BACKLOG_RETRY_MIN_MS, "retry in %u ms", delivery_wait_ms(&d));
+
+    // Doubling stops at the maximum
+    for (int i = 0; i < 10; i++) {
+        delivery_wake(&d);
+        CHECK(delivery_next(&d, true, &send), "no retry");
+        delivery_sent(&d, 0, true);
+    }
+    CHECK(delivery_wait_ms(&d) == BACKLOG_RETRY_MAX_MS, "retry in %u ms", delivery_wait_ms(&d));
+
+    // Offline there is nothing to send and the retry drops to the minimum
+    delivery_wake(&d);
+    CHECK(!delivery_next(&d, false, &send), "sent while offline");
+    CHECK(delivery_wait_ms(&d) == BACKLOG_RETRY_MIN_MS, "offline retry in %u ms", delivery_wait_ms(&d));
+
+    // Drained one at a time with a gap between, then the delay resets
+    delivery_wake(&d);
+    CHECK(delivery_next(&d, true, &send) && delivery_sent(&d, 1, true), "no gap before the second record");
+    CHECK(delivery_next(&d, true, &send) && !delivery_sent(&d, 1, true), "gap after the last record");
+    CHECK(seen.delivered == 2 && seen.delivered_seq[0] == 1 && seen.delivered_seq[1] == 2, "delivered out of order");
+    CHECK(d.backlog.count == 0 && d.retry_delay_ms == BACKLOG_RETRY_MIN_MS, "backlog %d, retry %u ms",
+          d.backlog.count, d.retry_delay_ms);
+}
+
+/**
+ * A window sends several records at once and only the confirmed ones leave
+ */
+static void test_window(void) {
+    delivery_t d;
+    setup(&d, 4, false);
+    fail_single(&d, 1000);
+    for (uint32_t i = 1; i < 6; i++) {
+        backlog_entry_t entry = entry_at(1000 + i);
+        delivery_receive(&d, &entry);
+    }
+
+    delivery_send_t send;
+    CHECK(delivery_next(&d, true, &send) && send.count == 4, "window of %d", send.count);
+    CHECK(!delivery_sent(&d, 2, true), "more to send after a partial failure");
+    CHECK(seen.delivered == 2 && d.backlog.count == 4, "%d delivered, %d left", seen.delivered, d.backlog.count);
+
+    delivery_wake(&d);
+    CHECK(delivery_next(&d, true, &send) && send.count == 4 && send.entries[0]->record.timestamp == 1002,
+          "window restarts at %lu", (unsigned long)send.entries[0]->record.timestamp);
+}
+
+/**
+ * A coalesced body stands for every record packed into it
+ */
+static void test_coalesce(void) {
+    delivery_t d;
+    setup(&d, 1, true);
+    fail_single(&d, 1000);
+    for (uint32_t i = 1; i < 5; i++) {
+        backlog_entry_t entry = entry_at(1000 + i);
+        delivery_receive(&d, &entry);
+    }
+    CHECK(d.backlog.count == 5, "%d in the backlog", d.backlog.count);
+
+    delivery_send_t send;
+    CHECK(delivery_next(&d, true, &send) && send.count == 1 && send.body != NULL, "not coalesced");
+    CHECK(strncmp(send.body, "📋 5 queued events:", strlen("📋 5 queued events:")) == 0, "body: %s", send.body);
+    CHECK(!delivery_sent(&d, 1, true) && seen.delivered == 5 && d.backlog.count == 0, "%d delivered, %d left",
+          seen.delivered, d.backlog.count);
+}
+
+/**
+ * A full backlog gives up its oldest record, and restored records are not logged again
+ */
+static void test_evict(void) {
+    delivery_t d;
+    setup(&d, 1, true);
+    for (uint32_t i = 0; i < MAX_QUEUED_MESSAGES; i++) {
+        backlog_entry_t entry = entry_at(1000 + i);
+        entry.log_seq = i + 1;
+        delivery_restore(&d, &entry);
+    }
+    CHECK(seen.stored == 0 && seen.evicted == 0, "restore went through the hooks");
+
+    backlog_entry_t entry = entry_at(5000);
+    delivery_receive(&d, &entry);
+    CHECK(seen.stored == 1 && seen.evicted == 1 && d.backlog.count == MAX_QUEUED_MESSAGES,
+          "%d stored, %d evicted", seen.stored, seen.evicted);
+    CHECK(backlog_peek(&d.backlog, 0)->record.timestamp == 1001, "oldest record kept");
+}
+
+int main(void) {
+    test_immediate();
+    test_backoff();
+    test_window();
+    test_coalesce();
+    test_evict();
+    printf("test_delivery: ok\n");
+    return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * Tests of the ISR to sensor task edge ring (main/edge_ring.h) with a
+ * pthread in each role.
+ *
+ * The producer stands in for the GPIO ISR and pushes synthetic edges whose
+ * timestamp, levels and pin all derive from one sequence number, so the
+ * consumer can tell a lost, reordered or half-written slot apart. Paced
+ * bursts that fit the ring must arrive complete and in order; a producer
+ * outrunning the consumer must lose only what the dropped counter reports.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "edge_ring.h"
+#include "check.h"
+
+#define BURST_EDGES (EDGE_RING_SIZE / 4)   // Edges per burst, like contact bounce
+#define BURST_PERIOD_US 1000               // One burst per millisecond - 16000 edges/s
+#define PACED_BURSTS 1000
+#define FLOOD_EDGES 200000
+
+typedef struct {
+    edge_ring_t ring;
+    unsigned pushed;            // Edges handed to the ring, producer only
+    unsigned refused;           // Pushes that returned false, producer only
+    atomic_bool done;           // Producer finished
+    unsigned received;          // Consumer only
+    unsigned slow_every;        // Consumer pauses after this many edges, 0 never
+} test_ring_t;
+
+static uint64_t edge_levels(unsigned seq) {
+    return (uint64_t)seq * 0x9e3779b97f4a7c15ull;
+}
+
+static int edge_pin(unsigned seq) {
+    return (int)(seq % 40);
+}
+
+static void sleep_us(long us) {
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Push one edge derived from seq
+ */
+static void push(test_ring_t* t, unsigned seq) {
+    if (!edge_ring_push(&t->ring, (int64_t)seq, edge_levels(seq), edge_pin(seq))) {
+        t->refused++;
+    }
+    t->pushed++;
+}
+
+/**
+ * Producer of the paced test - bursts that fit the ring, BURST_PERIOD_US apart
+ */
+static void* paced_producer(void* arg) {
+    test_ring_t* t = arg;
+    unsigned seq = 0;
+    for (int burst = 0; burst < PACED_BURSTS; burst++) {
+        for (int i = 0; i < BURST_EDGES; i++) {
+            push(t, seq++);
+        }
+        sleep_us(BURST_PERIOD_US);
+    }
+    atomic_store(&t->done, true);
+    return NULL;
+}
+
+/**
+ * Producer of the flood test - as fast as it can, letting the consumer in
+ * now and then even on a single core
+ */
+static void* flood_producer(void* arg) {
+    test_ring_t* t = arg;
+    for (unsigned seq = 0; seq < FLOOD_EDGES; seq++) {
+        push(t, seq);
+        if (seq % 97 == 0) {
+            sched_yield();
+        }
+    }
+    atomic_store(&t->done, true);
+    return NULL;
+}
+
+/**
+ * Consumer - checks each edge is whole and newer than the one before
+ * @param contiguous Whether every edge must arrive, not just in order
+ */
+static void consume(test_ring_t* t, bool contiguous) {
+    edge_event_t edge;
+    long long last = -1;
+
+    while (1) {
+        // Read done before popping, so nothing pushed before it is missed
+        bool done = atomic_load(&t->done);
+        if (!edge_ring_pop(&t->ring, &edge)) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        unsigned seq = (unsigned)edge.timestamp_us;
+        CHECK(edge.levels == edge_levels(seq) && edge.pin == edge_pin(seq), "edge %u torn", seq);
+        CHECK((long long)seq > last, "edge %u after %lld", seq, last);
+        CHECK(!contiguous || (long long)seq == last + 1, "edge %u after %lld - %lld lost", seq, last,
+              (long long)seq - last - 1);
+        last = seq;
+        t->received++;
+
+        if (t->slow_every != 0 && t->received % t->slow_every == 0) {
+            sleep_us(100);
+        }
+    }
+}
+
+/**
+ * Bursts at thousands of edges per second must all arrive, in order
+ */
+static void test_paced(void) {
+    static test_ring_t t;
+    edge_ring_init(&t.ring);
+    atomic_init(&t.done, false);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t producer;
+    CHECK(pthread_create(&producer, NULL, paced_producer, &t) == 0, "pthread_create");
+    consume(&t, true);
+    pthread_join(producer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    CHECK(t.refused == 0 && edge_ring_dropped(&t.ring) == 0, "%u refused, %u dropped", t.refused,
+          edge_ring_dropped(&t.ring));
+    CHECK(t.received == t.pushed && t.pushed == PACED_BURSTS * BURST_EDGES, "%u of %u received", t.received,
+          t.pushed);
+    printf("paced: %u edges in %.2f s (%.0f edges/s), none dropped\n", t.received, seconds, t.received / seconds);
+}
+
+/**
+ * A full ring refuses further edges and counts each one
+ */
+static void test_overflow(void) {
+    static test_ring_t t;
+    edge_event_t edge;
+    edge_ring_init(&t.ring);
+
+    for (unsigned seq = 0; seq < 3 * EDGE_RING_SIZE; seq++) {
+        push(&t, seq);
+    }
+    CHECK(edge_ring_count(&t.ring) == EDGE_RING_SIZE, "%u waiting", edge_ring_count(&t.ring));
+    CHECK(t.refused == 2 * EDGE_RING_SIZE && edge_ring_dropped(&t.ring) == t.refused, "%u refused, %u dropped",
+          t.refused, edge_ring_dropped(&t.ring));
+
+    // The oldest edges are kept, the newest were refused
+    for (unsigned seq = 0; seq < EDGE_RING_SIZE; seq++) {
+        CHECK(edge_ring_pop(&t.ring, &edge) && edge.timestamp_us == seq, "edge %u missing", seq);
+    }
+    CHECK(!edge_ring_pop(&t.ring, &edge), "ring not empty");
+
+    // Room again once drained
+    CHECK(edge_ring_push(&t.ring, 1, 2, 3) && edge_ring_dropped(&t.ring) == 2 * EDGE_RING_SIZE,
+          "push after drain");
+}
+
+/**
+ * A producer outrunning a slow consumer loses edges, but only as many as
+ * the dropped counter says, and never reorders or tears the rest
+ */
+static void test_flood(void) {
+    static test_ring_t t;
+    edge_ring_init(&t.ring);
+    atomic_init(&t.done, false);
+    t.slow_every = 256;
+
+    pthread_t producer;
+    CHECK(pthread_create(&producer, NULL, flood_producer, &t) == 0, "pthread_create");
+    consume(&t, false);
+    pthread_join(producer, NULL);
+
+    unsigned dropped = edge_ring_dropped(&t.ring);
+    CHECK(dropped == t.refused, "%u dropped but %u pushes refused", dropped, t.refused);
+    CHECK(t.received + dropped == FLOOD_EDGES, "%u received + %u dropped != %u pushed", t.received, dropped,
+          FLOOD_EDGES);
+    printf("flood: %u edges, %u received, %u dropped\n", FLOOD_EDGES, t.received, dropped);
+}
+
+int main(void) {
+    test_overflow();
+    test_paced();
+    test_flood();
+    printf("test_edge_ring: ok\n");
+    return 0;
+}
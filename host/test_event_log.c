@@ -0,0 +1,259 @@
+/**
+ * Power-loss test of the flash write-ahead log (main/event_log.c).
+ *
+ * Runs a fixed workload - normal delivery, a slow link that wraps the log
+ * onto undelivered entries, then the backlog draining - on RAM flash, once
+ * for every step at which power can be cut: each byte written and each
+ * sector erase. After every cut the log is reopened and replayed, and:
+ *   - no entry covered by a committed acknowledgement comes back
+ *   - every committed entry that was never acknowledged comes back once
+ *   - entries come back in sequence order with their payload intact
+ *   - the reopened log keeps working
+ * A second test fills the log with undelivered entries and checks that only
+ * the oldest are given up.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "event_log.h"
+#include "ram_flash.h"
+#include "check.h"
+
+#define SECTOR_SIZE 1024
+#define SECTOR_COUNT 5
+#define MAX_REPLAY 1024
+#define LAG 100
+#define SLOW_ENTRIES 400
+
+typedef struct {
+    uint32_t seq;
+    uint32_t check;
+    uint32_t filler;
+} payload_t;
+
+// What the workload knows was made durable, and what was in flight at the cut
+typedef struct {
+    uint32_t appended;          // Highest sequence handed out
+    uint32_t durable;           // Every entry up to here was in a commit that succeeded
+    uint32_t durable_ack;       // Acknowledgement written by the last commit that succeeded
+    uint32_t pending_ack;       // Latest acknowledgement handed to the log
+} model_t;
+
+typedef struct {
+    uint32_t seqs[MAX_REPLAY];
+    int count;
+} replay_t;
+
+static uint8_t flash_data[SECTOR_SIZE * SECTOR_COUNT];
+
+static payload_t make_payload(uint32_t seq) {
+    return (payload_t) { .seq = seq, .check = seq ^ 0xa5a5a5a5u, .filler = seq * 2654435761u };
+}
+
+static void collect_cb(void* arg, uint32_t seq, const void* payload, size_t len) {
+    replay_t* replay = arg;
+    payload_t expected = make_payload(seq);
+    CHECK(len == sizeof(expected) && memcmp(payload, &expected, len) == 0, "entry %u payload corrupt", seq);
+    CHECK(replay->count < MAX_REPLAY, "too many entries replayed");
+    replay->seqs[replay->count++] = seq;
+}
+
+static bool append(event_log_t* log, model_t* model) {
+    payload_t payload = make_payload(model->appended + 1);
+    uint32_t seq;
+    if (event_log_append(log, &payload, sizeof(payload), &seq) != EVENT_LOG_OK) {
+        return false;
+    }
+    CHECK(seq == model->appended + 1, "got seq %u after %u", seq, model->appended);
+    model->appended = seq;
+    return true;
+}
+
+static void ack(event_log_t* log, model_t* model, uint32_t seq) {
+    event_log_ack(log, seq);
+    if (seq > model->pending_ack) {
+        model->pending_ack = seq;
+    }
+}
+
+static bool commit(event_log_t* log, model_t* model) {
+    if (event_log_commit(log) != EVENT_LOG_OK) {
+        return false;
+    }
+    model->durable = model->appended;
+    model->durable_ack = model->pending_ack;
+    return true;
+}
+
+/**
+ * The workload, stopping at the first operation the power cut breaks
+ * @return true if it ran to the end
+ */
+static bool run_workload(event_log_t* log, model_t* model) {
+    // Normal delivery - each batch acknowledged two batches later
+    for (int batch = 0; batch < 20; batch++) {
+        for (int i = 0; i < 3; i++) {
+            if (!append(log, model)) {
+                return false;
+            }
+        }
+        if (batch >= 2) {
+            ack(log, model, model->appended - 6);
+        }
+        if (!commit(log, model)) {
+            return false;
+        }
+    }
+
+    // Slow link - delivery falls LAG entries behind while the log wraps
+    // onto the sectors holding them
+    for (int i = 0; i < SLOW_ENTRIES; i++) {
+        if (!append(log, model)) {
+            return false;
+        }
+        if (model->appended > LAG) {
+            ack(log, model, model->appended - LAG);
+        }
+        if (!commit(log, model)) {
+            return false;
+        }
+    }
+
+    // Back online - the backlog drains in order while new events arrive
+    while (model->pending_ack < model->appended) {
+        if (!append(log, model)) {
+            return false;
+        }
+        uint32_t next = model->pending_ack + 7;
+        ack(log, model, next < model->appended ? next : model->appended);
+        if (!commit(log, model)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reopen the flash as it is and replay everything undelivered
+ */
+static void reopen(event_log_t* log, ram_flash_t* flash, event_log_flash_t* ops, replay_t* replay) {
+    ram_flash_attach(flash, flash_data, SECTOR_SIZE, SECTOR_COUNT, ops);
+    CHECK(event_log_open(log, ops) == EVENT_LOG_OK, "reopen failed");
+    replay->count = 0;
+    CHECK(event_log_replay(log, collect_cb, replay) == EVENT_LOG_OK, "replay failed");
+    for (int i = 1; i < replay->count; i++) {
+        CHECK(replay->seqs[i] > replay->seqs[i - 1], "seq %u replayed after %u", replay->seqs[i], replay->seqs[i - 1]);
+    }
+}
+
+/**
+ * Check a replay after a cut against what the workload had made durable
+ */
+static void check_replay(const replay_t* replay, const model_t* model, int64_t cut) {
+    int next = 0;
+    for (int i = 0; i < replay->count; i++) {
+        uint32_t seq = replay->seqs[i];
+        CHECK(seq > model->durable_ack, "cut %lld: entry %u replayed after ack %u", (long long)cut, seq,
+              model->durable_ack);
+        CHECK(seq <= model->appended, "cut %lld: entry %u never appended", (long long)cut, seq);
+    }
+
+    // Committed and never acknowledged - must all be there
+    for (uint32_t seq = model->pending_ack + 1; seq <= model->durable; seq++) {
+        while (next < replay->count && replay->seqs[next] < seq) {
+            next++;
+        }
+        CHECK(next < replay->count && replay->seqs[next] == seq, "cut %lld: entry %u lost (durable %u, ack %u)",
+              (long long)cut, seq, model->durable, model->pending_ack);
+    }
+}
+
+/**
+ * Cut the power at every step of the workload
+ */
+static void test_power_loss(void) {
+    event_log_t log;
+    ram_flash_t flash;
+    event_log_flash_t ops;
+    static replay_t replay, after;
+
+    // Uninterrupted run first - it must wrap onto undelivered entries without losing any
+    memset(flash_data, 0xff, sizeof(flash_data));
+    ram_flash_attach(&flash, flash_data, SECTOR_SIZE, SECTOR_COUNT, &ops);
+    model_t model = { 0 };
+    CHECK(event_log_open(&log, &ops) == EVENT_LOG_OK, "format failed");
+    CHECK(run_workload(&log, &model), "workload failed without a power cut");
+    CHECK(log.compacted > 0, "workload never wrapped onto undelivered entries");
+    CHECK(log.dropped == 0, "%u entries dropped with room to spare", log.dropped);
+    uint64_t total_steps = flash.steps;
+    uint32_t compacted = log.compacted;
+
+    for (int64_t cut = 0; cut <= (int64_t)total_steps; cut++) {
+        memset(flash_data, 0xff, sizeof(flash_data));
+        ram_flash_attach(&flash, flash_data, SECTOR_SIZE, SECTOR_COUNT, &ops);
+        ram_flash_cut_after(&flash, cut);
+        model = (model_t) { 0 };
+        bool finished = event_log_open(&log, &ops) == EVENT_LOG_OK && run_workload(&log, &model);
+        CHECK(finished == (cut == (int64_t)total_steps), "cut %lld: workload finished %d", (long long)cut, finished);
+
+        reopen(&log, &flash, &ops, &replay);
+        check_replay(&replay, &model, cut);
+
+        // The log must keep working after the cut
+        uint32_t seqs[3];
+        for (int i = 0; i < 3; i++) {
+            payload_t payload = make_payload(log.next_seq);
+            CHECK(event_log_append(&log, &payload, sizeof(payload), &seqs[i]) == EVENT_LOG_OK, "cut %lld: append", (long long)cut);
+            CHECK(replay.count == 0 || seqs[i] > replay.seqs[replay.count - 1], "cut %lld: seq %u reused",
+                  (long long)cut, seqs[i]);
+        }
+        CHECK(event_log_commit(&log) == EVENT_LOG_OK, "cut %lld: commit after reopen", (long long)cut);
+        reopen(&log, &flash, &ops, &after);
+        CHECK(after.count == replay.count + 3, "cut %lld: %d entries after reopen, expected %d", (long long)cut,
+              after.count, replay.count + 3);
+        CHECK(memcmp(after.seqs, replay.seqs, replay.count * sizeof(uint32_t)) == 0 &&
+              memcmp(after.seqs + replay.count, seqs, sizeof(seqs)) == 0, "cut %lld: replay changed", (long long)cut);
+    }
+    printf("power loss: %llu cut points, %u entries copied forward per run\n",
+           (unsigned long long)total_steps + 1, compacted);
+}
+
+/**
+ * Keep appending without acknowledgements until the log has to give up entries
+ */
+static void test_full_log(void) {
+    event_log_t log;
+    ram_flash_t flash;
+    event_log_flash_t ops;
+    static replay_t replay;
+
+    memset(flash_data, 0xff, sizeof(flash_data));
+    ram_flash_attach(&flash, flash_data, SECTOR_SIZE, SECTOR_COUNT, &ops);
+    model_t model = { 0 };
+    CHECK(event_log_open(&log, &ops) == EVENT_LOG_OK, "format failed");
+    for (int batch = 0; batch < 200; batch++) {
+        for (int i = 0; i < 4; i++) {
+            CHECK(append(&log, &model), "append failed");
+        }
+        CHECK(commit(&log, &model), "commit failed");
+    }
+    uint32_t dropped = log.dropped;
+    CHECK(dropped > 0, "800 entries fit in %u bytes", (unsigned)sizeof(flash_data));
+
+    // What is left is the newest entries, without gaps
+    reopen(&log, &flash, &ops, &replay);
+    CHECK(replay.count > 0 && replay.seqs[replay.count - 1] == model.appended, "newest entry missing");
+    CHECK(replay.seqs[replay.count - 1] - replay.seqs[0] + 1 == (uint32_t)replay.count, "gap in the kept entries");
+    CHECK(replay.count > (SECTOR_COUNT - 2) * SECTOR_SIZE / (int)(sizeof(payload_t) + 12), "only %d entries kept",
+          replay.count);
+    printf("full log: kept newest %d of %u entries, %u dropped\n", replay.count, model.appended, dropped);
+}
+
+int main(void) {
+    test_power_loss();
+    test_full_log();
+    printf("test_event_log: ok\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * Tests of presence probe round planning (main/probe_plan.c), run against a
+ * model of a Classic backend: the devices of a round are paged one after
+ * the other, an absent one holds the radio for the whole page timeout, a
+ * present one answers after ANSWER_MS and ends the round, and the round
+ * ends after ROUND_MS whatever is left.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "probe_plan.h"
+#include "check.h"
+
+#define ROUND_MS 3000           // PRESENCE_PROBE_TIMEOUT_MS
+#define ANSWER_MS 300
+#define MAX_DEVICES PROBE_PLAN_MAX_DEVICES
+
+typedef struct {
+    probe_plan_t plan;
+    int count;
+    time_t last_seen[MAX_DEVICES];
+    bool present[MAX_DEVICES];
+    int pages[MAX_DEVICES];     // Times each device was paged
+    time_t now;
+} model_t;
+
+static void model_init(model_t* m, int count, const bool* probe) {
+    bool all[MAX_DEVICES];
+    memset(m, 0, sizeof(*m));
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        all[i] = true;
+    }
+    m->count = count;
+    m->now = 1700000000;
+    probe_plan_init(&m->plan, probe ? probe : all, count, ROUND_MS, true);
+}
+
+/**
+ * Run one round on the model
+ * @return the device that answered, -1 if none did
+ */
+static int run_round(model_t* m) {
+    int order[MAX_DEVICES];
+    int count = probe_plan_next(&m->plan, m->last_seen, order);
+    CHECK(count >= 1 && count <= m->plan.per_round, "%d devices planned, %d per round", count, m->plan.per_round);
+
+    uint32_t elapsed_ms = 0;
+    int answer = -1;
+    for (int i = 0; i < count && elapsed_ms < ROUND_MS; i++) {
+        int index = order[i];
+        m->pages[index]++;
+        if (m->present[index]) {
+            m->last_seen[index] = m->now;
+            answer = index;
+            break;
+        }
+        elapsed_ms += m->plan.page_ms;
+    }
+    CHECK(answer >= 0 || elapsed_ms >= (uint32_t)count * m->plan.page_ms, "round ended before its plan");
+    m->now += 20;
+    return answer;
+}
+
+/**
+ * The page timeout shares the round, within a phone's page scan interval
+ */
+static void test_page_timeout(void) {
+    static const struct {
+        int devices;
+        uint32_t page_ms;
+        int per_round;
+        int rounds_to_cover;
+    } cases[] = {
+        { 1, PROBE_PLAN_MAX_PAGE_MS, 1, 1 },
+        { 2, 1500, 2, 1 },
+        { 3, PROBE_PLAN_MIN_PAGE_MS, 2, 3 },
+        { 8, PROBE_PLAN_MIN_PAGE_MS, 2, 8 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        model_t m;
+        model_init(&m, cases[i].devices, NULL);
+        CHECK(m.plan.page_ms == cases[i].page_ms && m.plan.per_round == cases[i].per_round &&
+              m.plan.rounds_to_cover == cases[i].rounds_to_cover,
+              "%d devices: %u ms pages, %d per round, covered in %d rounds", cases[i].devices, m.plan.page_ms,
+              m.plan.per_round, m.plan.rounds_to_cover);
+        CHECK(m.plan.page_ms * (uint32_t)m.plan.per_round <= ROUND_MS, "%d devices: round overrun",
+              cases[i].devices);
+    }
+
+    // A listening backend hears everyone every round
+    probe_plan_t plan;
+    bool all[MAX_DEVICES] = { true, true, true, true, true, true, true, true };
+    probe_plan_init(&plan, all, MAX_DEVICES, ROUND_MS, false);
+    CHECK(plan.page_ms == 0 && plan.per_round == MAX_DEVICES, "listening backend capped at %d", plan.per_round);
+}
+
+/**
+ * Two devices seen before but away must not keep a never seen phone from
+ * being paged - it is the last in recency order and would never be reached
+ */
+static void test_never_seen_paged(void) {
+    for (int count = 3; count <= MAX_DEVICES; count++) {
+        model_t m;
+        model_init(&m, count, NULL);
+        m.last_seen[0] = m.now - 600;
+        m.last_seen[1] = m.now - 60;
+
+        // Nobody home - every device is paged within the bound
+        for (int round = 0; round < m.plan.rounds_to_cover; round++) {
+            CHECK(run_round(&m) == -1, "answer with nobody home");
+        }
+        for (int i = 0; i < count; i++) {
+            CHECK(m.pages[i] > 0, "%d devices: device %d not paged in %d rounds", count, i, m.plan.rounds_to_cover);
+        }
+
+        // The never seen phone comes home and is found within the bound
+        int phone = count - 1;
+        m.present[phone] = true;
+        int rounds = 0;
+        while (run_round(&m) != phone) {
+            CHECK(++rounds < m.plan.rounds_to_cover, "%d devices: phone not found in %d rounds", count, rounds);
+        }
+
+        // Seen now, so it goes first and is found right away
+        int order[MAX_DEVICES];
+        probe_plan_next(&m.plan, m.last_seen, order);
+        CHECK(order[0] == phone, "%d devices: phone seen last is not paged first", count);
+    }
+}
+
+/**
+ * Devices that all fit in a round go most recently seen first, and
+ * devices that cannot be paged are left out
+ */
+static void test_fits(void) {
+    model_t m;
+    bool probe[3] = { true, false, true };
+    model_init(&m, 3, probe);
+    m.last_seen[0] = m.now - 100;
+    m.last_seen[1] = m.now;
+    m.last_seen[2] = m.now - 10;
+
+    int order[MAX_DEVICES];
+    int count = probe_plan_next(&m.plan, m.last_seen, order);
+    CHECK(m.plan.candidate_count == 2 && m.plan.page_ms == 1500, "%d candidates, %u ms pages",
+          m.plan.candidate_count, m.plan.page_ms);
+    CHECK(count == 2 && order[0] == 2 && order[1] == 0, "order %d: %d %d", count, order[0], order[1]);
+}
+
+int main(void) {
+    test_page_timeout();
+    test_never_seen_paged();
+    test_fits();
+    printf("test_probe_plan: ok\n");
+    return 0;
+}
@@ -0,0 +1,304 @@
+/**
+ * Decoder for the firmware's binary trace log (main/trace.h).
+ *
+ * Reads a dump and prints one line per record with its uptime, event name
+ * and text. The format strings come from main/trace_events.h, the same
+ * table the firmware was built with - they never exist on the device.
+ * Accepts either dump form:
+ *   - binary, as served by GET /trace on the metrics server:
+ *       curl -s http://<device-ip>:9100/trace -o dump.bin
+ *   - text, as printed by the "trace" console command; the hex lines
+ *     between the TRACE BEGIN/END markers are picked out of a captured
+ *     monitor log, skipping any log lines interleaved with them
+ *
+ *   trace_decode [dump]    (standard input if no file is given)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include "trace_events.h"
+#include "trace_ring.h"
+
+#define DUMP_BEGIN_MARKER "=== TRACE BEGIN ==="
+#define DUMP_END_MARKER "=== TRACE END ==="
+
+typedef struct {
+    const char* name;
+    const char* format;
+} event_info_t;
+
+static const event_info_t events[TRACE_EVENT_COUNT] = {
+#define TRACE_EVENT_INFO(name, format) { #name, format },
+    TRACE_EVENTS(TRACE_EVENT_INFO)
+#undef TRACE_EVENT_INFO
+};
+
+typedef struct {
+    uint32_t* words;
+    size_t count;
+    size_t capacity;
+} word_list_t;
+
+/**
+ * Append a word, growing the list as needed
+ */
+static void push_word(word_list_t* list, uint32_t word) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 1024;
+        list->words = realloc(list->words, list->capacity * sizeof(uint32_t));
+        if (list->words == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    list->words[list->count++] = word;
+}
+
+/**
+ * Read a whole stream into memory
+ */
+static unsigned char* read_all(FILE* in, size_t* size) {
+    size_t capacity = 65536;
+    unsigned char* data = malloc(capacity);
+    *size = 0;
+    while (data != NULL) {
+        *size += fread(data + *size, 1, capacity - *size, in);
+        if (*size < capacity) {
+            break;
+        }
+        capacity *= 2;
+        data = realloc(data, capacity);
+    }
+    if (data == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    return data;
+}
+
+/**
+ * Whether a line holds nothing but hex words
+ */
+static bool is_hex_line(const char* line) {
+    bool any = false;
+    for (; *line != '\0'; line++) {
+        if (isxdigit((unsigned char)*line)) {
+            any = true;
+        } else if (!isspace((unsigned char)*line)) {
+            return false;
+        }
+    }
+    return any;
+}
+
+/**
+ * Collect the words of a console dump from captured log text
+ * @return false if no dump was found
+ */
+static bool parse_text_dump(char* text, word_list_t* out) {
+    char* begin = strstr(text, DUMP_BEGIN_MARKER);
+    if (begin == NULL) {
+        return false;
+    }
+
+    char* save = NULL;
+    for (char* line = strtok_r(begin, "\n", &save); line != NULL; line = strtok_r(NULL, "\n", &save)) {
+        if (strstr(line, DUMP_END_MARKER) != NULL) {
+            break;
+        }
+        line[strcspn(line, "\r")] = '\0';
+        if (!is_hex_line(line)) {
+            continue;
+        }
+        char* end;
+        for (unsigned long word = strtoul(line, &end, 16); end != line; word = strtoul(line, &end, 16)) {
+            push_word(out, (uint32_t)word);
+            line = end;
+        }
+    }
+    return true;
+}
+
+/**
+ * Load the dump words from binary or text input
+ */
+static bool load_dump(unsigned char* data, size_t size, word_list_t* out) {
+    if (size >= 4 && (data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24) == TRACE_DUMP_MAGIC) {
+        for (size_t i = 0; i + 4 <= size; i += 4) {
+            push_word(out, data[i] | data[i + 1] << 8 | data[i + 2] << 16 | (uint32_t)data[i + 3] << 24);
+        }
+        return true;
+    }
+
+    char* text = malloc(size + 1);
+    if (text == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    memcpy(text, data, size);
+    text[size] = '\0';
+    bool found = parse_text_dump(text, out);
+    free(text);
+    return found;
+}
+
+/**
+ * Expand a format string with 32-bit arguments
+ *
+ * Each conversion is printed on its own with the argument cast to the
+ * type it names, so nothing depends on how the host passes varargs.
+ */
+static void format_event(const char* format, const uint32_t* args, unsigned nargs, char* buf, size_t size) {
+    size_t len = 0;
+    unsigned next = 0;
+
+    while (*format != '\0' && len + 1 < size) {
+        if (*format != '%') {
+            buf[len++] = *format++;
+            continue;
+        }
+        if (format[1] == '%') {
+            buf[len++] = '%';
+            format += 2;
+            continue;
+        }
+
+        // Flags, width and precision, then the conversion
+        size_t spec_len = 1 + strspn(format + 1, "-+ #0");
+        spec_len += strspn(format + spec_len, "0123456789");
+        if (format[spec_len] == '.') {
+            spec_len += 1 + strspn(format + spec_len + 1, "0123456789");
+        }
+        char conversion = format[spec_len];
+        char spec[16];
+        if (conversion == '\0' || strchr("diuxXc", conversion) == NULL || spec_len + 2 > sizeof(spec)) {
+            len += snprintf(buf + len, size - len, "<bad format>");
+            break;
+        }
+        memcpy(spec, format, spec_len + 1);
+        spec[spec_len + 1] = '\0';
+        format += spec_len + 1;
+
+        int written;
+        if (next >= nargs) {
+            written = snprintf(buf + len, size - len, "?");
+        } else if (conversion == 'd' || conversion == 'i' || conversion == 'c') {
+            written = snprintf(buf + len, size - len, spec, (int)(int32_t)args[next]);
+        } else {
+            written = snprintf(buf + len, size - len, spec, (unsigned)args[next]);
+        }
+        next++;
+        if (written > 0) {
+            len += (size_t)written;
+        }
+        if (len >= size) {
+            len = size - 1;
+        }
+    }
+    buf[len] = '\0';
+}
+
+/**
+ * Print every record of a dump
+ * @return Number of records printed
+ */
+static size_t print_records(const uint32_t* words, size_t count, uint64_t now_us) {
+    // Records carry the low 32 bits of the timestamp - unwrap them going
+    // forward, then anchor the newest one just before the dump time
+    size_t records = 0;
+    uint64_t elapsed_us = 0;
+    uint32_t first_us = 0;
+    uint32_t last_us = 0;
+    for (size_t i = 0; i + 2 <= count; i += 2 + TRACE_RING_HEADER_NARGS(words[i])) {
+        if (records == 0) {
+            first_us = words[i + 1];
+        } else {
+            elapsed_us += (uint32_t)(words[i + 1] - last_us);
+        }
+        last_us = words[i + 1];
+        records++;
+    }
+    uint64_t newest_us = now_us - (uint32_t)((uint32_t)now_us - last_us);
+    uint64_t base_us = newest_us - elapsed_us;
+
+    uint32_t previous_us = first_us;
+    uint64_t at_us = base_us;
+    size_t printed = 0;
+    for (size_t i = 0; i + 2 <= count;) {
+        unsigned id = TRACE_RING_HEADER_ID(words[i]);
+        unsigned nargs = TRACE_RING_HEADER_NARGS(words[i]);
+        if (nargs > TRACE_RING_MAX_ARGS || i + 2 + nargs > count) {
+            fprintf(stderr, "Dump truncated or corrupt at word %zu\n", i);
+            break;
+        }
+        at_us += (uint32_t)(words[i + 1] - previous_us);
+        previous_us = words[i + 1];
+
+        char text[256];
+        const char* name = "UNKNOWN";
+        if (id < TRACE_EVENT_COUNT) {
+            name = events[id].name;
+            format_event(events[id].format, &words[i + 2], nargs, text, sizeof(text));
+        } else {
+            int len = snprintf(text, sizeof(text), "event %u:", id);
+            for (unsigned a = 0; a < nargs && len > 0 && (size_t)len < sizeof(text); a++) {
+                len += snprintf(text + len, sizeof(text) - len, " 0x%08x", (unsigned)words[i + 2 + a]);
+            }
+        }
+        printf("%6lu.%06lu  %-24s %s\n", (unsigned long)(at_us / 1000000), (unsigned long)(at_us % 1000000),
+               name, text);
+
+        i += 2 + nargs;
+        printed++;
+    }
+    return printed;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "-h") == 0)) {
+        fprintf(stderr, "usage: %s [dump]\n"
+                        "Decode a trace dump from GET /trace (binary) or the \"trace\" console command (text)\n",
+                argv[0]);
+        return 2;
+    }
+
+    FILE* in = stdin;
+    if (argc == 2 && (in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    size_t size;
+    unsigned char* data = read_all(in, &size);
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    word_list_t dump = { 0 };
+    if (!load_dump(data, size, &dump)) {
+        fprintf(stderr, "No trace dump found\n");
+        return 1;
+    }
+    free(data);
+    if (dump.count < TRACE_DUMP_HEADER_WORDS || dump.words[0] != TRACE_DUMP_MAGIC) {
+        fprintf(stderr, "Not a trace dump (bad header)\n");
+        return 1;
+    }
+
+    uint32_t event_count = dump.words[1];
+    uint64_t now_us = dump.words[2] | (uint64_t)dump.words[3] << 32;
+    uint32_t overwritten = dump.words[4];
+    if (event_count != TRACE_EVENT_COUNT) {
+        fprintf(stderr, "Warning: firmware has %lu trace events, this decoder %d - rebuild it from the same tree\n",
+                (unsigned long)event_count, TRACE_EVENT_COUNT);
+    }
+
+    size_t records = print_records(dump.words + TRACE_DUMP_HEADER_WORDS, dump.count - TRACE_DUMP_HEADER_WORDS, now_us);
+    printf("%zu records up to %lu.%06lu s uptime, %lu older records overwritten\n", records,
+           (unsigned long)(now_us / 1000000), (unsigned long)(now_us % 1000000), (unsigned long)overwritten);
+    free(dump.words);
+    return 0;
+}
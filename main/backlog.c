@@ -0,0 +1,100 @@
+#include "backlog.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Reset to empty
+ */
+void backlog_init(backlog_t* b) {
+    b->head = 0;
+    b->tail = 0;
+    b->count = 0;
+}
+
+/**
+ * Store an entry at the tail, evicting the oldest when full
+ */
+bool backlog_store(backlog_t* b, const backlog_entry_t* entry, backlog_entry_t* evicted) {
+    bool full = b->count >= MAX_QUEUED_MESSAGES;
+    if (full) {
+        backlog_pop(b, evicted);
+    }
+
+    b->entries[b->tail] = *entry;
+    b->tail = (b->tail + 1) % MAX_QUEUED_MESSAGES;
+    b->count++;
+    return full;
+}
+
+/**
+ * Entry at position i counted from the head, NULL past the tail
+ */
+const backlog_entry_t* backlog_peek(const backlog_t* b, int i) {
+    if (i < 0 || i >= b->count) {
+        return NULL;
+    }
+    return &b->entries[(b->head + i) % MAX_QUEUED_MESSAGES];
+}
+
+/**
+ * Remove the head entry
+ */
+bool backlog_pop(backlog_t* b, backlog_entry_t* out) {
+    if (b->count == 0) {
+        return false;
+    }
+    if (out != NULL) {
+        *out = b->entries[b->head];
+    }
+    b->head = (b->head + 1) % MAX_QUEUED_MESSAGES;
+    b->count--;
+    return true;
+}
+
+/**
+ * Pack as many entries as fit into one multi-line body
+ */
+int backlog_build_flush_body(const backlog_t* b, char* body, size_t max_len) {
+    // Reserve room for the summary line - the full backlog count is the longest it can get
+    char header[32];
+    size_t reserved = snprintf(header, sizeof(header), "📋 %d queued events:\n", b->count);
+    size_t len = 0;
+    int packed = 0;
+
+    while (packed < b->count) {
+        char line[DOOR_RECORD_TEXT_MAX];
+        size_t line_len = door_record_render(&backlog_peek(b, packed)->record, line, sizeof(line));
+        size_t needed = line_len + (packed > 0 ? 1 : 0);
+
+        // The first line always fits since max_len exceeds DOOR_RECORD_TEXT_MAX
+        if (reserved + len + needed > max_len) {
+            break;
+        }
+        if (packed > 0) {
+            body[reserved + len++] = '\n';
+        }
+        memcpy(body + reserved + len, line, line_len);
+        len += line_len;
+        packed++;
+    }
+
+    // A lone message goes out exactly as it was queued
+    size_t header_len = 0;
+    if (packed > 1) {
+        header_len = snprintf(header, sizeof(header), "📋 %d queued events:\n", packed);
+    }
+    memmove(body + header_len, body + reserved, len);
+    memcpy(body, header, header_len);
+    body[header_len + len] = '\0';
+    return packed;
+}
+
+/**
+ * Delay before the next retry after a failed send
+ */
+uint32_t backlog_retry_backoff(uint32_t delay_ms, bool online) {
+    if (!online) {
+        return BACKLOG_RETRY_MIN_MS;
+    }
+    return (delay_ms * 2 > BACKLOG_RETRY_MAX_MS) ? BACKLOG_RETRY_MAX_MS : delay_ms * 2;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "door_record.h"
+
+/**
+ * Retry backlog of door records that could not be delivered yet.
+ *
+ * A fixed ring that evicts its oldest entry when full, the multi-line body
+ * used to flush several entries in one publish, and the retry backoff.
+ * Pure C with no ESP-IDF dependencies so delivery can be simulated on a host.
+ */
+
+// Retry backlog capacity - 16 bytes per entry
+#define MAX_QUEUED_MESSAGES 256
+
+// Retry delay after a failed send while online, doubling up to the maximum
+#define BACKLOG_RETRY_MIN_MS 1000
+#define BACKLOG_RETRY_MAX_MS 60000
+
+// Retry backlog entry - the record plus where it lives in the flash log
+typedef struct {
+    door_record_t record;
+    uint32_t log_seq;           // Write-ahead log sequence, 0 if not logged
+} backlog_entry_t;
+
+typedef struct {
+    backlog_entry_t entries[MAX_QUEUED_MESSAGES];
+    int head;
+    int tail;
+    int count;
+} backlog_t;
+
+/**
+ * Reset to empty
+ */
+void backlog_init(backlog_t* b);
+
+/**
+ * Store an entry at the tail, evicting the oldest when full
+ * @param evicted Set to the oldest entry if it had to make room
+ * @return true if an entry was evicted into *evicted
+ */
+bool backlog_store(backlog_t* b, const backlog_entry_t* entry, backlog_entry_t* evicted);
+
+/**
+ * Entry at position i counted from the head, NULL past the tail
+ */
+const backlog_entry_t* backlog_peek(const backlog_t* b, int i);
+
+/**
+ * Remove the head entry
+ */
+bool backlog_pop(backlog_t* b, backlog_entry_t* out);
+
+/**
+ * Pack as many entries as fit into one multi-line body
+ * @return number of entries packed, starting at the head
+ */
+int backlog_build_flush_body(const backlog_t* b, char* body, size_t max_len);
+
+/**
+ * Delay before the next retry after a failed send
+ * @param online Whether the network was up - offline sends retry at the minimum
+ */
+uint32_t backlog_retry_backoff(uint32_t delay_ms, bool online);
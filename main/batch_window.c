@@ -0,0 +1,83 @@
+#include "batch_window.h"
+
+// Upper bound of each bucket but the last, roughly two per doubling
+static const uint32_t bucket_bound_ms[BATCH_WINDOW_BUCKETS - 1] = {
+    1000, 2000, 3000, 4000, 6000, 8000, 12000, 16000,
+    24000, 32000, 48000, 64000, 96000, 128000, 192000,
+};
+
+/**
+ * Initialize an empty histogram - the window starts at max_ms
+ */
+void batch_window_init(batch_window_t* w, uint8_t percentile, uint32_t min_ms, uint32_t max_ms) {
+    for (int i = 0; i < BATCH_WINDOW_BUCKETS; i++) {
+        w->counts[i] = 0;
+    }
+    w->total = 0;
+    w->percentile = percentile;
+    w->min_ms = min_ms;
+    w->max_ms = (max_ms > min_ms) ? max_ms : min_ms;
+    w->timeout_ms = w->max_ms;
+}
+
+/**
+ * Window for the current histogram
+ */
+static uint32_t compute_timeout(const batch_window_t* w) {
+    if (w->total < BATCH_WINDOW_MIN_SAMPLES) {
+        return w->max_ms;
+    }
+
+    // Smallest bucket whose cumulative count reaches the percentile
+    uint32_t target = ((uint32_t)w->total * w->percentile + 99) / 100;
+    uint32_t seen = 0;
+    int bucket = 0;
+    for (; bucket < BATCH_WINDOW_BUCKETS - 1; bucket++) {
+        seen += w->counts[bucket];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    uint32_t timeout_ms = (bucket < BATCH_WINDOW_BUCKETS - 1) ? bucket_bound_ms[bucket] : w->max_ms;
+    if (timeout_ms < w->min_ms) {
+        timeout_ms = w->min_ms;
+    }
+    if (timeout_ms > w->max_ms) {
+        timeout_ms = w->max_ms;
+    }
+    return timeout_ms;
+}
+
+/**
+ * Record one OPEN -> CLOSE gap
+ */
+bool batch_window_add(batch_window_t* w, uint32_t gap_ms) {
+    int bucket = 0;
+    while (bucket < BATCH_WINDOW_BUCKETS - 1 && gap_ms > bucket_bound_ms[bucket]) {
+        bucket++;
+    }
+
+    if (w->total >= BATCH_WINDOW_HISTORY) {
+        // Age the history so recent gaps weigh more
+        w->total = 0;
+        for (int i = 0; i < BATCH_WINDOW_BUCKETS; i++) {
+            w->counts[i] /= 2;
+            w->total += w->counts[i];
+        }
+    }
+    w->counts[bucket]++;
+    w->total++;
+
+    uint32_t timeout_ms = compute_timeout(w);
+    bool changed = timeout_ms != w->timeout_ms;
+    w->timeout_ms = timeout_ms;
+    return changed;
+}
+
+/**
+ * Current window in milliseconds
+ */
+uint32_t batch_window_timeout_ms(const batch_window_t* w) {
+    return w->timeout_ms;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Batching window learned from how long a door usually stays open.
+ *
+ * Every OPEN -> CLOSE gap goes into a small histogram with roughly
+ * logarithmic buckets. The window is the upper bound of the bucket that
+ * holds the chosen percentile, clamped to [min_ms, max_ms], so an unmatched
+ * OPEN is reported about as soon as it stops looking like a normal visit.
+ * Counts are halved whenever the total reaches BATCH_WINDOW_HISTORY, which
+ * lets the histogram follow changing habits. Until BATCH_WINDOW_MIN_SAMPLES
+ * gaps have been seen the window stays at max_ms.
+ * Pure C with no ESP-IDF dependencies so gap traces can be replayed on a host.
+ */
+
+#define BATCH_WINDOW_BUCKETS 16       // Last bucket holds gaps longer than any bound
+#define BATCH_WINDOW_HISTORY 64       // Halve all counts once this many gaps are held
+#define BATCH_WINDOW_MIN_SAMPLES 8    // Gaps needed before the histogram is trusted
+
+typedef struct {
+    uint16_t counts[BATCH_WINDOW_BUCKETS];
+    uint16_t total;
+    uint8_t percentile;         // 1-99
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t timeout_ms;        // Current window
+} batch_window_t;
+
+/**
+ * Initialize an empty histogram - the window starts at max_ms
+ */
+void batch_window_init(batch_window_t* w, uint8_t percentile, uint32_t min_ms, uint32_t max_ms);
+
+/**
+ * Record one OPEN -> CLOSE gap
+ * @return true if the window changed
+ */
+bool batch_window_add(batch_window_t* w, uint32_t gap_ms);
+
+/**
+ * Current window in milliseconds
+ */
+uint32_t batch_window_timeout_ms(const batch_window_t* w);
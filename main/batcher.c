@@ -0,0 +1,140 @@
+#include "batcher.h"
+#include <stddef.h>
+
+#define SLOT(b, i) (&(b)->entries[((b)->head + (i)) & (BATCHER_SIZE - 1)])
+
+/**
+ * Reset to empty
+ */
+void batcher_init(batcher_t* b) {
+    b->head = 0;
+    b->count = 0;
+    b->merged = 0;
+    b->evicted = 0;
+}
+
+/**
+ * Append a single event entry, evicting the oldest if the ring is full
+ */
+static bool push_entry(batcher_t* b, uint8_t kind, uint32_t timestamp, uint8_t time_quality, uint32_t probe_ticket,
+                       batch_entry_t* evicted) {
+    bool full = b->count == BATCHER_SIZE;
+    if (full) {
+        batcher_pop_oldest(b, evicted);
+        b->evicted++;
+    }
+
+    batch_entry_t* entry = SLOT(b, b->count++);
+    entry->kind = kind;
+    entry->first = timestamp;
+    entry->last = timestamp;
+    entry->probe_ticket = probe_ticket;
+    entry->cycles = 0;
+    entry->time_quality = time_quality;
+    return full;
+}
+
+/**
+ * Add one door event
+ */
+bool batcher_add(batcher_t* b, bool open, uint32_t timestamp, uint8_t time_quality, uint32_t probe_ticket,
+                 batch_entry_t* evicted) {
+    batch_entry_t* newest = (b->count > 0) ? SLOT(b, b->count - 1) : NULL;
+
+    if (open || newest == NULL || newest->kind != BATCH_OPEN) {
+        return push_entry(b, open ? BATCH_OPEN : BATCH_CLOSE, timestamp, time_quality, probe_ticket, evicted);
+    }
+
+    // CLOSE completes the waiting OPEN
+    batch_entry_t* previous = (b->count > 1) ? SLOT(b, b->count - 2) : NULL;
+    if (previous != NULL && previous->kind == BATCH_CYCLES) {
+        // Back-to-back cycles - extend the run and drop the OPEN
+        if (previous->cycles < UINT16_MAX) {
+            previous->cycles++;
+        }
+        previous->last = timestamp;
+        uint8_t worst = (time_quality > newest->time_quality) ? time_quality : newest->time_quality;
+        if (worst > previous->time_quality) {
+            previous->time_quality = worst;
+        }
+        b->count--;
+        b->merged++;
+    } else {
+        newest->kind = BATCH_CYCLES;
+        newest->cycles = 1;
+        newest->last = timestamp;
+        if (time_quality > newest->time_quality) {
+            newest->time_quality = time_quality;
+        }
+    }
+    return false;
+}
+
+/**
+ * Newest entry, NULL if empty
+ */
+const batch_entry_t* batcher_newest(const batcher_t* b) {
+    return (b->count > 0) ? SLOT(b, b->count - 1) : NULL;
+}
+
+/**
+ * Oldest entry, NULL if empty
+ */
+const batch_entry_t* batcher_oldest(const batcher_t* b) {
+    return (b->count > 0) ? SLOT(b, 0) : NULL;
+}
+
+/**
+ * Remove the newest entry
+ */
+bool batcher_pop_newest(batcher_t* b, batch_entry_t* out) {
+    if (b->count == 0) {
+        return false;
+    }
+    *out = *SLOT(b, b->count - 1);
+    b->count--;
+    return true;
+}
+
+/**
+ * Remove the oldest entry
+ */
+bool batcher_pop_oldest(batcher_t* b, batch_entry_t* out) {
+    if (b->count == 0) {
+        return false;
+    }
+    *out = *SLOT(b, 0);
+    b->head = (b->head + 1) & (BATCHER_SIZE - 1);
+    b->count--;
+    return true;
+}
+
+/**
+ * Take the only entry if it is a single OPEN -> CLOSE pair that may go out now
+ */
+bool batcher_take_pair(batcher_t* b, bool delivery_busy, batch_entry_t* out) {
+    const batch_entry_t* newest = batcher_newest(b);
+    if (delivery_busy || b->count != 1 || newest->kind != BATCH_CYCLES || newest->cycles != 1) {
+        return false;
+    }
+    return batcher_pop_newest(b, out);
+}
+
+/**
+ * Whether the oldest entry only waits for delivery to catch up
+ */
+bool batcher_held(const batcher_t* b) {
+    const batch_entry_t* oldest = batcher_oldest(b);
+    // An OPEN behind which more events arrived will never get its CLOSE
+    return oldest != NULL && (oldest->kind != BATCH_OPEN || b->count > 1);
+}
+
+/**
+ * Take the oldest entry if it is held and delivery has caught up
+ */
+bool batcher_take_held(batcher_t* b, bool delivery_busy, batch_entry_t* out) {
+    if (delivery_busy || !batcher_held(b)) {
+        return false;
+    }
+    return batcher_pop_oldest(b, out);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Bounded ring of door events waiting to be notified, with run-length
+ * compression of busy doors.
+ *
+ * An OPEN followed by a CLOSE folds into a single cycle entry, and a cycle
+ * right behind another cycle entry joins it as a run that keeps only the
+ * cycle count and the first and last timestamps. Every insert and removal
+ * is O(1) and memory is fixed: when the ring is full the oldest entry is
+ * evicted and handed back to the caller to be sent on its own.
+ *
+ * Entries leave oldest first. Only the newest entry can still change, so
+ * everything older is complete and just waits for delivery to catch up.
+ *
+ * Pure C with no ESP-IDF dependencies so high-rate traffic can be replayed
+ * on a host.
+ */
+
+// Ring capacity - must be a power of two
+#define BATCHER_SIZE 8
+
+_Static_assert((BATCHER_SIZE & (BATCHER_SIZE - 1)) == 0, "BATCHER_SIZE must be a power of two");
+
+// What an entry holds
+typedef enum {
+    BATCH_OPEN,                 // OPEN still waiting for its CLOSE
+    BATCH_CLOSE,                // CLOSE without an OPEN before it
+    BATCH_CYCLES,               // One or more complete OPEN -> CLOSE cycles
+} batch_kind_t;
+
+typedef struct {
+    uint32_t first;             // Wall clock seconds of the first event
+    uint32_t last;              // Wall clock seconds of the last event
+    uint32_t probe_ticket;      // Presence probe started at the first event, 0 if none
+    uint16_t cycles;            // BATCH_CYCLES: number of cycles, saturating
+    uint8_t kind;               // batch_kind_t
+    uint8_t time_quality;       // Worst clock quality among its events (time_quality_t, higher is worse)
+} batch_entry_t;
+
+typedef struct {
+    batch_entry_t entries[BATCHER_SIZE];
+    uint32_t head;              // Oldest entry
+    uint32_t count;
+    uint32_t merged;            // Cycles folded into an earlier run
+    uint32_t evicted;           // Entries pushed out of a full ring
+} batcher_t;
+
+/**
+ * Reset to empty
+ */
+void batcher_init(batcher_t* b);
+
+/**
+ * Add one door event
+ * @param open true for OPEN, false for CLOSE
+ * @param time_quality How far the timestamp can be trusted, higher is worse
+ * @param evicted Set to the oldest entry if it had to make room
+ * @return true if an entry was evicted into *evicted
+ */
+bool batcher_add(batcher_t* b, bool open, uint32_t timestamp, uint8_t time_quality, uint32_t probe_ticket,
+                 batch_entry_t* evicted);
+
+/**
+ * Newest entry, NULL if empty
+ */
+const batch_entry_t* batcher_newest(const batcher_t* b);
+
+/**
+ * Oldest entry, NULL if empty
+ */
+const batch_entry_t* batcher_oldest(const batcher_t* b);
+
+/**
+ * Remove the newest entry
+ */
+bool batcher_pop_newest(batcher_t* b, batch_entry_t* out);
+
+/**
+ * Remove the oldest entry
+ */
+bool batcher_pop_oldest(batcher_t* b, batch_entry_t* out);
+
+/**
+ * Take the only entry if it is a single OPEN -> CLOSE pair that may go out
+ * now. While delivery is busy the pair stays, so that further cycles join
+ * it as a run instead of queueing one notification each, and a pair behind
+ * older entries waits its turn.
+ */
+bool batcher_take_pair(batcher_t* b, bool delivery_busy, batch_entry_t* out);
+
+/**
+ * Whether the oldest entry only waits for delivery to catch up - anything
+ * but an OPEN still waiting for its CLOSE
+ */
+bool batcher_held(const batcher_t* b);
+
+/**
+ * Take the oldest entry if it is held and delivery has caught up
+ */
+bool batcher_take_held(batcher_t* b, bool delivery_busy, batch_entry_t* out);
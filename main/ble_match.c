@@ -0,0 +1,118 @@
+#include "ble_match.h"
+#include <string.h>
+
+/**
+ * Start an empty identity table
+ */
+void ble_match_init(ble_match_t* match, ble_match_aes128_t aes128) {
+    memset(match, 0, sizeof(*match));
+    match->aes128 = aes128;
+}
+
+/**
+ * Add an identity - either pointer may be NULL, not both
+ */
+int ble_match_add(ble_match_t* match, const uint8_t addr[6], const uint8_t irk[16]) {
+    if (match->count >= BLE_MATCH_MAX_IDENTITIES || (addr == NULL && irk == NULL)) {
+        return -1;
+    }
+
+    ble_identity_t* identity = &match->identities[match->count];
+    memset(identity, 0, sizeof(*identity));
+    if (addr != NULL) {
+        memcpy(identity->addr, addr, sizeof(identity->addr));
+        identity->has_addr = true;
+    }
+    if (irk != NULL) {
+        memcpy(identity->irk, irk, sizeof(identity->irk));
+        identity->has_irk = true;
+        match->unknown_count = 0;   // A cached stranger may be this identity
+        match->unknown_next = 0;
+    }
+    return match->count++;
+}
+
+/**
+ * Whether an address is a resolvable private address
+ */
+bool ble_match_is_rpa(const uint8_t addr[6], bool random) {
+    // Two most significant bits 0b01
+    return random && (addr[0] & 0xC0) == 0x40;
+}
+
+/**
+ * Random address hash function ah(k, r) compared against the address hash
+ */
+static bool rpa_matches_irk(ble_match_t* match, const uint8_t irk[16], const uint8_t addr[6]) {
+    // r' = padding || prand, prand being the upper 24 bits of the address
+    uint8_t plaintext[16] = {0};
+    uint8_t encrypted[16];
+    memcpy(&plaintext[13], &addr[0], 3);
+
+    match->aes128(irk, plaintext, encrypted);
+    match->resolutions++;
+
+    // ah() keeps the lower 24 bits, which must equal the hash (lower half of the address)
+    return memcmp(&encrypted[13], &addr[3], 3) == 0;
+}
+
+/**
+ * Find the identity an advertiser address belongs to
+ */
+int ble_match_resolve(ble_match_t* match, const uint8_t addr[6], bool random) {
+    bool rpa = ble_match_is_rpa(addr, random);
+
+    // Fixed addresses and already resolved private addresses are plain compares
+    for (int i = 0; i < match->count; i++) {
+        ble_identity_t* identity = &match->identities[i];
+        if (identity->has_addr && memcmp(identity->addr, addr, 6) == 0) {
+            return i;
+        }
+        if (rpa && identity->has_last_rpa && memcmp(identity->last_rpa, addr, 6) == 0) {
+            return i;
+        }
+    }
+
+    if (!rpa || match->aes128 == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < match->unknown_count; i++) {
+        if (memcmp(match->unknown_rpa[i], addr, 6) == 0) {
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < match->count; i++) {
+        ble_identity_t* identity = &match->identities[i];
+        if (identity->has_irk && rpa_matches_irk(match, identity->irk, addr)) {
+            memcpy(identity->last_rpa, addr, sizeof(identity->last_rpa));
+            identity->has_last_rpa = true;
+            return i;
+        }
+    }
+
+    memcpy(match->unknown_rpa[match->unknown_next], addr, 6);
+    match->unknown_next = (match->unknown_next + 1) % BLE_MATCH_UNKNOWN_CACHE;
+    if (match->unknown_count < BLE_MATCH_UNKNOWN_CACHE) {
+        match->unknown_count++;
+    }
+    return -1;
+}
+
+/**
+ * Device seen most recently, if that was less than ttl_s seconds before now
+ */
+int ble_match_most_recent(const time_t* last_seen, int count, time_t now, uint32_t ttl_s) {
+    int newest = -1;
+    for (int i = 0; i < count; i++) {
+        time_t seen = last_seen[i];
+        // A sighting stamped after now came before the clock was stepped back - don't trust it
+        if (seen == 0 || seen > now || now - seen >= (time_t)ttl_s) {
+            continue;
+        }
+        if (newest < 0 || seen > last_seen[newest]) {
+            newest = i;
+        }
+    }
+    return newest;
+}
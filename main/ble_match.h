@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+/**
+ * Matching of BLE advertiser addresses against known identities.
+ *
+ * An identity is either a fixed address (public or static random) or an
+ * identity resolving key (IRK). Phones advertise with resolvable private
+ * addresses that change every few minutes; such an address belongs to an
+ * IRK when ah(IRK, prand) equals its hash part (Core spec Vol 3 Part H
+ * 2.2.2). The last address resolved for each identity is remembered so a
+ * stream of advertisements costs one AES operation, not one per packet.
+ * Private addresses that resolved to nobody - the neighbours' phones - are
+ * kept in a small ring for the same reason.
+ *
+ * A door event is then matched against the sightings: the device seen
+ * most recently counts if that was less than the presence TTL ago.
+ *
+ * Pure C with no ESP-IDF dependencies - AES-128 is supplied by the caller
+ * so matching can be exercised on a host.
+ */
+
+// Known identities - one per authorized device
+#define BLE_MATCH_MAX_IDENTITIES 8
+
+// Private addresses remembered as belonging to nobody we know
+#define BLE_MATCH_UNKNOWN_CACHE 16
+
+// Encrypt one 16-byte block with AES-128, all buffers most significant byte first
+typedef void (*ble_match_aes128_t)(const uint8_t key[16], const uint8_t in[16], uint8_t out[16]);
+
+typedef struct {
+    uint8_t addr[6];            // Fixed address, most significant byte first
+    bool has_addr;
+    uint8_t irk[16];            // Identity resolving key, most significant byte first
+    bool has_irk;
+    uint8_t last_rpa[6];        // Last private address resolved with irk
+    bool has_last_rpa;
+} ble_identity_t;
+
+typedef struct {
+    ble_identity_t identities[BLE_MATCH_MAX_IDENTITIES];
+    int count;
+    uint8_t unknown_rpa[BLE_MATCH_UNKNOWN_CACHE][6];
+    int unknown_count;
+    int unknown_next;           // Slot the next unknown address overwrites
+    ble_match_aes128_t aes128;
+    uint32_t resolutions;       // AES operations spent resolving addresses
+} ble_match_t;
+
+/**
+ * Start an empty identity table
+ */
+void ble_match_init(ble_match_t* match, ble_match_aes128_t aes128);
+
+/**
+ * Add an identity - either pointer may be NULL, not both
+ * @return index of the identity, -1 if the table is full
+ */
+int ble_match_add(ble_match_t* match, const uint8_t addr[6], const uint8_t irk[16]);
+
+/**
+ * Whether an address is a resolvable private address
+ */
+bool ble_match_is_rpa(const uint8_t addr[6], bool random);
+
+/**
+ * Find the identity an advertiser address belongs to
+ * @param random Address type from the advertising report
+ * @return identity index, -1 if unknown
+ */
+int ble_match_resolve(ble_match_t* match, const uint8_t addr[6], bool random);
+
+/**
+ * Device seen most recently, if that was less than ttl_s seconds before now
+ * @param last_seen Wall clock of each device's last sighting, 0 if never
+ * @return device index, -1 if none was seen within the TTL
+ */
+int ble_match_most_recent(const time_t* last_seen, int count, time_t now, uint32_t ttl_s);
@@ -0,0 +1,96 @@
+#include "clock_drift.h"
+
+#define DRIFT_SMOOTHING 4           // New measurements weigh 1/4
+
+/**
+ * Start with no sync and no rate estimate
+ */
+void clock_drift_init(clock_drift_t* c, uint32_t tolerance_ms) {
+    c->last_sync_us = 0;
+    c->drift_ppb = 0;
+    c->samples = 0;
+    c->tolerance_ms = tolerance_ms;
+}
+
+/**
+ * Record a sync
+ */
+void clock_drift_sync(clock_drift_t* c, int64_t local_us, int64_t reference_us, bool measured) {
+    int64_t elapsed_us = reference_us - c->last_sync_us;
+
+    if (measured && c->last_sync_us != 0 && elapsed_us >= (int64_t)CLOCK_DRIFT_MIN_SAMPLE_S * 1000000) {
+        int64_t offset_us = reference_us - local_us;
+        int64_t ppb = offset_us * 1000 / (elapsed_us / 1000000);
+        if (ppb > INT32_MAX) {
+            ppb = INT32_MAX;
+        } else if (ppb < -INT32_MAX) {
+            ppb = -INT32_MAX;
+        }
+
+        if (c->samples == 0) {
+            c->drift_ppb = (int32_t)ppb;
+        } else {
+            c->drift_ppb += (int32_t)((ppb - c->drift_ppb) / DRIFT_SMOOTHING);
+        }
+        if (c->samples < UINT16_MAX) {
+            c->samples++;
+        }
+    }
+    c->last_sync_us = reference_us;
+}
+
+/**
+ * Rate error to plan with, in parts per billion
+ */
+static int64_t planning_ppb(const clock_drift_t* c) {
+    if (c->samples == 0) {
+        return CLOCK_DRIFT_ASSUMED_PPB;
+    }
+    int64_t ppb = (c->drift_ppb < 0) ? -(int64_t)c->drift_ppb : c->drift_ppb;
+    return (ppb < CLOCK_DRIFT_FLOOR_PPB) ? CLOCK_DRIFT_FLOOR_PPB : ppb;
+}
+
+/**
+ * Estimated absolute clock error now, in microseconds
+ */
+int64_t clock_drift_error_us(const clock_drift_t* c, int64_t now_us) {
+    if (c->last_sync_us == 0) {
+        return INT64_MAX;
+    }
+    int64_t elapsed_s = (now_us - c->last_sync_us) / 1000000;
+    if (elapsed_s < 0) {
+        elapsed_s = -elapsed_s;     // Clock stepped back - still time spent unsynced
+    }
+    return elapsed_s * planning_ppb(c) / 1000;
+}
+
+/**
+ * Quality of a timestamp taken now
+ */
+time_quality_t clock_drift_quality(const clock_drift_t* c, int64_t now_us) {
+    if (c->last_sync_us == 0) {
+        return TIME_QUALITY_UNSYNCED;
+    }
+    if (clock_drift_error_us(c, now_us) > (int64_t)c->tolerance_ms * 1000) {
+        return TIME_QUALITY_DRIFTING;
+    }
+    return TIME_QUALITY_SYNCED;
+}
+
+/**
+ * Wall clock time the next resync is due, 0 if one is due right away
+ */
+int64_t clock_drift_next_sync_us(const clock_drift_t* c) {
+    if (c->last_sync_us == 0) {
+        return 0;
+    }
+
+    // Resync when the estimated error reaches half the tolerance
+    int64_t interval_s = (int64_t)c->tolerance_ms * 1000 / 2 * 1000 / planning_ppb(c);
+    if (interval_s < CLOCK_DRIFT_MIN_INTERVAL_S) {
+        interval_s = CLOCK_DRIFT_MIN_INTERVAL_S;
+    } else if (interval_s > CLOCK_DRIFT_MAX_INTERVAL_S) {
+        interval_s = CLOCK_DRIFT_MAX_INTERVAL_S;
+    }
+    return c->last_sync_us + interval_s * 1000000;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Wall clock drift estimate between time syncs.
+ *
+ * Every sync compares the local clock against the reference and turns the
+ * offset, divided by the time since the previous sync, into a rate error
+ * in parts per billion, smoothed over recent syncs. From that rate the
+ * estimated clock error at any moment follows, which decides how
+ * trustworthy a timestamp is and when the next resync is due - a clock
+ * known to be accurate skips resyncs until its error nears the tolerance.
+ * Until a rate has been measured, CLOCK_DRIFT_ASSUMED_PPB is used.
+ * Pure C with no ESP-IDF dependencies so it also builds on a host.
+ */
+
+#define CLOCK_DRIFT_ASSUMED_PPB 200000          // 200 ppm until measured (RTC slow clock in deep sleep)
+#define CLOCK_DRIFT_FLOOR_PPB 20000             // Never trust the rate below crystal tolerance
+#define CLOCK_DRIFT_MIN_SAMPLE_S 600            // Shorter gaps are dominated by NTP jitter
+#define CLOCK_DRIFT_MIN_INTERVAL_S (15 * 60)
+#define CLOCK_DRIFT_MAX_INTERVAL_S (24 * 60 * 60)
+
+// How far a timestamp can be trusted
+typedef enum {
+    TIME_QUALITY_SYNCED = 0,    // Estimated error within the tolerance
+    TIME_QUALITY_DRIFTING = 1,  // Synced once, but may have drifted past the tolerance
+    TIME_QUALITY_UNSYNCED = 2,  // Never synced - the wall clock is meaningless
+} time_quality_t;
+
+typedef struct {
+    int64_t last_sync_us;       // Reference wall clock at the last sync, 0 if never synced
+    int32_t drift_ppb;          // Local clock rate error, positive when it runs slow
+    uint16_t samples;           // Rate measurements folded into drift_ppb
+    uint32_t tolerance_ms;
+} clock_drift_t;
+
+/**
+ * Start with no sync and no rate estimate
+ */
+void clock_drift_init(clock_drift_t* c, uint32_t tolerance_ms);
+
+/**
+ * Record a sync
+ * @param local_us Local wall clock when the reference was taken
+ * @param reference_us Reference wall clock
+ * @param measured false if the clock was stepped without a usable offset
+ */
+void clock_drift_sync(clock_drift_t* c, int64_t local_us, int64_t reference_us, bool measured);
+
+/**
+ * Estimated absolute clock error now, in microseconds
+ */
+int64_t clock_drift_error_us(const clock_drift_t* c, int64_t now_us);
+
+/**
+ * Quality of a timestamp taken now
+ */
+time_quality_t clock_drift_quality(const clock_drift_t* c, int64_t now_us);
+
+/**
+ * Wall clock time the next resync is due, 0 if one is due right away
+ */
+int64_t clock_drift_next_sync_us(const clock_drift_t* c);
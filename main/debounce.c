@@ -0,0 +1,75 @@
+#include "debounce.h"
+
+/**
+ * Initialize the filter with its settle window and minimum hold time
+ */
+void debounce_init(debounce_t* db, uint32_t settle_ms, uint32_t min_hold_ms) {
+    db->settle_us = (int64_t)settle_ms * 1000;
+    db->min_hold_us = (int64_t)min_hold_ms * 1000;
+    db->stable_level = -1;
+    db->raw_level = -1;
+    db->pending = false;
+    db->pending_since_us = 0;
+    db->last_edge_us = 0;
+    db->bounces = 0;
+    db->glitches = 0;
+}
+
+/**
+ * Feed one raw edge (level after the edge and when it happened)
+ */
+void debounce_feed(debounce_t* db, int level, int64_t timestamp_us) {
+    db->raw_level = level;
+    db->last_edge_us = timestamp_us;
+
+    if (db->pending) {
+        // Still settling - whatever the level, this edge is bounce
+        db->bounces++;
+    } else if (level != db->stable_level) {
+        db->pending = true;
+        db->pending_since_us = timestamp_us;
+    }
+}
+
+/**
+ * Check whether a pending change can be committed at now_us
+ */
+bool debounce_poll(debounce_t* db, int64_t now_us, int* level, int64_t* since_us) {
+    if (!db->pending || now_us < db->last_edge_us + db->settle_us) {
+        return false;
+    }
+
+    // Settled back where it started - the whole change was a glitch
+    if (db->raw_level == db->stable_level) {
+        db->pending = false;
+        db->glitches++;
+        return false;
+    }
+
+    if (now_us < db->pending_since_us + db->min_hold_us) {
+        return false;
+    }
+
+    db->stable_level = db->raw_level;
+    db->pending = false;
+    *level = db->stable_level;
+    *since_us = db->pending_since_us;
+    return true;
+}
+
+/**
+ * Earliest time debounce_poll() can make progress, or -1 if nothing is pending
+ */
+int64_t debounce_deadline(const debounce_t* db) {
+    if (!db->pending) {
+        return -1;
+    }
+
+    // Back at the stable level - the glitch can be rejected as soon as it settles
+    int64_t settled = db->last_edge_us + db->settle_us;
+    if (db->raw_level == db->stable_level) {
+        return settled;
+    }
+    int64_t held = db->pending_since_us + db->min_hold_us;
+    return (settled > held) ? settled : held;
+}
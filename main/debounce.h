@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Debounce and glitch filter for raw reed switch edges.
+ *
+ * A change away from the stable level becomes pending on its first edge.
+ * It is committed once the raw level has been quiet for the settle window
+ * and has been away from the stable level for at least the minimum hold
+ * time. Extra edges while pending are counted as bounces; a pending change
+ * whose raw level settles back to the stable level is counted as a glitch.
+ * Pure C with no ESP-IDF dependencies so edge traces can be replayed on a host.
+ */
+
+typedef struct {
+    int64_t settle_us;          // Quiet time required after the last edge
+    int64_t min_hold_us;        // Minimum time a new level must be held
+    int stable_level;           // Last committed level, -1 before the first commit
+    int raw_level;              // Level reported by the most recent edge
+    bool pending;               // A change away from stable_level is in progress
+    int64_t pending_since_us;   // First edge of the pending change
+    int64_t last_edge_us;       // Most recent raw edge
+    uint32_t bounces;           // Extra edges absorbed while a change was pending
+    uint32_t glitches;          // Pending changes that reverted before committing
+} debounce_t;
+
+/**
+ * Initialize the filter with its settle window and minimum hold time
+ */
+void debounce_init(debounce_t* db, uint32_t settle_ms, uint32_t min_hold_ms);
+
+/**
+ * Feed one raw edge (level after the edge and when it happened)
+ */
+void debounce_feed(debounce_t* db, int level, int64_t timestamp_us);
+
+/**
+ * Check whether a pending change can be committed at now_us
+ * @param level Set to the committed level
+ * @param since_us Set to the time of the first edge of the committed change
+ * @return true if a change was committed
+ */
+bool debounce_poll(debounce_t* db, int64_t now_us, int* level, int64_t* since_us);
+
+/**
+ * Earliest time debounce_poll() can make progress, or -1 if nothing is pending
+ */
+int64_t debounce_deadline(const debounce_t* db);
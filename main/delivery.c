@@ -0,0 +1,163 @@
+#include "delivery.h"
+#include <string.h>
+
+/**
+ * Start with an empty backlog
+ */
+void delivery_init(delivery_t* d, int window, char* body, size_t body_max, const delivery_hooks_t* hooks) {
+    memset(d, 0, sizeof(*d));
+    backlog_init(&d->backlog);
+    d->hooks = *hooks;
+    d->window = (window < 1) ? 1 : (window > DELIVERY_WINDOW_MAX) ? DELIVERY_WINDOW_MAX : window;
+    d->body = body;
+    d->body_max = body_max;
+    d->retry_delay_ms = BACKLOG_RETRY_MIN_MS;
+    d->pending = DELIVERY_IDLE;
+}
+
+/**
+ * Store an entry at the backlog tail, evicting the oldest when full
+ */
+static backlog_entry_t* store(delivery_t* d, const backlog_entry_t* entry) {
+    backlog_entry_t evicted;
+    if (backlog_store(&d->backlog, entry, &evicted) && d->hooks.evicted) {
+        d->hooks.evicted(d->hooks.ctx, &evicted);
+    }
+    return &d->backlog.entries[(d->backlog.tail + MAX_QUEUED_MESSAGES - 1) % MAX_QUEUED_MESSAGES];
+}
+
+/**
+ * Append a record to the backlog and tell the caller it is there
+ */
+static void push(delivery_t* d, const backlog_entry_t* entry) {
+    backlog_entry_t* stored = store(d, entry);
+    if (d->hooks.stored) {
+        d->hooks.stored(d->hooks.ctx, stored);
+    }
+}
+
+/**
+ * Put an entry restored from the write-ahead log back in the backlog
+ */
+void delivery_restore(delivery_t* d, const backlog_entry_t* entry) {
+    store(d, entry);
+}
+
+/**
+ * A record arrived from the submit queue
+ */
+void delivery_receive(delivery_t* d, const backlog_entry_t* entry) {
+    if (d->backlog.count == 0 && d->pending == DELIVERY_IDLE) {
+        d->single = *entry;
+        d->pending = DELIVERY_SINGLE;
+        return;
+    }
+
+    // Keep delivery order - new records go behind any backlog
+    push(d, entry);
+    d->pending = DELIVERY_BACKLOG;
+}
+
+/**
+ * The wait ended without a record - time to retry the backlog
+ */
+void delivery_wake(delivery_t* d) {
+    if (d->backlog.count > 0) {
+        d->pending = DELIVERY_BACKLOG;
+    } else {
+        d->retry_delay_ms = BACKLOG_RETRY_MIN_MS;
+    }
+}
+
+/**
+ * Pick the next send
+ */
+bool delivery_next(delivery_t* d, bool online, delivery_send_t* send) {
+    if (d->pending == DELIVERY_BACKLOG && d->backlog.count == 0) {
+        d->pending = DELIVERY_IDLE;
+        d->retry_delay_ms = BACKLOG_RETRY_MIN_MS;
+    }
+    if (d->pending == DELIVERY_IDLE) {
+        return false;
+    }
+    if (!online) {
+        // Nothing to gain from trying - wait for the link at the shortest retry delay
+        if (d->pending == DELIVERY_SINGLE) {
+            push(d, &d->single);
+        }
+        d->pending = DELIVERY_IDLE;
+        d->retry_delay_ms = backlog_retry_backoff(d->retry_delay_ms, false);
+        return false;
+    }
+
+    memset(send, 0, sizeof(*send));
+    if (d->pending == DELIVERY_SINGLE) {
+        send->entries[0] = &d->single;
+        send->count = 1;
+        d->packed = 1;
+    } else if (d->body != NULL) {
+        // Merge the backlog into as few publishes as the size cap allows
+        d->packed = backlog_build_flush_body(&d->backlog, d->body, d->body_max);
+        send->body = d->body;
+        send->count = 1;
+        send->from_backlog = true;
+    } else {
+        // One message per record, as many as the transport keeps in flight
+        d->packed = (d->backlog.count < d->window) ? d->backlog.count : d->window;
+        for (int i = 0; i < d->packed; i++) {
+            send->entries[i] = backlog_peek(&d->backlog, i);
+        }
+        send->count = d->packed;
+        send->from_backlog = true;
+    }
+    d->count = send->count;
+    return true;
+}
+
+/**
+ * Account for the outcome of the send delivery_next() picked
+ */
+bool delivery_sent(delivery_t* d, int confirmed, bool online) {
+    bool ok = confirmed >= d->count;
+
+    if (d->pending == DELIVERY_SINGLE) {
+        d->pending = DELIVERY_IDLE;
+        if (ok) {
+            if (d->hooks.delivered) {
+                d->hooks.delivered(d->hooks.ctx, &d->single);
+            }
+            return false;
+        }
+        push(d, &d->single);
+        d->retry_delay_ms = backlog_retry_backoff(d->retry_delay_ms, online);
+        return false;
+    }
+
+    // A coalesced body stands for all of its records
+    int sent = ok ? d->packed : confirmed;
+    for (int i = 0; i < sent; i++) {
+        backlog_entry_t entry;
+        if (backlog_pop(&d->backlog, &entry) && d->hooks.delivered) {
+            d->hooks.delivered(d->hooks.ctx, &entry);
+        }
+    }
+    if (!ok) {
+        // Server or link trouble - back off before the next attempt
+        d->pending = DELIVERY_IDLE;
+        d->retry_delay_ms = backlog_retry_backoff(d->retry_delay_ms, online);
+        return false;
+    }
+    if (d->backlog.count == 0) {
+        d->pending = DELIVERY_IDLE;
+        d->retry_delay_ms = BACKLOG_RETRY_MIN_MS;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * How long to wait for the next record before retrying the backlog
+ */
+uint32_t delivery_wait_ms(const delivery_t* d) {
+    return (d->backlog.count > 0) ? d->retry_delay_ms : DELIVERY_WAIT_FOREVER;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "backlog.h"
+
+/**
+ * Delivery decisions of the notifier task.
+ *
+ * A record taken from the submit queue goes out on its own when nothing is
+ * waiting, otherwise behind the retry backlog. The backlog goes out as
+ * coalesced bodies or as windows of one message per record, entries leave
+ * it as the transport confirms them, and a failed send backs off before the
+ * backlog is retried. The caller waits and sends - notifier.c on FreeRTOS,
+ * door_sim in virtual time - and hears about entries entering and leaving
+ * the backlog through hooks.
+ * Pure C with no ESP-IDF dependencies so delivery can be simulated on a host.
+ */
+
+// Largest transport window - the MQTT in-flight limit
+#define DELIVERY_WINDOW_MAX 8
+
+// Wait for the next record without a retry timeout
+#define DELIVERY_WAIT_FOREVER UINT32_MAX
+
+typedef struct {
+    void (*stored)(void* ctx, backlog_entry_t* entry);          // Now in the backlog - may set log_seq
+    void (*delivered)(void* ctx, const backlog_entry_t* entry); // Confirmed by the transport
+    void (*evicted)(void* ctx, const backlog_entry_t* entry);   // Pushed out of a full backlog
+    void* ctx;
+} delivery_hooks_t;
+
+typedef enum {
+    DELIVERY_IDLE,              // Nothing to send until the next record or retry
+    DELIVERY_SINGLE,            // A record straight from the submit queue
+    DELIVERY_BACKLOG,           // The backlog, from the head
+} delivery_pending_t;
+
+// One send picked by delivery_next()
+typedef struct {
+    const backlog_entry_t* entries[DELIVERY_WINDOW_MAX];    // One message per entry, unless body is set
+    int count;                  // Messages to send
+    const char* body;           // Coalesced backlog body, the only message - NULL if one per entry
+    bool from_backlog;
+} delivery_send_t;
+
+typedef struct {
+    backlog_t backlog;
+    delivery_hooks_t hooks;
+    int window;                 // Messages per send when not coalescing
+    char* body;                 // Coalesced body buffer, NULL to send one message per record
+    size_t body_max;
+    uint32_t retry_delay_ms;    // Wait before the backlog is retried after a failed send
+    delivery_pending_t pending;
+    backlog_entry_t single;     // Record of a DELIVERY_SINGLE send
+    int packed;                 // Backlog entries the last send stands for
+    int count;                  // Messages in the last send
+} delivery_t;
+
+/**
+ * Start with an empty backlog
+ * @param window Messages the transport keeps in flight, up to DELIVERY_WINDOW_MAX
+ * @param body Buffer of body_max + 1 bytes to coalesce the backlog into, NULL to send it one record per message
+ */
+void delivery_init(delivery_t* d, int window, char* body, size_t body_max, const delivery_hooks_t* hooks);
+
+/**
+ * Put an entry restored from the write-ahead log back in the backlog
+ */
+void delivery_restore(delivery_t* d, const backlog_entry_t* entry);
+
+/**
+ * A record arrived from the submit queue
+ */
+void delivery_receive(delivery_t* d, const backlog_entry_t* entry);
+
+/**
+ * The wait ended without a record - time to retry the backlog
+ */
+void delivery_wake(delivery_t* d);
+
+/**
+ * Pick the next send
+ * @param online Whether the network is up - offline, a pending record goes to the backlog
+ * @return false if there is nothing to send until the next record or retry
+ */
+bool delivery_next(delivery_t* d, bool online, delivery_send_t* send);
+
+/**
+ * Account for the outcome of the send delivery_next() picked
+ * @param confirmed How many of its messages from the start the transport confirmed
+ * @param online Whether the network was up
+ * @return true if more backlog goes out after the transport's send gap
+ */
+bool delivery_sent(delivery_t* d, int confirmed, bool online);
+
+/**
+ * How long to wait for the next record before retrying the backlog
+ * @return DELIVERY_WAIT_FOREVER if the backlog is empty
+ */
+uint32_t delivery_wait_ms(const delivery_t* d);
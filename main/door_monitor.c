@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
@@ -10,22 +11,42 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "nvs_flash.h"
-#include "esp_bt.h"
-#include "esp_bt_main.h"
-#include "esp_bt_device.h"
-#include "esp_gap_bt_api.h"
-#include "esp_spp_api.h"
-#include "esp_sntp.h"
-#include "esp_http_client.h"
-#include "esp_crt_bundle.h"
 #include "esp_timer.h"
+#include "esp_sleep.h"
+#include "driver/rtc_io.h"
+#include "esp_attr.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "edge_ring.h"
+#include "debounce.h"
+#include "status_led.h"
+#include "notifier.h"
+#include "door_record.h"
+#include "batcher.h"
+#include "batch_window.h"
+#include "wifi_cache.h"
+#include "presence.h"
+#include "time_sync.h"
+#include "metrics.h"
+#include "metrics_server.h"
+#include "trace.h"
+#include "mem_report.h"
 #include <time.h>
 #include <sys/time.h>
 
 // Pin definitions
-#define REED_SWITCH_PIN GPIO_NUM_23  // Magnetic reed switch connected to GPIO 23
+#define REED_SWITCH_PIN ((gpio_num_t)CONFIG_DOOR_REED_SWITCH_GPIO)  // Magnetic reed switch (GPIO 23 by default)
 #define LED_PIN GPIO_NUM_2           // Built-in LED connected to GPIO 2
 
+// Sensor channels (from Kconfig) - one reed switch each
+#define SENSOR_CHANNELS CONFIG_DOOR_SENSOR_CHANNELS
+#define MAX_SENSOR_CHANNELS 8
+#define SENSOR_NAME_MAX 16
+#define SENSOR_POLL_MS 20            // Sampling period for pins without an edge interrupt
+
+_Static_assert(MAX_SENSOR_CHANNELS <= DOOR_RECORD_MAX_CHANNELS,
+               "every sensor channel needs a channel index in door records");
+
 // Door states
 #define DOOR_OPEN 1
 #define DOOR_CLOSED 0
@@ -34,6 +55,7 @@
 #define WIFI_SSID CONFIG_DOOR_WIFI_SSID
 #define WIFI_PASS CONFIG_DOOR_WIFI_PASSWORD
 #define WIFI_MAXIMUM_RETRY 5
+#define WIFI_FAST_CONNECT_ATTEMPTS 2   // Targeted connects before falling back to a full scan
 
 // Bluetooth Configuration (from Kconfig)
 #define PHONE_BT_MAC CONFIG_DOOR_PHONE_BT_MAC
@@ -46,90 +68,140 @@
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
-// Message Queue Configuration
-#define MAX_QUEUED_MESSAGES 20
-#define MESSAGE_QUEUE_SIZE 128
+// Boot progress - sensing is armed first, the radios come up in their own tasks
+#define BOOT_WIFI_STARTED_BIT   BIT0    // WiFi driver running - the BT controller may start
+#define BOOT_WIFI_DONE_BIT      BIT1    // Connected, or gave up waiting
+#define BOOT_TIME_DONE_BIT      BIT2    // Wall clock valid, or gave up waiting
+#define BOOT_PRESENCE_DONE_BIT  BIT3    // Presence tracking started, or failed to
+#define BOOT_RELEASE_BITS (BOOT_TIME_DONE_BIT | BOOT_PRESENCE_DONE_BIT)
+#define BOOT_ALL_BITS (BOOT_WIFI_DONE_BIT | BOOT_RELEASE_BITS)
+#define BOOT_TASK_STACK_SIZE 4096
+#define BOOT_TASK_PRIORITY 1            // Same as the sensor loop
+#define BOOT_HOLD_MAX 16                // Door changes held until the clock and presence are ready
 
-// Event Batching Configuration
-#define BATCH_TIMEOUT_MS 60000  // 60 seconds
-#define MAX_EVENT_BUFFER 5
+MEM_TASK_STACK(boot_net_stack, BOOT_TASK_STACK_SIZE);
+MEM_TASK_STACK(boot_bt_stack, BOOT_TASK_STACK_SIZE);
 
-// NTP Configuration
-#define NTP_SERVER "pool.ntp.org"
-#define TIMEZONE "PST8PDT,M3.2.0/2,M11.1.0"  // Pacific Time - change as needed
+#define BOOT_TIME_WAIT_MS 30000        // Longest wait for the first NTP answer once WiFi is up
 
 // Logging tag
 static const char* TAG = "DOOR_SENSOR";
 
-// Door event structure
-typedef struct {
-    int state;          // DOOR_OPEN or DOOR_CLOSED
-    time_t timestamp;
-    bool processed;
-} door_event_t;
-
-// Message queue structure
+// Event Batching Configuration
+#define BATCH_TIMEOUT_MS CONFIG_DOOR_BATCH_WINDOW_MAX_MS  // Longest an unpaired event waits
+#if CONFIG_DOOR_BATCH_WINDOW_ADAPTIVE
+#define BATCH_WINDOW_MIN_MS CONFIG_DOOR_BATCH_WINDOW_MIN_MS
+#define BATCH_WINDOW_PERCENTILE CONFIG_DOOR_BATCH_WINDOW_PERCENTILE
+#else
+#define BATCH_WINDOW_MIN_MS BATCH_TIMEOUT_MS  // Fixed window
+#define BATCH_WINDOW_PERCENTILE 99
+#endif
+#define OPEN_GAP_MAX_MS (24LL * 3600 * 1000)  // Longer open -> close gaps are not learned from
+#define RUN_FLUSH_CHECK_MS 250  // How often a held run checks whether delivery has caught up
+
+// One reed switch with its own state, debounce filter and event batch
 typedef struct {
-    char message[MESSAGE_QUEUE_SIZE];
-    time_t timestamp;
-} door_message_t;
+    char name[SENSOR_NAME_MAX];
+    gpio_num_t pin;
+    bool polled;                    // No edge interrupt - sampled every SENSOR_POLL_MS
+    int door_state;                 // -1 until the first detection
+    debounce_t debounce;            // Filters raw edges into committed door states
+    batcher_t batch;                // Events not notified yet, busy stretches folded into runs
+    batch_window_t window;          // Batching window learned from open -> close gaps
+    int64_t opened_ms;              // Wall clock time of the last OPEN, 0 if unknown
+    TimerHandle_t batch_timer;
+    bool batch_timer_active;
+    volatile bool batch_expired;    // Set by the timer callback, handled by the sensor loop
+} sensor_channel_t;
 
 // Global variables
-static int current_door_state = -1;  // Initialize to invalid state to force initial detection
+static sensor_channel_t channels[MAX_SENSOR_CHANNELS];
+static int channel_count = 0;
+static int8_t pin_channel[64];       // Channel index by GPIO number
+static uint64_t channel_pin_mask = 0; // Bit n set if GPIO n belongs to a channel
+static uint64_t polled_pin_mask = 0;  // Channel pins sampled by the loop instead of an interrupt
+static uint64_t sampled_levels = 0;   // Input levels last fed to the debounce filters
+static edge_ring_t edge_ring;        // Reed switch edges pushed by the GPIO ISR
+static unsigned edges_dropped_reported = 0;
 static EventGroupHandle_t s_wifi_event_group;
 static int s_retry_num = 0;
 static bool wifi_connected = false;
-static door_message_t message_queue[MAX_QUEUED_MESSAGES];
-static int queue_head = 0;
-static int queue_tail = 0;
-static int queue_count = 0;
-
-// Event batching variables
-static door_event_t event_buffer[MAX_EVENT_BUFFER];
-static int event_count = 0;
-static TimerHandle_t batch_timer = NULL;
-static bool batch_timer_active = false;
-
-// NTP variables
-static bool time_synced = false;
-
-// Bluetooth SPP variables
-static bool bt_initialized = false;
-static bool spp_connected = false;
-static esp_bd_addr_t phone_mac_addr;
-static uint32_t spp_handle = 0;
-#define SPP_CONNECTION_TIMEOUT_MS 10000  // 10 seconds as requested
+static bool wifi_lost = false;          // Disconnected after having an IP address, not back yet
+static esp_netif_t* sta_netif = NULL;
+static wifi_cache_t wifi_cache;
+static bool wifi_cache_valid = false;
+static int wifi_fast_attempts = 0;      // Targeted connects tried since the last success
+static bool wifi_static_ip = false;     // Cached lease applied, DHCP client stopped
+static int64_t wifi_connect_start_us = 0;
+
+// Notifications held back until the presence probe started at their first edge finishes
+#define MAX_AWAITING_AUTH 4
+#define AUTH_WAIT_MAX_MS (2 * PRESENCE_PROBE_TIMEOUT_MS + 1000)  // Probe in flight + our own
+
+typedef struct {
+    batch_entry_t entry;
+    uint8_t channel;
+    int64_t held_us;                // When it was held back
+    int64_t deadline_us;
+} awaiting_auth_t;
+
+static awaiting_auth_t awaiting_auth[MAX_AWAITING_AUTH];
+static int awaiting_auth_count = 0;
+
+// Door changes committed before the wall clock and presence tracking were ready
+typedef struct {
+    int64_t timestamp_us;       // Monotonic time of the first edge
+    uint8_t channel;
+    int8_t door_state;
+} held_change_t;
+
+static EventGroupHandle_t boot_event_group;
+static held_change_t held_changes[BOOT_HOLD_MAX];
+static int held_change_count = 0;
+static bool boot_holding = true;        // Changes are held, not handled
+static bool boot_reported = false;
+static int64_t armed_us = 0;            // Sensor loop running
+static int64_t boot_wifi_us = 0;        // Boot stages finished, written before their bit is set
+static int64_t boot_time_us = 0;
+static int64_t boot_presence_us = 0;
+
+#if CONFIG_DOOR_DEEP_SLEEP
+// State carried across deep sleep in RTC slow memory (everything else is lost)
+#define RTC_STATE_MAGIC 0x44534c50  // "DSLP"
+#define SLEEP_CHECK_INTERVAL_MS 100
+#define OPEN_CHANNEL_POLL_S 60      // Wake to check on open channels no wake source is left for
+
+typedef struct {
+    uint32_t magic;
+    int door_state[MAX_SENSOR_CHANNELS];
+    batcher_t batch[MAX_SENSOR_CHANNELS];
+    batch_window_t window[MAX_SENSOR_CHANNELS];
+    int64_t opened_ms[MAX_SENSOR_CHANNELS];
+    int64_t batch_deadline_us[MAX_SENSOR_CHANNELS];  // Wall clock time the batch timer expires, 0 if not running
+    uint32_t wake_count;
+    uint64_t awake_total_ms;    // Time spent awake across all wakes
+} rtc_state_t;
+
+static RTC_DATA_ATTR rtc_state_t rtc_state;
+static bool deep_sleep_enabled = false;
+static int64_t wifi_ready_us = 0;    // Got an IP address
+static int64_t notified_us = 0;      // First notification delivered
+#endif
 
 // Task notification for batch processing
 static TaskHandle_t main_task_handle = NULL;
 #define BATCH_TIMEOUT_NOTIFICATION (1UL << 0)
+#define EDGE_NOTIFICATION          (1UL << 1)
+#define PRESENCE_NOTIFICATION      (1UL << 2)
+#define BOOT_NOTIFICATION          (1UL << 3)
+#define MEMORY_REPORT_NOTIFICATION (1UL << 4)
 
 // Forward declarations
-void queue_message_direct(const char* message);
-void process_accumulated_events(void);
+static void wifi_connect_attempt(void);
+void queue_notification(const batch_entry_t* entry, uint8_t channel, uint8_t person);
+static void submit_entry(const batch_entry_t* entry, uint8_t channel);
+void process_accumulated_events(sensor_channel_t* channel);
 void batch_timer_callback(TimerHandle_t xTimer);
-void initialize_sntp(void);
-void wait_for_time_sync(void);
-void sync_time_on_wake(void);
-bool send_ntfy_notification(const char* message);
-void format_time_12h(struct tm* timeinfo, char* buffer, size_t size);
-void init_bluetooth_spp(void);
-bool try_connect_to_phone(void);
-void spp_callback(esp_spp_cb_event_t event, esp_spp_cb_param_t *param);
-void parse_mac_address(const char* mac_str, esp_bd_addr_t mac_addr);
-
-/**
- * Function to blink the LED a specified number of times
- * @param blink_count Number of times to blink the LED
- */
-static void blink_led(int blink_count) {
-    for (int i = 0; i < blink_count; i++) {
-        gpio_set_level(LED_PIN, 1);  // Turn LED on
-        vTaskDelay(pdMS_TO_TICKS(200));  // Wait 200ms
-        gpio_set_level(LED_PIN, 0);  // Turn LED off
-        vTaskDelay(pdMS_TO_TICKS(200));  // Wait 200ms
-    }
-}
 
 /**
  * WiFi event handler
@@ -137,35 +209,164 @@ static void blink_led(int blink_count) {
 static void event_handler(void* arg, esp_event_base_t event_base,
                          int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        wifi_connect_start_us = esp_timer_get_time();
+        wifi_connect_attempt();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+        wifi_cache_save_ap(event->bssid, event->channel);
+        // Reconnects go to this AP now - a roam or a first boot with empty NVS changed it
+        wifi_cache_valid = wifi_cache_get(&wifi_cache);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+        if (wifi_connected) {
+            metrics_count(METRIC_WIFI_DISCONNECTS, 1);
+            wifi_lost = true;
+            status_led_request(LED_PATTERN_OFFLINE);
+            wifi_connect_start_us = esp_timer_get_time();
+        }
         wifi_connected = false;
-        ESP_LOGI(TAG, "WiFi disconnected - will retry connection");
-        esp_wifi_connect();
+        notifier_set_online(false);
+        time_sync_set_online(false);
+        ESP_LOGI(TAG, "WiFi disconnected (reason %d) - will retry connection", event->reason);
         s_retry_num++;
+        if (s_retry_num >= WIFI_MAXIMUM_RETRY) {
+            // Let startup carry on - retries continue in the background
+            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        }
+        wifi_connect_attempt();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        ESP_LOGI(TAG, "WiFi connected in %ld ms (%s, %d attempts)",
+                 (long)((esp_timer_get_time() - wifi_connect_start_us) / 1000),
+                 wifi_fast_attempts > 0 && wifi_fast_attempts <= WIFI_FAST_CONNECT_ATTEMPTS ?
+                     (wifi_static_ip ? "fast path, cached IP" : "fast path") : "full scan",
+                 s_retry_num + 1);
+        wifi_fast_attempts = 0;
+        if (!wifi_static_ip) {
+            esp_netif_dns_info_t dns = {0};
+            esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+            wifi_cache_save_ip(event->ip_info.ip.addr, event->ip_info.netmask.addr,
+                               event->ip_info.gw.addr, dns.ip.u_addr.ip4.addr);
+            wifi_cache_valid = wifi_cache_get(&wifi_cache);
+        }
+#if CONFIG_DOOR_DEEP_SLEEP
+        if (wifi_ready_us == 0) {
+            wifi_ready_us = esp_timer_get_time();
+        }
+#endif
+        if (wifi_lost) {
+            metrics_count(METRIC_WIFI_RECONNECTS, 1);
+            wifi_lost = false;
+        }
         s_retry_num = 0;
         wifi_connected = true;
+        xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        notifier_set_online(true);
+        time_sync_set_online(true);
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-        
-        // Sync time if this is a reconnection (SNTP already initialized)
-        if (esp_sntp_enabled()) {
-            sync_time_on_wake();
+    }
+}
+
+/**
+ * Station configuration, optionally pinned to the cached access point
+ */
+static void wifi_build_config(wifi_config_t* wifi_config, bool targeted) {
+    *wifi_config = (wifi_config_t) {
+        .sta = {
+            .ssid = WIFI_SSID,
+            .password = WIFI_PASS,
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .pmf_cfg = {
+                .capable = true,
+                .required = false
+            },
+        },
+    };
+
+    if (targeted) {
+        // Known BSSID and channel - associate without scanning
+        wifi_config->sta.bssid_set = true;
+        memcpy(wifi_config->sta.bssid, wifi_cache.bssid, sizeof(wifi_config->sta.bssid));
+        wifi_config->sta.channel = wifi_cache.channel;
+    }
+}
+
+#if CONFIG_DOOR_WIFI_CACHED_IP
+/**
+ * Apply or drop the cached IP lease so DHCP can be skipped
+ */
+static void wifi_use_static_ip(bool enable) {
+    if (enable == wifi_static_ip) {
+        return;
+    }
+
+    if (enable) {
+        esp_netif_ip_info_t ip_info = {
+            .ip.addr = wifi_cache.ip,
+            .netmask.addr = wifi_cache.netmask,
+            .gw.addr = wifi_cache.gw,
+        };
+        esp_netif_dhcpc_stop(sta_netif);
+        if (esp_netif_set_ip_info(sta_netif, &ip_info) != ESP_OK) {
+            esp_netif_dhcpc_start(sta_netif);
+            return;
         }
+        esp_netif_dns_info_t dns = { .ip.type = ESP_IPADDR_TYPE_V4 };
+        dns.ip.u_addr.ip4.addr = wifi_cache.dns;
+        esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+    } else {
+        esp_netif_dhcpc_start(sta_netif);
+    }
+    wifi_static_ip = enable;
+}
+#endif
+
+/**
+ * Start one connection attempt - targeted at the cached AP first, full scan after that
+ */
+static void wifi_connect_attempt(void) {
+    bool targeted = wifi_cache_valid && wifi_fast_attempts < WIFI_FAST_CONNECT_ATTEMPTS;
+
+    if (wifi_fast_attempts == WIFI_FAST_CONNECT_ATTEMPTS) {
+        ESP_LOGW(TAG, "Fast connect to cached AP failed, falling back to full scan");
     }
+    if (wifi_cache_valid) {
+        wifi_fast_attempts++;
+    }
+
+#if CONFIG_DOOR_WIFI_CACHED_IP
+    wifi_use_static_ip(targeted && wifi_cache.has_ip);
+#endif
+
+    wifi_config_t wifi_config;
+    wifi_build_config(&wifi_config, targeted);
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_connect();
 }
 
 /**
- * Initialize WiFi
+ * Initialize WiFi and start connecting without waiting for the connection
  */
 void wifi_init_sta(void) {
+#if CONFIG_DOOR_STATIC_ALLOCATION
+    static StaticEventGroup_t wifi_event_group_buffer;
+    s_wifi_event_group = xEventGroupCreateStatic(&wifi_event_group_buffer);
+#else
     s_wifi_event_group = xEventGroupCreate();
+#endif
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    sta_netif = esp_netif_create_default_wifi_sta();
+
+    wifi_cache_valid = wifi_cache_load(&wifi_cache);
+    if (wifi_cache_valid) {
+        ESP_LOGI(TAG, "Cached AP %02x:%02x:%02x:%02x:%02x:%02x on channel %d%s",
+                 wifi_cache.bssid[0], wifi_cache.bssid[1], wifi_cache.bssid[2],
+                 wifi_cache.bssid[3], wifi_cache.bssid[4], wifi_cache.bssid[5],
+                 wifi_cache.channel, wifi_cache.has_ip ? " with IP lease" : "");
+    }
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -183,683 +384,834 @@ void wifi_init_sta(void) {
                                                         NULL,
                                                         &instance_got_ip));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASS,
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-            .pmf_cfg = {
-                .capable = true,
-                .required = false
-            },
-        },
-    };
+    // The config is applied per attempt in wifi_connect_attempt()
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
+}
 
+/**
+ * Wait for the first connection, at most the startup connect timeout
+ */
+static void wifi_wait_connected(void) {
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
             WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
             pdFALSE,
             pdFALSE,
-            portMAX_DELAY);
+            pdMS_TO_TICKS(CONFIG_DOOR_WIFI_CONNECT_TIMEOUT_MS));
 
     if (bits & WIFI_CONNECTED_BIT) {
         ESP_LOGI(TAG, "connected to ap SSID:%s", WIFI_SSID);
     } else if (bits & WIFI_FAIL_BIT) {
         ESP_LOGI(TAG, "Failed to connect to SSID:%s", WIFI_SSID);
     } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
+        ESP_LOGW(TAG, "No connection to SSID:%s after %d ms - continuing offline",
+                 WIFI_SSID, CONFIG_DOOR_WIFI_CONNECT_TIMEOUT_MS);
     }
 }
 
 /**
- * SNTP sync notification callback
+ * Process and send accumulated events
  */
-void sntp_sync_time_cb(struct timeval *tv) {
-    ESP_LOGI(TAG, "Time synchronized with NTP server");
-    time_synced = true;
+void process_accumulated_events(sensor_channel_t* channel) {
+    if (channel->batch.count == 0) return;
+
+    ESP_LOGI(TAG, "Processing %lu accumulated %s entries (%lu cycles merged, %lu evicted)",
+             (unsigned long)channel->batch.count, channel->name,
+             (unsigned long)channel->batch.merged, (unsigned long)channel->batch.evicted);
+
+    batch_entry_t entry;
+    while (batcher_pop_oldest(&channel->batch, &entry)) {
+        submit_entry(&entry, (uint8_t)(channel - channels));
+    }
+    ESP_LOGI(TAG, "Event buffer cleared");
 }
 
 /**
- * Initialize SNTP and sync time
+ * Whether notifications are still waiting on a probe, the queue or the network
  */
-void initialize_sntp(void) {
-    ESP_LOGI(TAG, "Initializing SNTP");
-    
-    // Set timezone
-    setenv("TZ", TIMEZONE, 1);
-    tzset();
-    
-    // Initialize SNTP
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, NTP_SERVER);
-    esp_sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
-    esp_sntp_set_time_sync_notification_cb(sntp_sync_time_cb);
-    esp_sntp_init();
-    
-    ESP_LOGI(TAG, "SNTP initialized, waiting for time sync...");
+static bool delivery_busy(void) {
+    if (awaiting_auth_count > 0) {
+        return true;
+    }
+    notify_stats_t stats;
+    notifier_get_stats(&stats);
+    return stats.pending > 0 || stats.state != NOTIFY_STATE_IDLE || stats.backlog > 0;
 }
 
 /**
- * Wait for time synchronization with timeout
+ * Start the batch timer over with the full period, or stop it once nothing is left
  */
-void wait_for_time_sync(void) {
-    int retry = 0;
-    const int retry_count = 30; // 30 seconds timeout
-    
-    while (!time_synced && retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for time sync... (%d/%d)", retry + 1, retry_count);
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        retry++;
-    }
-    
-    if (time_synced) {
-        time_t now;
-        time(&now);
-        struct tm *timeinfo = localtime(&now);
-        char strftime_buf[64];
-        strftime(strftime_buf, sizeof(strftime_buf), "%c", timeinfo);
-        ESP_LOGI(TAG, "Time synced successfully: %s", strftime_buf);
-    } else {
-        ESP_LOGW(TAG, "Time sync timeout - continuing with system time");
+static void update_batch_timer(sensor_channel_t* channel) {
+    if (channel->batch.count == 0) {
+        if (channel->batch_timer_active) {
+            xTimerStop(channel->batch_timer, 0);
+            channel->batch_timer_active = false;
+            TRACE(BATCH_TIMER_STOPPED, channel - channels);
+        }
+        return;
     }
+
+    // Also restores the full period after a wake from deep sleep resumed it
+    // with the remaining time
+    uint32_t window_ms = batch_window_timeout_ms(&channel->window);
+    xTimerChangePeriod(channel->batch_timer, pdMS_TO_TICKS(window_ms), 0);
+    TRACE(BATCH_TIMER_ARMED, channel - channels, window_ms, channel->batch_timer_active);
+    channel->batch_timer_active = true;
 }
 
 /**
- * Sync time on demand (for wake from deep sleep)
+ * Send entries held back while delivery was busy, oldest first, once it has
+ * caught up - runs of cycles, and whatever came before a pair
  */
-void sync_time_on_wake(void) {
-    if (!wifi_connected) {
-        ESP_LOGW(TAG, "Cannot sync time - WiFi not connected");
-        return;
+static void flush_held(void) {
+    for (int i = 0; i < channel_count; i++) {
+        sensor_channel_t* channel = &channels[i];
+        batch_entry_t entry;
+        if (!batcher_held(&channel->batch) || !batcher_take_held(&channel->batch, delivery_busy(), &entry)) {
+            continue;
+        }
+
+        TRACE(BATCH_HELD, i, entry.kind, entry.cycles);
+        submit_entry(&entry, (uint8_t)i);
+        update_batch_timer(channel);
     }
-    
-    ESP_LOGI(TAG, "Syncing time after wake...");
-    time_synced = false;
-    
-    // Reset SNTP to force immediate sync
-    esp_sntp_stop();
-    esp_sntp_init();
-    
-    // Wait for sync with shorter timeout for battery efficiency
-    int retry = 0;
-    const int retry_count = 10; // 10 seconds timeout
-    
-    while (!time_synced && retry < retry_count) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        retry++;
+}
+
+/**
+ * Whether any channel holds an entry waiting for delivery to catch up
+ */
+static bool entries_held(void) {
+    for (int i = 0; i < channel_count; i++) {
+        if (batcher_held(&channels[i].batch)) {
+            return true;
+        }
     }
-    
-    if (time_synced) {
-        ESP_LOGI(TAG, "Time re-synced successfully");
-    } else {
-        ESP_LOGW(TAG, "Time re-sync timeout - using previous time");
+    return false;
+}
+
+/**
+ * Timer callback for batch timeout - lightweight, just notify main task
+ */
+void batch_timer_callback(TimerHandle_t xTimer) {
+    sensor_channel_t* channel = &channels[(int)(intptr_t)pvTimerGetTimerID(xTimer)];
+    channel->batch_timer_active = false;
+    channel->batch_expired = true;
+    // Notify main task to process events (don't do heavy work in timer callback)
+    if (main_task_handle != NULL) {
+        xTaskNotify(main_task_handle, BATCH_TIMEOUT_NOTIFICATION, eSetBits);
     }
 }
 
 /**
- * HTTP event handler for ntfy.sh requests
+ * Add event to batch buffer
  */
-esp_err_t ntfy_http_event_handler(esp_http_client_event_t *evt) {
-    switch(evt->event_id) {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE(TAG, "HTTP Error");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGI(TAG, "Connected to ntfy.sh");
-            break;
-        case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGI(TAG, "HTTP headers sent");
-            break;
-        case HTTP_EVENT_ON_FINISH:
-            ESP_LOGI(TAG, "HTTP request finished");
-            break;
-        case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGI(TAG, "Disconnected from ntfy.sh");
-            break;
-        default:
-            break;
+void add_event_to_batch(sensor_channel_t* channel, int door_state, time_t timestamp, time_quality_t time_quality,
+                        uint32_t probe_ticket) {
+    uint8_t index = (uint8_t)(channel - channels);
+    batch_entry_t evicted;
+    if (batcher_add(&channel->batch, door_state == DOOR_OPEN, (uint32_t)timestamp, time_quality, probe_ticket,
+                    &evicted)) {
+        ESP_LOGW(TAG, "Event buffer full, sending the oldest entry");
+        submit_entry(&evicted, index);
+    }
+
+    TRACE(BATCH_ADD, index, door_state == DOOR_OPEN, channel->batch.count);
+
+    // A lone OPEN->CLOSE pair goes out at once unless delivery is backed up
+    // or older entries are waiting
+    batch_entry_t pair;
+    if (door_state == DOOR_CLOSED && batcher_take_pair(&channel->batch, delivery_busy(), &pair)) {
+        TRACE(BATCH_PAIR, index);
+        submit_entry(&pair, index);
     }
-    return ESP_OK;
+
+    update_batch_timer(channel);
 }
 
 /**
- * Send notification via ntfy.sh
+ * Pack a batch entry into a compact record and hand it to the delivery task
+ * (never waits on the network - text is rendered at send time)
+ * @param person 1-based authorized device that was identified, 0 if unauthenticated
  */
-bool send_ntfy_notification(const char* message) {
-    if (!wifi_connected) {
-        ESP_LOGW(TAG, "Cannot send ntfy notification - WiFi not connected");
-        return false;
+void queue_notification(const batch_entry_t* entry, uint8_t channel, uint8_t person) {
+    bool authenticated = person != 0;
+    if (!authenticated) {
+        status_led_request(LED_PATTERN_UNAUTHENTICATED);
     }
 
-    ESP_LOGI(TAG, "Sending ntfy notification: %s", message);
-    
-    esp_http_client_config_t config = {
-        .url = NTFY_URL,
-        .event_handler = ntfy_http_event_handler,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 10000,  // 10 second timeout
-        .crt_bundle_attach = esp_crt_bundle_attach,  // Use certificate bundle for HTTPS
-    };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return false;
+    door_record_t record = door_record_from_entry(entry, channel, person);
+    if (!notifier_submit(&record)) {
+        notify_stats_t stats;
+        notifier_get_stats(&stats);
+        ESP_LOGW(TAG, "Notification queue full (%lu pending, %lu rejected), dropping event",
+                 (unsigned long)stats.pending, (unsigned long)stats.rejected);
     }
-    
-    // Set headers
-    esp_http_client_set_header(client, "Content-Type", "text/plain");
-    esp_http_client_set_header(client, "Priority", NTFY_PRIORITY);
-    esp_http_client_set_header(client, "Title", "Door Monitor");
-    esp_http_client_set_header(client, "Tags", "door,security");
-    
-    // Set the message as POST data
-    esp_http_client_set_post_field(client, message, strlen(message));
-    
-    // Perform the request
-    esp_err_t err = esp_http_client_perform(client);
-    bool success = false;
-    
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        if (status_code == 200) {
-            ESP_LOGI(TAG, "ntfy notification sent successfully");
-            success = true;
-        } else {
-            ESP_LOGW(TAG, "ntfy request failed with status: %d", status_code);
+}
+
+/**
+ * Queue held-back notifications, oldest first, once their presence probe is
+ * done or has taken too long
+ */
+static void flush_awaiting_auth(void) {
+    int64_t now_us = esp_timer_get_time();
+    int done = 0;
+
+    while (done < awaiting_auth_count) {
+        awaiting_auth_t* held = &awaiting_auth[done];
+        uint8_t person;
+        presence_result_t result = presence_lookup(held->entry.probe_ticket, &person);
+        if (result == PRESENCE_RESULT_PENDING && now_us < held->deadline_us) {
+            break;  // Later entries wait behind this one to keep the order
         }
-    } else {
-        ESP_LOGE(TAG, "ntfy HTTP request failed: %s", esp_err_to_name(err));
+        if (result == PRESENCE_RESULT_PENDING) {
+            ESP_LOGW(TAG, "Presence probe still running after %d ms, sending unauthenticated", AUTH_WAIT_MAX_MS);
+        }
+        metrics_observe_us(METRIC_STAGE_AUTH_HOLD, now_us - held->held_us);
+        queue_notification(&held->entry, held->channel, person);
+        done++;
+    }
+
+    if (done > 0) {
+        awaiting_auth_count -= done;
+        memmove(awaiting_auth, &awaiting_auth[done], sizeof(awaiting_auth_t) * awaiting_auth_count);
     }
-    
-    esp_http_client_cleanup(client);
-    return success;
 }
 
 /**
- * Add message to queue
+ * Authenticate a batch entry from the presence cache and queue the notification,
+ * holding it back while the probe started at its first edge is still running
  */
-void queue_message(const char* status) {
-    if (queue_count >= MAX_QUEUED_MESSAGES) {
-        ESP_LOGW(TAG, "Message queue full, dropping oldest message");
-        queue_head = (queue_head + 1) % MAX_QUEUED_MESSAGES;
-        queue_count--;
+static void submit_entry(const batch_entry_t* entry, uint8_t channel) {
+    metrics_observe_us(METRIC_STAGE_BATCH, ((int64_t)time(NULL) - entry->first) * 1000000LL);
+
+    uint8_t person;
+    presence_result_t result = presence_lookup(entry->probe_ticket, &person);
+    if (result != PRESENCE_RESULT_PENDING && awaiting_auth_count == 0) {
+        queue_notification(entry, channel, person);
+        return;
     }
-    
-    time_t now;
-    time(&now);
-    snprintf(message_queue[queue_tail].message, MESSAGE_QUEUE_SIZE, 
-             "{\"STATUS\":\"%s\",\"TIMESTAMP\":%lld}", status, (long long)now);
-    message_queue[queue_tail].timestamp = now;
-    
-    queue_tail = (queue_tail + 1) % MAX_QUEUED_MESSAGES;
-    queue_count++;
-    
-    ESP_LOGI(TAG, "Queued message: %s (Queue size: %d)", message_queue[(queue_tail - 1 + MAX_QUEUED_MESSAGES) % MAX_QUEUED_MESSAGES].message, queue_count);
+
+    if (awaiting_auth_count >= MAX_AWAITING_AUTH) {
+        // Make room by sending the oldest with whatever the cache says now
+        awaiting_auth[0].deadline_us = 0;
+        flush_awaiting_auth();
+    }
+
+    awaiting_auth_t* held = &awaiting_auth[awaiting_auth_count++];
+    held->entry = *entry;
+    held->channel = channel;
+    held->held_us = esp_timer_get_time();
+    held->deadline_us = held->held_us + AUTH_WAIT_MAX_MS * 1000LL;
+    if (result == PRESENCE_RESULT_PENDING) {
+        ESP_LOGI(TAG, "Holding notification until the presence probe finishes");
+    }
+    flush_awaiting_auth();
+}
+
+/**
+ * Both GPIO input registers as one bitmap, bit n = GPIO n
+ */
+FORCE_INLINE_ATTR uint64_t read_gpio_levels(void) {
+    return REG_READ(GPIO_IN_REG) | ((uint64_t)REG_READ(GPIO_IN1_REG) << 32);
 }
 
 /**
- * Remove message from queue head
+ * Reed switch ISR, shared by every channel - snapshot all inputs at once,
+ * push them to the ring and wake the sensor task
  */
-void dequeue_message() {
-    if (queue_count > 0) {
-        queue_head = (queue_head + 1) % MAX_QUEUED_MESSAGES;
-        queue_count--;
+static void IRAM_ATTR reed_switch_isr(void* arg) {
+    int64_t now_us = esp_timer_get_time();
+    uint64_t levels = read_gpio_levels();
+
+    edge_ring_push(&edge_ring, now_us, levels, (int)(intptr_t)arg);
+
+    BaseType_t higher_priority_woken = pdFALSE;
+    xTaskNotifyFromISR(main_task_handle, EDGE_NOTIFICATION, eSetBits, &higher_priority_woken);
+    portYIELD_FROM_ISR(higher_priority_woken);
+}
+
+/**
+ * Feed the channels whose pins changed since the last snapshot to their
+ * debounce filters - cost follows the number of changes, not of channels
+ * @param mask Pins this snapshot speaks for
+ * @param edge_pin Pin that raised the interrupt, fed even if its level is unchanged, -1 if none
+ */
+static void feed_levels(uint64_t levels, int64_t timestamp_us, uint64_t mask, int edge_pin) {
+    uint64_t changed = (levels ^ sampled_levels) & mask;
+    if (edge_pin >= 0) {
+        changed |= (1ULL << edge_pin) & channel_pin_mask;
+    }
+    sampled_levels = (sampled_levels & ~mask) | (levels & mask);
+
+    while (changed != 0) {
+        int pin = __builtin_ctzll(changed);
+        changed &= changed - 1;
+        debounce_feed(&channels[pin_channel[pin]].debounce, (int)((levels >> pin) & 1), timestamp_us);
     }
 }
 
+/**
+ * Convert a monotonic edge timestamp into wall clock milliseconds
+ */
+static int64_t edge_to_wall_ms(int64_t timestamp_us) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t age_us = esp_timer_get_time() - timestamp_us;
+    return ((int64_t)tv.tv_sec * 1000000 + tv.tv_usec - age_us) / 1000;
+}
 
 /**
- * Process message queue - send all queued messages via ntfy.sh
+ * Learn from how long the door stayed open
  */
-void process_message_queue() {
-    if (!wifi_connected || queue_count == 0) {
+static void record_open_gap(sensor_channel_t* channel, int64_t gap_ms) {
+    // A clock step (first NTP sync) in between makes the gap meaningless
+    if (gap_ms < 0 || gap_ms > OPEN_GAP_MAX_MS) {
         return;
     }
-    
-    ESP_LOGI(TAG, "Processing %d queued messages via ntfy.sh", queue_count);
-    
-    while (queue_count > 0) {
-        char* message = message_queue[queue_head].message;
-        
-        if (send_ntfy_notification(message)) {
-            ESP_LOGI(TAG, "Queued notification sent successfully via ntfy.sh");
-            dequeue_message();
-        } else {
-            ESP_LOGW(TAG, "Failed to send queued notification, will retry later");
-            break;  // Stop processing if connection fails
-        }
-        
-        vTaskDelay(pdMS_TO_TICKS(500));  // Small delay between messages to avoid rate limiting
+
+    if (batch_window_add(&channel->window, (uint32_t)gap_ms)) {
+        ESP_LOGI(TAG, "%s batch window now %lu ms (p%d of %u recent gaps, last %ld ms)", channel->name,
+                 (unsigned long)batch_window_timeout_ms(&channel->window), BATCH_WINDOW_PERCENTILE,
+                 (unsigned)channel->window.total, (long)gap_ms);
     }
 }
 
 /**
- * Format time in 12-hour format with AM/PM
+ * Handle a debounced door state change
  */
-void format_time_12h(struct tm* timeinfo, char* buffer, size_t size) {
-    int hour = timeinfo->tm_hour;
-    const char* ampm = (hour >= 12) ? "PM" : "AM";
-    
-    if (hour == 0) hour = 12;       // 12 AM
-    else if (hour > 12) hour -= 12; // PM hours
-    
-    snprintf(buffer, size, "%d:%02d %s", hour, timeinfo->tm_min, ampm);
+static void handle_door_change(sensor_channel_t* channel, int door_state, int64_t timestamp_us) {
+    if (door_state == channel->door_state) {
+        return;
+    }
+
+    int64_t settle_us = esp_timer_get_time() - timestamp_us;
+    metrics_observe_us(METRIC_STAGE_DEBOUNCE, settle_us);
+    TRACE(DOOR_COMMITTED, channel - channels, door_state == DOOR_OPEN, settle_us, channel->debounce.bounces);
+
+    // Update the current state
+    channel->door_state = door_state;
+    int64_t when_ms = edge_to_wall_ms(timestamp_us);
+    time_t when = (time_t)(when_ms / 1000);
+    time_quality_t quality = time_sync_quality();
+
+    if (door_state == DOOR_OPEN) {
+        channel->opened_ms = when_ms;
+    } else if (channel->opened_ms != 0) {
+        record_open_gap(channel, when_ms - channel->opened_ms);
+        channel->opened_ms = 0;
+    }
+
+    // Probe for the phone right away so the answer is in by the time the door closes
+    uint32_t probe_ticket = presence_note_activity();
+
+    // Perform actions based on door state
+    if (door_state == DOOR_OPEN) {
+        // Door opened
+        ESP_LOGI(TAG, "%s Opened!", channel->name);
+        status_led_request(LED_PATTERN_OPEN);  // Blink LED once
+
+        // Add to batch processing
+        add_event_to_batch(channel, DOOR_OPEN, when, quality, probe_ticket);
+
+    } else {
+        // Door closed
+        ESP_LOGI(TAG, "%s Closed!", channel->name);
+        status_led_request(LED_PATTERN_CLOSE);  // Blink LED twice
+
+        // Add to batch processing
+        add_event_to_batch(channel, DOOR_CLOSED, when, quality, probe_ticket);
+    }
+}
+
+/**
+ * Keep a committed change until the wall clock and presence tracking are up,
+ * so it is stamped and authenticated like any other
+ */
+static void hold_door_change(sensor_channel_t* channel, int door_state, int64_t timestamp_us) {
+    if (held_change_count == BOOT_HOLD_MAX) {
+        ESP_LOGW(TAG, "Boot hold full, handling the oldest door change now");
+        held_change_t* oldest = &held_changes[0];
+        handle_door_change(&channels[oldest->channel], oldest->door_state, oldest->timestamp_us);
+        held_change_count--;
+        memmove(held_changes, &held_changes[1], sizeof(held_change_t) * held_change_count);
+    }
+
+    held_change_t* held = &held_changes[held_change_count++];
+    held->timestamp_us = timestamp_us;
+    held->channel = (uint8_t)(channel - channels);
+    held->door_state = (int8_t)door_state;
+    ESP_LOGI(TAG, "%s %s during startup, held until time and presence are ready", channel->name,
+             door_state == DOOR_OPEN ? "opened" : "closed");
 }
 
 /**
- * Parse MAC address string into esp_bd_addr_t
+ * Track the boot tasks - release held changes once time and presence are ready
+ * and report the startup breakdown when everything is up
  */
-void parse_mac_address(const char* mac_str, esp_bd_addr_t mac_addr) {
-    int values[6];
-    int result = sscanf(mac_str, "%x:%x:%x:%x:%x:%x",
-                        &values[0], &values[1], &values[2],
-                        &values[3], &values[4], &values[5]);
+static void check_boot_progress(void) {
+    EventBits_t bits = xEventGroupGetBits(boot_event_group);
 
-    if (result == 6) {
-        for (int i = 0; i < 6; i++) {
-            mac_addr[i] = (uint8_t)values[i];
+    if (boot_holding && (bits & BOOT_RELEASE_BITS) == BOOT_RELEASE_BITS) {
+        boot_holding = false;
+        if (held_change_count > 0) {
+            ESP_LOGI(TAG, "Handling %d door changes held during startup", held_change_count);
         }
-        ESP_LOGI(TAG, "MAC parsing successful: %d fields parsed", result);
-    } else {
-        ESP_LOGW(TAG, "MAC parsing failed: only %d fields parsed", result);
-        // Set to all zeros on failure
-        memset(mac_addr, 0, 6);
+        for (int i = 0; i < held_change_count; i++) {
+            held_change_t* held = &held_changes[i];
+            handle_door_change(&channels[held->channel], held->door_state, held->timestamp_us);
+        }
+        held_change_count = 0;
+    }
+
+    if (!boot_reported && (bits & BOOT_ALL_BITS) == BOOT_ALL_BITS) {
+        boot_reported = true;
+        int64_t ready_us = boot_wifi_us;
+        if (boot_time_us > ready_us) {
+            ready_us = boot_time_us;
+        }
+        if (boot_presence_us > ready_us) {
+            ready_us = boot_presence_us;
+        }
+        ESP_LOGI(TAG, "Boot: armed %ld ms, WiFi %ld ms (%s), time %ld ms (%s), presence %ld ms, fully ready %ld ms",
+                 (long)(armed_us / 1000), (long)(boot_wifi_us / 1000), wifi_connected ? "connected" : "offline",
+                 (long)(boot_time_us / 1000), time_sync_quality_name(time_sync_quality()),
+                 (long)(boot_presence_us / 1000), (long)(ready_us / 1000));
     }
 }
 
 /**
- * SPP callback function
+ * Commit any debounced change whose settle and hold times have elapsed
  */
-void spp_callback(esp_spp_cb_event_t event, esp_spp_cb_param_t *param) {
-    switch (event) {
-        case ESP_SPP_INIT_EVT:
-            ESP_LOGI(TAG, "SPP initialized");
-            break;
-        case ESP_SPP_OPEN_EVT:
-            if (param->open.status == ESP_SPP_SUCCESS) {
-                ESP_LOGI(TAG, "SPP connection opened successfully - phone authenticated");
-                spp_connected = true;
-                spp_handle = param->open.handle;
+static void poll_door_debounce(void) {
+    int64_t now_us = esp_timer_get_time();
+    for (int i = 0; i < channel_count; i++) {
+        int door_state;
+        int64_t since_us;
+        if (debounce_poll(&channels[i].debounce, now_us, &door_state, &since_us)) {
+            if (boot_holding) {
+                hold_door_change(&channels[i], door_state, since_us);
             } else {
-                ESP_LOGI(TAG, "SPP connection failed but phone responded: %d - phone authenticated", param->open.status);
-                spp_connected = true;  // Any response means phone is present
+                handle_door_change(&channels[i], door_state, since_us);
             }
-            break;
-        case ESP_SPP_CLOSE_EVT:
-            ESP_LOGI(TAG, "SPP connection closed (handle: %d) - phone responded", param->close.handle);
-            // Only count as authenticated if we had a real connection attempt
-            if (param->close.handle != 0) {
-                spp_connected = true;  // Connection attempt got a response, phone is present
-            }
-            spp_handle = 0;
-            break;
-        case ESP_SPP_CONG_EVT:
-            ESP_LOGD(TAG, "SPP congestion status: %d", param->cong.cong);
-            break;
-        default:
-            break;
+        }
     }
 }
 
 /**
- * Initialize Bluetooth SPP
+ * Whether any channel has a change still settling
  */
-void init_bluetooth_spp(void) {
-    if (bt_initialized) return;
-
-    ESP_LOGI(TAG, "Initializing Bluetooth SPP for phone authentication");
+static bool debounce_pending(void) {
+    for (int i = 0; i < channel_count; i++) {
+        if (debounce_deadline(&channels[i].debounce) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Parse the MAC address from config
-    ESP_LOGI(TAG, "Parsing MAC address: '%s'", PHONE_BT_MAC);
-    parse_mac_address(PHONE_BT_MAC, phone_mac_addr);
-    ESP_LOGI(TAG, "Parsed MAC: %02x:%02x:%02x:%02x:%02x:%02x",
-             phone_mac_addr[0], phone_mac_addr[1], phone_mac_addr[2],
-             phone_mac_addr[3], phone_mac_addr[4], phone_mac_addr[5]);
+/**
+ * How long the sensor loop may block before it has work to do
+ */
+static TickType_t sensor_wait_ticks(void) {
+    TickType_t wait_ticks = portMAX_DELAY;
+
+    for (int i = 0; i < channel_count; i++) {
+        int64_t deadline_us = debounce_deadline(&channels[i].debounce);
+        if (deadline_us >= 0) {
+            int64_t remaining_us = deadline_us - esp_timer_get_time();
+            TickType_t debounce_ticks = (remaining_us > 0) ? pdMS_TO_TICKS(remaining_us / 1000) + 1 : 0;
+            if (debounce_ticks < wait_ticks) {
+                wait_ticks = debounce_ticks;
+            }
+        }
+    }
 
-    // Check current controller status
-    esp_bt_controller_status_t status = esp_bt_controller_get_status();
-    ESP_LOGI(TAG, "BT controller status: %d", status);
+    // Pins without an edge interrupt are sampled on every pass
+    if (polled_pin_mask != 0 && wait_ticks > pdMS_TO_TICKS(SENSOR_POLL_MS)) {
+        wait_ticks = pdMS_TO_TICKS(SENSOR_POLL_MS);
+    }
 
-    // Release BLE memory to save RAM (only if controller is in IDLE state)
-    if (status == ESP_BT_CONTROLLER_STATUS_IDLE) {
-        ESP_LOGI(TAG, "Releasing BLE memory...");
-        esp_err_t ret = esp_bt_controller_mem_release(ESP_BT_MODE_BLE);
-        if (ret != ESP_OK) {
-            ESP_LOGW(TAG, "BT controller BLE mem release failed: %s", esp_err_to_name(ret));
-        } else {
-            ESP_LOGI(TAG, "BLE memory released successfully");
+    // Held-back notifications go out when their probe finishes (PRESENCE_NOTIFICATION)
+    // or at their deadline, whichever comes first
+    if (awaiting_auth_count > 0) {
+        int64_t remaining_us = awaiting_auth[0].deadline_us - esp_timer_get_time();
+        TickType_t auth_ticks = (remaining_us > 0) ? pdMS_TO_TICKS(remaining_us / 1000) + 1 : 0;
+        if (auth_ticks < wait_ticks) {
+            wait_ticks = auth_ticks;
         }
-    } else {
-        ESP_LOGW(TAG, "Skipping BLE memory release - controller not in IDLE state");
-    }
-
-    // Initialize BT controller
-    ESP_LOGI(TAG, "Initializing BT controller...");
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-
-    // Try absolute defaults first to isolate the issue
-    ESP_LOGI(TAG, "Using default BT controller configuration (no modifications)");
-    // bt_cfg.controller_task_stack_size = 3072;  // Commented out for testing
-    // bt_cfg.controller_task_prio = 20;          // Commented out for testing
-
-    // Log the configuration parameters for debugging
-    ESP_LOGI(TAG, "BT controller config:");
-    ESP_LOGI(TAG, "  task_stack_size: %d", bt_cfg.controller_task_stack_size);
-    ESP_LOGI(TAG, "  task_prio: %d", bt_cfg.controller_task_prio);
-    ESP_LOGI(TAG, "  hci_uart_no: %d", bt_cfg.hci_uart_no);
-    ESP_LOGI(TAG, "  hci_uart_baudrate: %d", bt_cfg.hci_uart_baudrate);
-    ESP_LOGI(TAG, "  scan_duplicate_mode: %d", bt_cfg.scan_duplicate_mode);
-    ESP_LOGI(TAG, "  scan_duplicate_type: %d", bt_cfg.scan_duplicate_type);
-    ESP_LOGI(TAG, "  normal_adv_size: %d", bt_cfg.normal_adv_size);
-    ESP_LOGI(TAG, "  mesh_adv_size: %d", bt_cfg.mesh_adv_size);
-    ESP_LOGI(TAG, "  send_adv_reserved_size: %d", bt_cfg.send_adv_reserved_size);
-    ESP_LOGI(TAG, "  controller_debug_flag: %d", bt_cfg.controller_debug_flag);
-    ESP_LOGI(TAG, "  mode: %d", bt_cfg.mode);
-
-    esp_err_t ret = esp_bt_controller_init(&bt_cfg);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "BT controller init failed: %s", esp_err_to_name(ret));
-        return;
     }
-    ESP_LOGI(TAG, "BT controller initialized successfully");
 
-    ESP_LOGI(TAG, "Enabling BT controller for Classic BT...");
-    ret = esp_bt_controller_enable(ESP_BT_MODE_CLASSIC_BT);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "BT controller enable failed: %s", esp_err_to_name(ret));
-        return;
+    // A held entry goes out as soon as delivery has caught up
+    if (entries_held() && wait_ticks > pdMS_TO_TICKS(RUN_FLUSH_CHECK_MS)) {
+        wait_ticks = pdMS_TO_TICKS(RUN_FLUSH_CHECK_MS);
     }
-    ESP_LOGI(TAG, "BT controller enabled successfully");
 
-    // Initialize Bluedroid stack
-    ESP_LOGI(TAG, "Initializing Bluedroid stack...");
-    ret = esp_bluedroid_init();
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Bluedroid init failed: %s", esp_err_to_name(ret));
-        return;
+#if CONFIG_DOOR_DEEP_SLEEP
+    // Keep checking whether delivery has finished so the device can sleep again
+    if (deep_sleep_enabled && wait_ticks > pdMS_TO_TICKS(SLEEP_CHECK_INTERVAL_MS)) {
+        wait_ticks = pdMS_TO_TICKS(SLEEP_CHECK_INTERVAL_MS);
     }
-    ESP_LOGI(TAG, "Bluedroid initialized successfully");
+#endif
+    return wait_ticks;
+}
 
-    ESP_LOGI(TAG, "Enabling Bluedroid stack...");
-    ret = esp_bluedroid_enable();
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Bluedroid enable failed: %s", esp_err_to_name(ret));
+#if CONFIG_DOOR_DEEP_SLEEP
+/**
+ * Current wall clock time in microseconds (keeps running through deep sleep)
+ */
+static int64_t wall_time_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/**
+ * Restore door states and event batches saved before the last deep sleep
+ */
+static void restore_sleep_state(void) {
+    for (int i = 0; i < channel_count; i++) {
+        if (!rtc_gpio_is_valid_gpio(channels[i].pin)) {
+            ESP_LOGE(TAG, "GPIO %d (%s) cannot wake the chip from deep sleep - staying awake",
+                     channels[i].pin, channels[i].name);
+            return;
+        }
+    }
+    deep_sleep_enabled = true;
+
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (cause == ESP_SLEEP_WAKEUP_UNDEFINED || rtc_state.magic != RTC_STATE_MAGIC) {
+        // Power-on or reset - RTC memory holds garbage
+        memset(&rtc_state, 0, sizeof(rtc_state));
+        rtc_state.magic = RTC_STATE_MAGIC;
+        for (int i = 0; i < MAX_SENSOR_CHANNELS; i++) {
+            rtc_state.door_state[i] = -1;
+        }
         return;
     }
-    ESP_LOGI(TAG, "Bluedroid enabled successfully");
 
-    // Initialize SPP (now that Bluedroid is ready)
-    ESP_LOGI(TAG, "Registering SPP callback...");
-    ret = esp_spp_register_callback(spp_callback);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "SPP callback register failed: %s", esp_err_to_name(ret));
-        return;
+    int batched = 0;
+    for (int i = 0; i < channel_count; i++) {
+        sensor_channel_t* channel = &channels[i];
+
+        // ext0/ext1 left the pin routed to the RTC mux - hand it back to the GPIO matrix
+        rtc_gpio_deinit(channel->pin);
+
+        channel->door_state = rtc_state.door_state[i];
+        channel->batch = rtc_state.batch[i];
+        channel->window = rtc_state.window[i];
+        channel->opened_ms = rtc_state.opened_ms[i];
+        for (int j = 0; j < BATCHER_SIZE; j++) {
+            channel->batch.entries[j].probe_ticket = 0;   // Probe numbering restarts on every boot
+        }
+        batched += channel->batch.count;
     }
-    ESP_LOGI(TAG, "SPP callback registered successfully");
+    rtc_state.wake_count++;
 
-    ESP_LOGI(TAG, "Initializing SPP with legacy API...");
-    ret = esp_spp_init(ESP_SPP_MODE_CB);  // Use older, stable API instead of enhanced
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "SPP init failed: %s", esp_err_to_name(ret));
+    ESP_LOGI(TAG, "Woke from deep sleep by %s (wake #%lu, %d batched entries)",
+             (cause == ESP_SLEEP_WAKEUP_EXT0 || cause == ESP_SLEEP_WAKEUP_EXT1) ? "reed switch" :
+             (cause == ESP_SLEEP_WAKEUP_TIMER) ? "timer" : "other source",
+             (unsigned long)rtc_state.wake_count, batched);
+}
+
+/**
+ * Resume the batch timers with whatever was left of them when the device went to sleep
+ */
+static void resume_batch_timer(void) {
+    if (!deep_sleep_enabled) {
         return;
     }
-    ESP_LOGI(TAG, "SPP initialized successfully with legacy API");
 
-    bt_initialized = true;
-    ESP_LOGI(TAG, "Bluetooth SPP initialization completed successfully!");
+    for (int i = 0; i < channel_count; i++) {
+        sensor_channel_t* channel = &channels[i];
+        if (channel->batch.count == 0 || rtc_state.batch_deadline_us[i] == 0) {
+            continue;
+        }
+
+        int64_t remaining_us = rtc_state.batch_deadline_us[i] - wall_time_us();
+        if (remaining_us <= 0) {
+            channel->batch_expired = true;
+            xTaskNotify(main_task_handle, BATCH_TIMEOUT_NOTIFICATION, eSetBits);
+            continue;
+        }
+        xTimerChangePeriod(channel->batch_timer, pdMS_TO_TICKS(remaining_us / 1000) + 1, 0);
+        channel->batch_timer_active = true;
+        ESP_LOGI(TAG, "%s batch timer resumed with %ld ms left", channel->name, (long)(remaining_us / 1000));
+    }
 }
 
 /**
- * Try to connect to phone via SPP with 10-second timeout
+ * Whether everything from this wake has been handled and the device may sleep
  */
-bool try_connect_to_phone(void) {
-    if (!bt_initialized) {
-        ESP_LOGW(TAG, "Bluetooth not initialized");
+static bool ready_for_deep_sleep(void) {
+    if (!deep_sleep_enabled || debounce_pending() || edge_ring_count(&edge_ring) > 0) {
         return false;
     }
 
-    ESP_LOGI(TAG, "Attempting SPP connection to phone MAC: %02x:%02x:%02x:%02x:%02x:%02x",
-             phone_mac_addr[0], phone_mac_addr[1], phone_mac_addr[2],
-             phone_mac_addr[3], phone_mac_addr[4], phone_mac_addr[5]);
-    spp_connected = false;
-
-    // Start SPP connection attempt
-    esp_err_t ret = esp_spp_connect(ESP_SPP_SEC_NONE, ESP_SPP_ROLE_MASTER, 1, phone_mac_addr);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "SPP connect failed: %s", esp_err_to_name(ret));
+    // Never power down the radios halfway through bringing them up
+    if (!boot_reported || held_change_count > 0) {
         return false;
     }
 
-    ESP_LOGI(TAG, "SPP connect initiated, waiting for connection...");
-
-    // Wait for connection with shorter timeout to avoid stack issues
-    uint32_t timeout_ms = 3000;  // Reduce to 3 seconds
-    uint32_t start_time = esp_timer_get_time() / 1000;
+    // Let a probe started by door activity finish so its answer lands in the cache
+    if (presence_busy() || awaiting_auth_count > 0) {
+        return false;
+    }
 
-    while (!spp_connected && ((esp_timer_get_time() / 1000) - start_time) < timeout_ms) {
-        vTaskDelay(pdMS_TO_TICKS(200));  // Longer delay, fewer iterations
+    notify_stats_t stats;
+    notifier_get_stats(&stats);
+    if (notified_us == 0 && stats.delivered > 0) {
+        notified_us = esp_timer_get_time();
     }
 
-    if (spp_connected) {
-        ESP_LOGI(TAG, "Phone authenticated - device responded to connection attempt");
-        // Try to disconnect if we have a handle, but don't wait
-        if (spp_handle != 0) {
-            esp_spp_disconnect(spp_handle);
-        }
-        return true;
-    } else {
-        ESP_LOGW(TAG, "Phone authentication timeout - device not found after %lu ms", timeout_ms);
+    // Never sleep with a request on the wire or backlog changes only in RAM
+    if (stats.pending > 0 || stats.state == NOTIFY_STATE_IN_FLIGHT || stats.log_dirty) {
         return false;
     }
+    if (stats.backlog == 0) {
+        return true;
+    }
+    return esp_timer_get_time() / 1000 >= CONFIG_DOOR_DEEP_SLEEP_AWAKE_MAX_MS;
 }
 
 /**
- * Create notification message from event(s)
+ * Save state to RTC memory, report the wake latency budget and enter deep sleep
  */
-void create_notification_message(char* message, size_t max_len, door_event_t* events, int count, bool authenticated) {
-    const char* auth_status = authenticated ? "" : " ⚠️ (Unauthenticated)";
+static void enter_deep_sleep(void) {
+    notify_stats_t stats;
+    notifier_get_stats(&stats);
+
+    // Earliest timer wake wanted by anything below, 0 if none
+    uint64_t timer_wake_us = 0;
+    int batched = 0;
+
+    for (int i = 0; i < channel_count; i++) {
+        sensor_channel_t* channel = &channels[i];
+        rtc_state.door_state[i] = channel->door_state;
+        rtc_state.batch[i] = channel->batch;
+        rtc_state.window[i] = channel->window;
+        rtc_state.opened_ms[i] = channel->opened_ms;
+        rtc_state.batch_deadline_us[i] = 0;
+        batched += channel->batch.count;
+
+        if (channel->batch_timer_active) {
+            // Entries not sent yet - wake when the batch would have timed out
+            TickType_t remaining = xTimerGetExpiryTime(channel->batch_timer) - xTaskGetTickCount();
+            uint64_t remaining_us = (uint64_t)pdTICKS_TO_MS(remaining) * 1000;
+            rtc_state.batch_deadline_us[i] = wall_time_us() + (int64_t)remaining_us;
+            if (timer_wake_us == 0 || remaining_us < timer_wake_us) {
+                timer_wake_us = remaining_us;
+            }
+        }
+    }
 
-    if (count == 1) {
-        // Single event - use exclamation emoji for open doors (security concern)
-        struct tm* timeinfo = localtime(&events[0].timestamp);
-        char time_str[16];
-        format_time_12h(timeinfo, time_str, sizeof(time_str));
+    if (stats.backlog > 0) {
+        // Undelivered notifications stay in the flash log - come back to retry them
+        uint64_t retry_us = (uint64_t)CONFIG_DOOR_DEEP_SLEEP_RETRY_S * 1000000;
+        if (timer_wake_us == 0 || retry_us < timer_wake_us) {
+            timer_wake_us = retry_us;
+        }
+    }
 
-        if (events[0].state == DOOR_OPEN) {
-            snprintf(message, max_len, "❗ Door opened at %s%s", time_str, auth_status);
+    // Wake on the level opposite to the one each switch rests at now. ext1 can
+    // only wake on any pin going high, so closed (low) channels share it; ext0
+    // takes one open channel and any others are checked on a timer.
+    uint64_t ext1_mask = 0;
+    int ext0_pin = -1;
+    for (int i = 0; i < channel_count; i++) {
+        gpio_num_t pin = channels[i].pin;
+        if (gpio_get_level(pin) == 0) {
+            ext1_mask |= 1ULL << pin;
+        } else if (ext0_pin < 0) {
+            ext0_pin = pin;
         } else {
-            snprintf(message, max_len, "🚪 Door closed at %s%s", time_str, auth_status);
+            ESP_LOGW(TAG, "%s left open - checking it every %d s", channels[i].name, OPEN_CHANNEL_POLL_S);
+            uint64_t poll_us = (uint64_t)OPEN_CHANNEL_POLL_S * 1000000;
+            if (timer_wake_us == 0 || poll_us < timer_wake_us) {
+                timer_wake_us = poll_us;
+            }
         }
-    } else if (count == 2 && events[0].state == DOOR_OPEN && events[1].state == DOOR_CLOSED) {
-        // Valid pair: OPEN -> CLOSE - simplified format
-        struct tm* open_time = localtime(&events[0].timestamp);
-        char time_str[16];
-        format_time_12h(open_time, time_str, sizeof(time_str));
 
-        snprintf(message, max_len, "🚪 Door Open/Close (%s)%s", time_str, auth_status);
-    } else {
-        // Complex pattern - fallback to count
-        snprintf(message, max_len, "⚠️ Door activity: %d events detected%s", count, auth_status);
+        // The digital pull-up is off in deep sleep - hold the pin with the RTC pad's own
+        rtc_gpio_pullup_en(pin);
+        rtc_gpio_pulldown_dis(pin);
     }
-}
 
-/**
- * Process and send accumulated events
- */
-void process_accumulated_events() {
-    if (event_count == 0) return;
-    
-    ESP_LOGI(TAG, "Processing %d accumulated events", event_count);
-    
-    int processed = 0;
-    while (processed < event_count) {
-        // Look for OPEN->CLOSE pairs
-        if (processed + 1 < event_count && 
-            event_buffer[processed].state == DOOR_OPEN && 
-            event_buffer[processed + 1].state == DOOR_CLOSED) {
-            
-            // Found a pair
-            char message[256];
-            door_event_t pair[2] = {event_buffer[processed], event_buffer[processed + 1]};
-            bool authenticated = try_connect_to_phone();
-            create_notification_message(message, sizeof(message), pair, 2, authenticated);
-            queue_message_direct(message);
-            
-            processed += 2;  // Skip both events in the pair
-        } else {
-            // Single event
-            char message[256];
-            bool authenticated = try_connect_to_phone();
-            create_notification_message(message, sizeof(message), &event_buffer[processed], 1, authenticated);
-            queue_message_direct(message);
-            
-            processed += 1;
-        }
+    if (ext1_mask != 0) {
+        esp_sleep_enable_ext1_wakeup(ext1_mask, ESP_EXT1_WAKEUP_ANY_HIGH);
+        // ext1 alone does not keep the RTC pads, and so their pull-ups, powered
+        esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
     }
-    
-    // Clear the event buffer
-    event_count = 0;
-    ESP_LOGI(TAG, "Event buffer cleared");
+    if (ext0_pin >= 0) {
+        esp_sleep_enable_ext0_wakeup((gpio_num_t)ext0_pin, 0);
+    }
+    if (timer_wake_us > 0) {
+        esp_sleep_enable_timer_wakeup(timer_wake_us);
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    rtc_state.awake_total_ms += now_us / 1000;
+    ESP_LOGI(TAG, "Wake budget: armed %ld ms, WiFi %ld ms, notified %ld ms, awake %ld ms (%lu delivered, %lu backlog)",
+             (long)(armed_us / 1000), (long)(wifi_ready_us / 1000), (long)(notified_us / 1000),
+             (long)(now_us / 1000), (unsigned long)stats.delivered, (unsigned long)stats.backlog);
+    ESP_LOGI(TAG, "Entering deep sleep (%d channels, %d batched entries, %lu wakes, %lu ms awake in total)",
+             channel_count, batched, (unsigned long)rtc_state.wake_count, (unsigned long)rtc_state.awake_total_ms);
+
+    esp_deep_sleep_start();
 }
+#endif
 
 /**
- * Timer callback for batch timeout - lightweight, just notify main task
+ * Add a sensor channel unless its pin is invalid or already taken
  */
-void batch_timer_callback(TimerHandle_t xTimer) {
-    batch_timer_active = false;
-    // Notify main task to process events (don't do heavy work in timer callback)
-    if (main_task_handle != NULL) {
-        xTaskNotify(main_task_handle, BATCH_TIMEOUT_NOTIFICATION, eSetBits);
+static void add_sensor_channel(const char* name, int pin) {
+    if (!GPIO_IS_VALID_GPIO(pin) || (channel_pin_mask & (1ULL << pin))) {
+        ESP_LOGW(TAG, "Skipping sensor channel '%s': GPIO %d invalid or already in use", name, pin);
+        return;
     }
+
+    sensor_channel_t* channel = &channels[channel_count];
+    strlcpy(channel->name, name, sizeof(channel->name));
+    channel->pin = (gpio_num_t)pin;
+    channel->door_state = -1;   // Invalid state to force initial detection
+    debounce_init(&channel->debounce, CONFIG_DOOR_DEBOUNCE_SETTLE_MS, CONFIG_DOOR_DEBOUNCE_MIN_HOLD_MS);
+    batch_window_init(&channel->window, BATCH_WINDOW_PERCENTILE, BATCH_WINDOW_MIN_MS, BATCH_TIMEOUT_MS);
+    door_record_set_channel_name((uint8_t)channel_count, channel->name);
+
+    pin_channel[pin] = (int8_t)channel_count;
+    channel_pin_mask |= 1ULL << pin;
+    channel_count++;
 }
 
 /**
- * Add event to batch buffer
+ * Fill the channel table from "Name=GPIO,Name=GPIO,..." or the single reed switch pin
  */
-void add_event_to_batch(int door_state, time_t timestamp) {
-    if (event_count >= MAX_EVENT_BUFFER) {
-        ESP_LOGW(TAG, "Event buffer full, processing immediately");
-        process_accumulated_events();
-    }
-    
-    // Add new event
-    event_buffer[event_count].state = door_state;
-    event_buffer[event_count].timestamp = timestamp;
-    event_buffer[event_count].processed = false;
-    event_count++;
-    
-    ESP_LOGI(TAG, "Added event to batch: %s (buffer size: %d)", 
-             (door_state == DOOR_OPEN) ? "OPEN" : "CLOSE", event_count);
-    
-    // Check for immediate pair completion
-    if (event_count >= 2) {
-        int last = event_count - 1;
-        int prev = event_count - 2;
-        
-        // If we have OPEN->CLOSE pair, process it immediately
-        if (event_buffer[prev].state == DOOR_OPEN && 
-            event_buffer[last].state == DOOR_CLOSED) {
-            
-            ESP_LOGI(TAG, "Complete pair detected, processing immediately");
-            
-            // Create pair message
-            char message[256];
-            door_event_t pair[2] = {event_buffer[prev], event_buffer[last]};
-            bool authenticated = try_connect_to_phone();
-            create_notification_message(message, sizeof(message), pair, 2, authenticated);
-            queue_message_direct(message);
-            
-            // Remove the pair from buffer
-            event_count -= 2;
-            
-            // Shift remaining events (if any)
-            for (int i = 0; i < event_count; i++) {
-                event_buffer[i] = event_buffer[i + 2];
-            }
-            
-            // If buffer is empty, stop timer
-            if (event_count == 0 && batch_timer_active) {
-                xTimerStop(batch_timer, 0);
-                batch_timer_active = false;
-                ESP_LOGI(TAG, "Buffer empty, stopping batch timer");
+static void parse_sensor_channels(void) {
+    const char* p = SENSOR_CHANNELS;
+
+    while (*p != '\0' && channel_count < MAX_SENSOR_CHANNELS) {
+        size_t len = strcspn(p, ",;");
+        char entry[SENSOR_NAME_MAX + 8];
+
+        if (len >= sizeof(entry)) {
+            ESP_LOGW(TAG, "Skipping sensor channel entry longer than %d characters", (int)sizeof(entry) - 1);
+        } else if (len > 0) {
+            memcpy(entry, p, len);
+            entry[len] = '\0';
+
+            char* pin = strchr(entry, '=');
+            if (pin == NULL) {
+                ESP_LOGW(TAG, "Sensor channel '%s' is not Name=GPIO", entry);
+            } else {
+                *pin++ = '\0';
+                char* name = entry;
+                while (*name == ' ') {
+                    name++;
+                }
+                size_t name_len = strlen(name);
+                while (name_len > 0 && name[name_len - 1] == ' ') {
+                    name[--name_len] = '\0';
+                }
+                add_sensor_channel(name, atoi(pin));
             }
-            
-            return;  // Don't start/restart timer
         }
-    }
-    
-    // Start or restart timer for remaining events
-    if (batch_timer_active) {
-        xTimerReset(batch_timer, 0);
-        ESP_LOGI(TAG, "Batch timer reset");
-    } else {
-        xTimerStart(batch_timer, 0);
-        batch_timer_active = true;
-        ESP_LOGI(TAG, "Batch timer started");
-    }
-}
 
-/**
- * Direct message sending (try ntfy immediately, queue if failed)
- */
-void queue_message_direct(const char* message) {
-    // Try to send immediately if WiFi connected
-    if (wifi_connected && send_ntfy_notification(message)) {
-        ESP_LOGI(TAG, "Notification sent immediately via ntfy.sh");
-        return;
+        p += len;
+        if (*p != '\0') {
+            p++;
+        }
     }
-    
-    // If sending failed or WiFi not connected, queue the message
-    if (queue_count >= MAX_QUEUED_MESSAGES) {
-        ESP_LOGW(TAG, "Message queue full, dropping oldest message");
-        queue_head = (queue_head + 1) % MAX_QUEUED_MESSAGES;
-        queue_count--;
+
+    if (channel_count == 0) {
+        add_sensor_channel("Door", REED_SWITCH_PIN);
     }
-    
-    time_t now;
-    time(&now);
-    strncpy(message_queue[queue_tail].message, message, MESSAGE_QUEUE_SIZE - 1);
-    message_queue[queue_tail].message[MESSAGE_QUEUE_SIZE - 1] = '\0';
-    message_queue[queue_tail].timestamp = now;
-    
-    queue_tail = (queue_tail + 1) % MAX_QUEUED_MESSAGES;
-    queue_count++;
-    
-    ESP_LOGI(TAG, "Queued notification for retry: %s (Queue size: %d)", message, queue_count);
 }
 
-
 /**
  * Function to configure GPIO pins
  */
 void configure_gpio(void) {
-    // Configure reed switch pin as input with pull-up resistor
+    // Configure every reed switch pin as input with pull-up resistor
     gpio_config_t reed_switch_config = {
-        .pin_bit_mask = (1ULL << REED_SWITCH_PIN),
+        .pin_bit_mask = channel_pin_mask,
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
+        .intr_type = GPIO_INTR_ANYEDGE
     };
     gpio_config(&reed_switch_config);
 
-    // Configure LED pin as output
-    gpio_config_t led_config = {
-        .pin_bit_mask = (1ULL << LED_PIN),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
-    };
-    gpio_config(&led_config);
+    // Capture every edge in the ISR instead of polling the level
+    edge_ring_init(&edge_ring);
+    ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    for (int i = 0; i < channel_count; i++) {
+        sensor_channel_t* channel = &channels[i];
+        esp_err_t ret = gpio_isr_handler_add(channel->pin, reed_switch_isr, (void*)(intptr_t)channel->pin);
+        if (ret != ESP_OK) {
+            // Still works, just sampled by the sensor loop
+            ESP_LOGW(TAG, "No edge interrupt for %s on GPIO %d (%s) - polling every %d ms",
+                     channel->name, channel->pin, esp_err_to_name(ret), SENSOR_POLL_MS);
+            gpio_set_intr_type(channel->pin, GPIO_INTR_DISABLE);
+            channel->polled = true;
+            polled_pin_mask |= 1ULL << channel->pin;
+        }
+        ESP_LOGI(TAG, "Sensor channel %d: %s on GPIO %d", i, channel->name, channel->pin);
+    }
+
+    // Configure LED pin and the asynchronous pattern engine
+    ESP_ERROR_CHECK(status_led_init(LED_PIN));
+}
 
-    // Initialize LED to off state
-    gpio_set_level(LED_PIN, 0);
+/**
+ * Mark a boot stage done and wake the sensor loop to look at it
+ */
+static void boot_stage_done(EventBits_t bit) {
+    xEventGroupSetBits(boot_event_group, bit);
+    xTaskNotify(main_task_handle, BOOT_NOTIFICATION, eSetBits);
+}
+
+/**
+ * Boot task - bring up WiFi, then the wall clock over NTP
+ */
+static void network_boot_task(void* arg) {
+    ESP_LOGI(TAG, "Starting WiFi initialization in STA mode...");
+    wifi_init_sta();
+    xEventGroupSetBits(boot_event_group, BOOT_WIFI_STARTED_BIT);
+#if CONFIG_DOOR_METRICS
+    metrics_server_start();
+#endif
+
+    wifi_wait_connected();
+    boot_wifi_us = esp_timer_get_time();
+    boot_stage_done(BOOT_WIFI_DONE_BIT);
+
+    if (!(xEventGroupGetBits(boot_event_group) & BOOT_TIME_DONE_BIT)) {
+        // The sync task starts SNTP as soon as WiFi is up - wait for its first answer
+        if (!wifi_connected) {
+            ESP_LOGW(TAG, "WiFi not connected - door changes go out with unsynced times");
+        } else if (!time_sync_wait(BOOT_TIME_WAIT_MS)) {
+            ESP_LOGW(TAG, "No NTP answer after %d ms - door changes go out with unsynced times", BOOT_TIME_WAIT_MS);
+        }
+        boot_time_us = esp_timer_get_time();
+        boot_stage_done(BOOT_TIME_DONE_BIT);
+    }
+    mem_task_exit();
+}
+
+/**
+ * Boot task - start presence tracking once the WiFi driver is up, since both
+ * radios share the coexistence layer and must not initialize concurrently
+ */
+static void presence_boot_task(void* arg) {
+    xEventGroupWaitBits(boot_event_group, BOOT_WIFI_STARTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    ESP_LOGI(TAG, "Starting Bluetooth presence tracking...");
+    presence_start(main_task_handle, PRESENCE_NOTIFICATION);
+    boot_presence_us = esp_timer_get_time();
+    boot_stage_done(BOOT_PRESENCE_DONE_BIT);
+    mem_report_log("Bluetooth up");
+    mem_task_exit();
 }
 
 /**
@@ -868,14 +1220,24 @@ void configure_gpio(void) {
 void app_main(void) {
     // Store main task handle for notifications
     main_task_handle = xTaskGetCurrentTaskHandle();
+    mem_report_track_task(main_task_handle, CONFIG_ESP_MAIN_TASK_STACK_SIZE);
+
+#if CONFIG_DOOR_TRACE
+    trace_init();
+#endif
 
     // Echo configuration values for debugging
     ESP_LOGI(TAG, "=== DOOR MONITOR CONFIGURATION ===");
     ESP_LOGI(TAG, "WiFi SSID: '%s'", WIFI_SSID);
     ESP_LOGI(TAG, "WiFi Password: '%s'", WIFI_PASS);
     ESP_LOGI(TAG, "Phone BT MAC: '%s'", PHONE_BT_MAC);
+#if CONFIG_DOOR_NOTIFY_TRANSPORT_MQTT
+    ESP_LOGI(TAG, "MQTT Broker: '%s'", CONFIG_DOOR_MQTT_BROKER_URI);
+    ESP_LOGI(TAG, "MQTT Topic: '%s'", CONFIG_DOOR_MQTT_TOPIC);
+#else
     ESP_LOGI(TAG, "NTFY URL: '%s'", NTFY_URL);
     ESP_LOGI(TAG, "NTFY Priority: '%s'", NTFY_PRIORITY);
+#endif
     ESP_LOGI(TAG, "===================================");
 
     // Initialize NVS
@@ -886,87 +1248,142 @@ void app_main(void) {
     }
     ESP_ERROR_CHECK(ret);
 
+    parse_sensor_channels();
+
+#if CONFIG_DOOR_DEEP_SLEEP
+    // Pick up where the last wake left off before the pins are reconfigured
+    restore_sleep_state();
+#endif
+
     // Initialize GPIO pins
     configure_gpio();
+
+    // The edge interrupt only reports changes, so sample the initial state now
+    int64_t initial_edge_us = esp_timer_get_time();
+    uint64_t initial_levels = read_gpio_levels();
     
-    // Create batch timer (but don't start it yet)
-    batch_timer = xTimerCreate("BatchTimer", 
-                              pdMS_TO_TICKS(BATCH_TIMEOUT_MS),
-                              pdFALSE,  // One-shot timer
-                              (void*)0,
-                              batch_timer_callback);
-    
-    if (batch_timer == NULL) {
-        ESP_LOGE(TAG, "Failed to create batch timer");
-        return;
+    // Create one batch timer per channel (but don't start them yet)
+#if CONFIG_DOOR_STATIC_ALLOCATION
+    static StaticTimer_t batch_timer_buffers[MAX_SENSOR_CHANNELS];
+#endif
+    for (int i = 0; i < channel_count; i++) {
+#if CONFIG_DOOR_STATIC_ALLOCATION
+        channels[i].batch_timer = xTimerCreateStatic("BatchTimer",
+                                  pdMS_TO_TICKS(BATCH_TIMEOUT_MS),
+                                  pdFALSE,  // One-shot timer
+                                  (void*)(intptr_t)i,
+                                  batch_timer_callback,
+                                  &batch_timer_buffers[i]);
+#else
+        channels[i].batch_timer = xTimerCreate("BatchTimer", 
+                                  pdMS_TO_TICKS(BATCH_TIMEOUT_MS),
+                                  pdFALSE,  // One-shot timer
+                                  (void*)(intptr_t)i,
+                                  batch_timer_callback);
+#endif
+        
+        if (channels[i].batch_timer == NULL) {
+            ESP_LOGE(TAG, "Failed to create batch timer");
+            return;
+        }
     }
+
+#if CONFIG_DOOR_DEEP_SLEEP
+    resume_batch_timer();
+#endif
     
-    // Initialize WiFi
-    ESP_LOGI(TAG, "Starting WiFi initialization in STA mode...");
-    wifi_init_sta();
-    ESP_LOGI(TAG, "WiFi initialization completed");
-    
-    // Initialize and sync time via NTP
-    if (wifi_connected) {
-        initialize_sntp();
-        wait_for_time_sync();
-    } else {
-        ESP_LOGW(TAG, "WiFi not connected - time sync skipped");
+    // Start the notification delivery task before anything can produce messages
+    if (notifier_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start notification delivery");
+        return;
     }
 
-    // Initialize Bluetooth SPP for phone authentication
-    ESP_LOGI(TAG, "Starting Bluetooth SPP initialization...");
-    init_bluetooth_spp();
+#if CONFIG_DOOR_TRACE_CONSOLE
+    trace_console_start();
+#endif
+
+    // Seed the filters with the initial state before any edges captured during startup
+    sampled_levels = ~initial_levels;
+    feed_levels(initial_levels, initial_edge_us, channel_pin_mask, -1);
+    armed_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Door monitoring armed after %ld ms. Monitoring %d sensor channels for phone %s",
+             (long)(armed_us / 1000), channel_count, PHONE_BT_MAC);
+
+    // Bring up the radios alongside the sensor loop - door changes are held
+    // with their edge timestamps until the clock and presence tracking are ready
+#if CONFIG_DOOR_STATIC_ALLOCATION
+    static StaticEventGroup_t boot_event_group_buffer;
+    boot_event_group = xEventGroupCreateStatic(&boot_event_group_buffer);
+#else
+    boot_event_group = xEventGroupCreate();
+#endif
+    time_sync_start();
+    if (time_sync_quality() != TIME_QUALITY_UNSYNCED) {
+        // Kept through deep sleep by the RTC - no need to wait for NTP
+        boot_time_us = esp_timer_get_time();
+        xEventGroupSetBits(boot_event_group, BOOT_TIME_DONE_BIT);
+    }
+    if (mem_task_create(network_boot_task, "boot_net", BOOT_TASK_STACK_SIZE, NULL, BOOT_TASK_PRIORITY, NULL,
+                        MEM_TASK_BUFFERS(boot_net_stack)) != pdPASS ||
+        mem_task_create(presence_boot_task, "boot_bt", BOOT_TASK_STACK_SIZE, NULL, BOOT_TASK_PRIORITY, NULL,
+                        MEM_TASK_BUFFERS(boot_bt_stack)) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create boot tasks");
+        return;
+    }
+    mem_report_log("arming");
+    mem_report_start_periodic(main_task_handle, MEMORY_REPORT_NOTIFICATION);
 
-    // Print startup message
-    ESP_LOGI(TAG, "Door monitoring system with SPP authentication, NTP sync and event batching started. Monitoring GPIO %d for phone %s", REED_SWITCH_PIN, PHONE_BT_MAC);
-    
     // Main monitoring loop
     while (1) {
-        // Check for batch timer notification (non-blocking)
-        uint32_t notification_value;
-        if (xTaskNotifyWait(0, ULONG_MAX, &notification_value, 0) == pdTRUE) {
-            if (notification_value & BATCH_TIMEOUT_NOTIFICATION) {
-                ESP_LOGI(TAG, "Batch timer expired, processing events");
-                process_accumulated_events();
-            }
+        // Block until an edge arrives, a debounce deadline passes, a presence probe
+        // finishes or the batch timer fires
+        uint32_t notification_value = 0;
+        xTaskNotifyWait(0, ULONG_MAX, &notification_value, sensor_wait_ticks());
+
+        if (notification_value & BOOT_NOTIFICATION) {
+            check_boot_progress();
         }
-        
-        // Process any queued messages if WiFi is connected
-        process_message_queue();
-        
-        // Read the current state of the reed switch
-        int door_state = gpio_get_level(REED_SWITCH_PIN);
-        
-        // Check if the door state has changed
-        if (door_state != current_door_state) {
-            // Update the current state
-            current_door_state = door_state;
-            
-            // Get current time for event
-            time_t now;
-            time(&now);
-            
-            // Perform actions based on door state
-            if (door_state == DOOR_OPEN) {
-                // Door opened
-                ESP_LOGI(TAG, "Door Opened!");
-                blink_led(1);  // Blink LED once
-                
-                // Add to batch processing
-                add_event_to_batch(DOOR_OPEN, now);
-                
-            } else {
-                // Door closed
-                ESP_LOGI(TAG, "Door Closed!");
-                blink_led(2);  // Blink LED twice
-                
-                // Add to batch processing
-                add_event_to_batch(DOOR_CLOSED, now);
+        if (notification_value & MEMORY_REPORT_NOTIFICATION) {
+            mem_report_log("periodic check");
+        }
+
+        if (notification_value & BATCH_TIMEOUT_NOTIFICATION) {
+            for (int i = 0; i < channel_count; i++) {
+                if (channels[i].batch_expired) {
+                    channels[i].batch_expired = false;
+                    ESP_LOGI(TAG, "%s batch timer expired, processing events", channels[i].name);
+                    process_accumulated_events(&channels[i]);
+                }
             }
         }
-        
-        // Small delay to be efficient and prevent excessive polling
-        vTaskDelay(pdMS_TO_TICKS(100));  // 100ms delay
+
+        if (awaiting_auth_count > 0) {
+            flush_awaiting_auth();
+        }
+        flush_held();
+
+        // Drain every edge the ISR captured since the last wake
+        edge_event_t edge;
+        while (edge_ring_pop(&edge_ring, &edge)) {
+            metrics_observe_us(METRIC_STAGE_EDGE, esp_timer_get_time() - edge.timestamp_us);
+            feed_levels(edge.levels, edge.timestamp_us, channel_pin_mask & ~polled_pin_mask, edge.pin);
+        }
+        if (polled_pin_mask != 0) {
+            feed_levels(read_gpio_levels(), esp_timer_get_time(), polled_pin_mask, -1);
+        }
+        poll_door_debounce();
+
+        unsigned dropped = edge_ring_dropped(&edge_ring);
+        if (dropped != edges_dropped_reported) {
+            ESP_LOGW(TAG, "Edge ring overflowed, %u edges dropped so far", dropped);
+            metrics_count(METRIC_EDGES_DROPPED, dropped - edges_dropped_reported);
+            edges_dropped_reported = dropped;
+        }
+
+#if CONFIG_DOOR_DEEP_SLEEP
+        if (ready_for_deep_sleep()) {
+            enter_deep_sleep();
+        }
+#endif
     }
 }
\ No newline at end of file
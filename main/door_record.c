@@ -0,0 +1,142 @@
+#include "door_record.h"
+#include <stdio.h>
+
+// Names for person indices 1..DOOR_RECORD_MAX_PEOPLE, NULL if unnamed
+static const char* person_names[DOOR_RECORD_MAX_PEOPLE + 1];
+
+// Names for sensor channels, NULL if unnamed
+static const char* channel_names[DOOR_RECORD_MAX_CHANNELS];
+
+/**
+ * Format time in 12-hour format with AM/PM
+ */
+void format_time_12h(const struct tm* timeinfo, char* buffer, size_t size) {
+    int hour = timeinfo->tm_hour;
+    const char* ampm = (hour >= 12) ? "PM" : "AM";
+
+    if (hour == 0) hour = 12;       // 12 AM
+    else if (hour > 12) hour -= 12; // PM hours
+
+    snprintf(buffer, size, "%d:%02d %s", hour, timeinfo->tm_min, ampm);
+}
+
+/**
+ * Format a record time, marked "~" when the clock may have drifted and
+ * left out when it was never set
+ */
+static void format_record_time(time_quality_t quality, time_t when, char* buffer, size_t size) {
+    if (quality == TIME_QUALITY_UNSYNCED) {
+        snprintf(buffer, size, "??:??");
+        return;
+    }
+
+    struct tm timeinfo;
+    localtime_r(&when, &timeinfo);
+    char time_str[16];
+    format_time_12h(&timeinfo, time_str, sizeof(time_str));
+    snprintf(buffer, size, "%s%s", quality == TIME_QUALITY_DRIFTING ? "~" : "", time_str);
+}
+
+/**
+ * Name shown for a person index in rendered notifications
+ */
+void door_record_set_person_name(uint8_t person, const char* name) {
+    if (person >= 1 && person <= DOOR_RECORD_MAX_PEOPLE) {
+        person_names[person] = (name != NULL && name[0] != '\0') ? name : NULL;
+    }
+}
+
+/**
+ * Name shown for a sensor channel in rendered notifications
+ */
+void door_record_set_channel_name(uint8_t channel, const char* name) {
+    if (channel < DOOR_RECORD_MAX_CHANNELS) {
+        channel_names[channel] = (name != NULL && name[0] != '\0') ? name : NULL;
+    }
+}
+
+/**
+ * Render the notification text for a record
+ */
+size_t door_record_render(const door_record_t* record, char* buffer, size_t size) {
+    char auth_status[48] = "";
+    if (!(record->flags & DOOR_RECORD_AUTHENTICATED)) {
+        snprintf(auth_status, sizeof(auth_status), " ⚠️ (Unauthenticated)");
+    } else if (record->person <= DOOR_RECORD_MAX_PEOPLE && person_names[record->person] != NULL) {
+        snprintf(auth_status, sizeof(auth_status), " - %s", person_names[record->person]);
+    }
+
+    const char* channel = channel_names[DOOR_RECORD_CHANNEL(record)];
+    if (channel == NULL) {
+        channel = "Door";
+    }
+
+    time_quality_t quality = DOOR_RECORD_TIME_QUALITY(record);
+    time_t when = (time_t)record->timestamp;
+    char time_str[20];
+    format_record_time(quality, when, time_str, sizeof(time_str));
+
+    int len;
+    switch (record->pattern) {
+        case DOOR_PATTERN_OPENED:
+            // Single event - use exclamation emoji for open doors (security concern)
+            len = snprintf(buffer, size, "❗ %s opened at %s%s", channel, time_str, auth_status);
+            break;
+        case DOOR_PATTERN_CLOSED:
+            len = snprintf(buffer, size, "🚪 %s closed at %s%s", channel, time_str, auth_status);
+            break;
+        case DOOR_PATTERN_OPEN_CLOSE:
+            // Valid pair: OPEN -> CLOSE - simplified format
+            len = snprintf(buffer, size, "🚪 %s Open/Close (%s)%s", channel, time_str, auth_status);
+            break;
+        case DOOR_PATTERN_CYCLES: {
+            // Busy door - one line for the whole run
+            char last_str[20];
+            format_record_time(quality, when + record->span_s, last_str, sizeof(last_str));
+            len = snprintf(buffer, size, "🔁 %s: %u open/close cycles %s–%s%s", channel, record->cycles,
+                           time_str, last_str, auth_status);
+            break;
+        }
+        default:
+            // Complex pattern - fallback to count
+            len = snprintf(buffer, size, "⚠️ %s activity: %u events detected%s", channel, record->count, auth_status);
+            break;
+    }
+
+    if (len < 0) {
+        buffer[0] = '\0';
+        return 0;
+    }
+    return ((size_t)len < size) ? (size_t)len : size - 1;
+}
+
+/**
+ * Pack a batch entry into a record
+ */
+door_record_t door_record_from_entry(const batch_entry_t* entry, uint8_t channel, uint8_t person) {
+    uint32_t span_s = entry->last - entry->first;
+    door_record_t record = {
+        .timestamp = entry->first,
+        .flags = (uint8_t)((person != 0 ? DOOR_RECORD_AUTHENTICATED : 0) |
+                           ((entry->time_quality << DOOR_RECORD_TIME_SHIFT) & DOOR_RECORD_TIME_MASK) |
+                           ((channel << DOOR_RECORD_CHANNEL_SHIFT) & DOOR_RECORD_CHANNEL_MASK)),
+        .count = 1,
+        .person = person,
+        .cycles = entry->cycles,
+        .span_s = (uint16_t)(span_s > UINT16_MAX ? UINT16_MAX : span_s),
+    };
+
+    switch (entry->kind) {
+    case BATCH_OPEN:
+        record.pattern = DOOR_PATTERN_OPENED;
+        break;
+    case BATCH_CLOSE:
+        record.pattern = DOOR_PATTERN_CLOSED;
+        break;
+    default:
+        record.pattern = (entry->cycles == 1) ? DOOR_PATTERN_OPEN_CLOSE : DOOR_PATTERN_CYCLES;
+        record.count = (uint8_t)(entry->cycles >= 127 ? 255 : entry->cycles * 2);
+        break;
+    }
+    return record;
+}
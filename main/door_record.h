@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "batcher.h"
+#include "clock_drift.h"
+
+/**
+ * Compact binary door event records.
+ *
+ * Events travel through the delivery queue, the retry backlog and the
+ * flash log as fixed 12-byte records. Notification text is rendered from a
+ * record only when the delivery path builds the HTTP body.
+ */
+
+// What a record describes
+typedef enum {
+    DOOR_PATTERN_OPENED,        // Single OPEN event
+    DOOR_PATTERN_CLOSED,        // Single CLOSE event
+    DOOR_PATTERN_OPEN_CLOSE,    // OPEN -> CLOSE pair
+    DOOR_PATTERN_ACTIVITY,      // Anything else, summarized by count
+    DOOR_PATTERN_CYCLES,        // Run of OPEN -> CLOSE cycles, first to last
+} door_pattern_t;
+
+// Record flags
+#define DOOR_RECORD_AUTHENTICATED 0x01
+#define DOOR_RECORD_TIME_SHIFT    1     // time_quality_t in bits 1-2 - 0 (synced) in older records
+#define DOOR_RECORD_TIME_MASK     0x06
+#define DOOR_RECORD_CHANNEL_SHIFT 4     // Sensor channel in the upper nibble
+#define DOOR_RECORD_CHANNEL_MASK  0xF0
+
+// Sensor channel a record belongs to
+#define DOOR_RECORD_CHANNEL(record) (((record)->flags & DOOR_RECORD_CHANNEL_MASK) >> DOOR_RECORD_CHANNEL_SHIFT)
+
+// How far a record's timestamp can be trusted
+#define DOOR_RECORD_TIME_QUALITY(record) ((time_quality_t)(((record)->flags & DOOR_RECORD_TIME_MASK) >> DOOR_RECORD_TIME_SHIFT))
+
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp;         // Wall clock seconds of the first event
+    uint8_t pattern;            // door_pattern_t
+    uint8_t flags;              // DOOR_RECORD_* bits
+    uint8_t count;              // Number of door events summarized
+    uint8_t person;             // 1-based authorized device that answered, 0 if none
+    uint16_t cycles;            // DOOR_PATTERN_CYCLES: number of cycles
+    uint16_t span_s;            // Seconds from the first to the last event
+} door_record_t;
+
+_Static_assert(sizeof(door_record_t) == 12, "door_record_t must stay packed");
+
+// Highest person index that can carry a name
+#define DOOR_RECORD_MAX_PEOPLE 8
+
+// Sensor channels that can carry a name
+#define DOOR_RECORD_MAX_CHANNELS 16
+
+// Longest rendered notification line, including the terminator
+#define DOOR_RECORD_TEXT_MAX 128
+
+/**
+ * Format time in 12-hour format with AM/PM
+ */
+void format_time_12h(const struct tm* timeinfo, char* buffer, size_t size);
+
+/**
+ * Name shown for a person index in rendered notifications (the string must outlive all records)
+ */
+void door_record_set_person_name(uint8_t person, const char* name);
+
+/**
+ * Name shown for a sensor channel in rendered notifications, "Door" if unnamed
+ * (the string must outlive all records)
+ */
+void door_record_set_channel_name(uint8_t channel, const char* name);
+
+/**
+ * Render the notification text for a record
+ * @return length of the rendered text
+ */
+size_t door_record_render(const door_record_t* record, char* buffer, size_t size);
+
+/**
+ * Pack a batch entry into a record
+ * @param person 1-based authorized device that was identified, 0 if unauthenticated
+ */
+door_record_t door_record_from_entry(const batch_entry_t* entry, uint8_t channel, uint8_t person);
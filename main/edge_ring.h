@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * Single-producer/single-consumer ring of timestamped reed switch edges.
+ *
+ * Each slot holds a snapshot of the GPIO input registers taken at the edge,
+ * so one ISR serves every sensor channel at the same cost and the consumer
+ * works out which pins changed.
+ *
+ * The GPIO ISR is the only producer and the sensor task is the only
+ * consumer, so no locks are needed: each side owns one index and publishes
+ * it with release/acquire ordering. Everything is header-only and free of
+ * ESP-IDF dependencies so the ISR can inline it and it builds on a host.
+ */
+
+// Number of slots - must be a power of two
+#define EDGE_RING_SIZE 64
+
+_Static_assert((EDGE_RING_SIZE & (EDGE_RING_SIZE - 1)) == 0,
+               "EDGE_RING_SIZE must be a power of two");
+
+// Single raw edge as seen by the ISR
+typedef struct {
+    int64_t timestamp_us;   // esp_timer_get_time() at the interrupt
+    uint64_t levels;        // GPIO input levels right after the edge, bit n = GPIO n
+    uint8_t pin;            // GPIO that raised the interrupt
+} edge_event_t;
+
+typedef struct {
+    edge_event_t slots[EDGE_RING_SIZE];
+    atomic_uint head;       // Next slot to read (consumer owned)
+    atomic_uint tail;       // Next slot to write (producer owned)
+    atomic_uint dropped;    // Edges lost because the ring was full
+} edge_ring_t;
+
+/**
+ * Reset the ring to empty
+ */
+static inline void edge_ring_init(edge_ring_t* ring) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+}
+
+/**
+ * Push an edge (producer side, safe to call from an ISR)
+ * @return false if the ring was full and the edge was dropped
+ */
+static inline bool edge_ring_push(edge_ring_t* ring, int64_t timestamp_us, uint64_t levels, int pin) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail - head >= EDGE_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    edge_event_t* slot = &ring->slots[tail & (EDGE_RING_SIZE - 1)];
+    slot->timestamp_us = timestamp_us;
+    slot->levels = levels;
+    slot->pin = (uint8_t)pin;
+
+    // Publish the slot only after it has been fully written
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Pop the oldest edge (consumer side)
+ * @return false if the ring is empty
+ */
+static inline bool edge_ring_pop(edge_ring_t* ring, edge_event_t* out) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *out = ring->slots[head & (EDGE_RING_SIZE - 1)];
+
+    // Hand the slot back to the producer only after it has been copied out
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Number of edges currently waiting in the ring
+ */
+static inline unsigned edge_ring_count(edge_ring_t* ring) {
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) -
+           atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+/**
+ * Total number of edges dropped since init
+ */
+static inline unsigned edge_ring_dropped(edge_ring_t* ring) {
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,544 @@
+#include "event_log.h"
+#include <string.h>
+
+#define SECTOR_MAGIC 0x45564c47u    // "EVLG"
+#define RECORD_ENTRY 0xe7a1
+#define RECORD_ACK   0xe7ac
+#define ERASED_MAGIC 0xffff
+
+// Written once right after a sector is erased
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;            // Increases every time a sector is opened
+    uint32_t next_seq;              // Sequence state carried into this sector
+    uint32_t acked_seq;             // Ack state carried into this sector
+    uint32_t erase_count;           // Wear counter for this sector
+    uint32_t crc;
+} sector_header_t;
+
+typedef struct {
+    uint16_t magic;                 // RECORD_ENTRY or RECORD_ACK
+    uint16_t len;                   // Payload bytes (0 for RECORD_ACK)
+    uint32_t seq;                   // Entry sequence, or acked sequence for RECORD_ACK
+    uint32_t crc;                   // Over magic, len, seq and payload
+} record_header_t;
+
+// Result of scanning one sector
+typedef struct {
+    bool valid;                     // Sector header is intact
+    sector_header_t header;
+    uint32_t end;                   // Offset just past the last valid record
+    bool torn;                      // Garbage after the last valid record
+    uint32_t max_seq;               // Highest entry sequence seen (0 if none)
+    uint32_t max_ack;               // Highest acknowledgement seen
+} sector_scan_t;
+
+// Outcome of reading one record
+typedef enum {
+    READ_OK,
+    READ_END,                       // Erased space or the end of the sector
+    READ_TORN,                      // Not a whole, valid record
+    READ_IO_ERROR,
+} read_result_t;
+
+// Walks the unacknowledged entries of one sector in the order they were written
+typedef struct {
+    uint32_t sector;
+    uint32_t at;                    // Offset of the current entry
+    uint32_t next;                  // Offset of the record after it
+    uint32_t seq;                   // Current entry's sequence, 0 once the sector is exhausted
+} entry_cursor_t;
+
+static uint32_t crc32_update(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t record_size(uint16_t len) {
+    return sizeof(record_header_t) + ((len + 3u) & ~3u);
+}
+
+static uint32_t record_crc(const record_header_t* rec, const void* payload) {
+    uint32_t crc = crc32_update(0, rec, offsetof(record_header_t, crc));
+    return crc32_update(crc, payload, rec->len);
+}
+
+static uint32_t sector_base(const event_log_t* log, uint32_t sector) {
+    return sector * log->flash->sector_size;
+}
+
+/**
+ * Check that everything from offset to the end of the sector is erased
+ */
+static bool sector_tail_erased(const event_log_t* log, uint32_t sector, uint32_t offset) {
+    uint8_t buf[64];
+    while (offset < log->flash->sector_size) {
+        size_t chunk = log->flash->sector_size - offset;
+        if (chunk > sizeof(buf)) {
+            chunk = sizeof(buf);
+        }
+        if (log->flash->read(log->flash->ctx, sector_base(log, sector) + offset, buf, chunk) != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            if (buf[i] != 0xff) {
+                return false;
+            }
+        }
+        offset += chunk;
+    }
+    return true;
+}
+
+/**
+ * Read a sector header and check whether the sector was ever fully opened
+ */
+static int read_sector_header(const event_log_t* log, uint32_t sector, sector_header_t* header, bool* valid) {
+    if (log->flash->read(log->flash->ctx, sector_base(log, sector), header, sizeof(*header)) != 0) {
+        return EVENT_LOG_ERR_IO;
+    }
+    *valid = header->magic == SECTOR_MAGIC &&
+             header->crc == crc32_update(0, header, offsetof(sector_header_t, crc));
+    return EVENT_LOG_OK;
+}
+
+/**
+ * Read the record at offset and check its CRC
+ */
+static read_result_t read_record(const event_log_t* log, uint32_t sector, uint32_t offset,
+                                 record_header_t* rec, uint8_t* payload) {
+    const event_log_flash_t* flash = log->flash;
+    uint32_t base = sector_base(log, sector);
+
+    if (offset + sizeof(record_header_t) > flash->sector_size) {
+        return READ_END;
+    }
+    if (flash->read(flash->ctx, base + offset, rec, sizeof(*rec)) != 0) {
+        return READ_IO_ERROR;
+    }
+    if (rec->magic == ERASED_MAGIC) {
+        return READ_END;
+    }
+
+    bool sane = (rec->magic == RECORD_ENTRY || rec->magic == RECORD_ACK) &&
+                rec->len <= EVENT_LOG_MAX_PAYLOAD &&
+                offset + record_size(rec->len) <= flash->sector_size;
+    if (!sane) {
+        return READ_TORN;
+    }
+    if (flash->read(flash->ctx, base + offset + sizeof(*rec), payload, rec->len) != 0) {
+        return READ_IO_ERROR;
+    }
+    return (record_crc(rec, payload) == rec->crc) ? READ_OK : READ_TORN;
+}
+
+/**
+ * Walk the records of one sector
+ */
+static int scan_sector(const event_log_t* log, uint32_t sector, sector_scan_t* scan) {
+    memset(scan, 0, sizeof(*scan));
+    if (read_sector_header(log, sector, &scan->header, &scan->valid) != EVENT_LOG_OK) {
+        return EVENT_LOG_ERR_IO;
+    }
+    if (!scan->valid) {
+        return EVENT_LOG_OK;
+    }
+    scan->max_ack = scan->header.acked_seq;
+
+    uint32_t offset = sizeof(sector_header_t);
+    uint8_t payload[EVENT_LOG_MAX_PAYLOAD];
+
+    while (1) {
+        record_header_t rec;
+        read_result_t result = read_record(log, sector, offset, &rec, payload);
+        if (result == READ_IO_ERROR) {
+            return EVENT_LOG_ERR_IO;
+        }
+        if (result == READ_TORN) {
+            scan->torn = true;
+        }
+        if (result != READ_OK) {
+            break;
+        }
+
+        if (rec.magic == RECORD_ENTRY) {
+            if (rec.seq > scan->max_seq) {
+                scan->max_seq = rec.seq;
+            }
+        } else if (rec.seq > scan->max_ack) {
+            scan->max_ack = rec.seq;
+        }
+        offset += record_size(rec.len);
+    }
+
+    scan->end = offset;
+
+    // A header-shaped run of 0xff can hide a partially programmed record
+    if (!scan->torn && !sector_tail_erased(log, sector, offset)) {
+        scan->torn = true;
+    }
+    return EVENT_LOG_OK;
+}
+
+/**
+ * Move a cursor to the next unacknowledged entry of its sector
+ */
+static int cursor_advance(const event_log_t* log, entry_cursor_t* cursor) {
+    uint8_t payload[EVENT_LOG_MAX_PAYLOAD];
+    cursor->seq = 0;
+
+    while (1) {
+        record_header_t rec;
+        read_result_t result = read_record(log, cursor->sector, cursor->next, &rec, payload);
+        if (result == READ_IO_ERROR) {
+            return EVENT_LOG_ERR_IO;
+        }
+        if (result != READ_OK) {
+            return EVENT_LOG_OK;
+        }
+
+        cursor->at = cursor->next;
+        cursor->next += record_size(rec.len);
+        if (rec.magic == RECORD_ENTRY && rec.seq > log->acked_seq) {
+            cursor->seq = rec.seq;
+            return EVENT_LOG_OK;
+        }
+    }
+}
+
+/**
+ * Point a cursor at the first unacknowledged entry of a sector
+ */
+static int cursor_open(const event_log_t* log, uint32_t sector, entry_cursor_t* cursor) {
+    sector_header_t header;
+    bool valid;
+    if (read_sector_header(log, sector, &header, &valid) != EVENT_LOG_OK) {
+        return EVENT_LOG_ERR_IO;
+    }
+
+    cursor->sector = sector;
+    cursor->seq = 0;
+    if (!valid) {
+        return EVENT_LOG_OK;
+    }
+    cursor->next = sizeof(sector_header_t);
+    return cursor_advance(log, cursor);
+}
+
+/**
+ * Copy the unacknowledged entries of one sector to another from *offset on,
+ * dropping the oldest if they would not leave room for a record of size reserve
+ */
+static int compact_sector(event_log_t* log, uint32_t from, uint32_t to, uint32_t* offset, uint32_t reserve) {
+    const event_log_flash_t* flash = log->flash;
+    entry_cursor_t cursor;
+    int ret;
+
+    uint32_t live_bytes = 0;
+    for (ret = cursor_open(log, from, &cursor); ret == EVENT_LOG_OK && cursor.seq != 0;
+         ret = cursor_advance(log, &cursor)) {
+        live_bytes += cursor.next - cursor.at;
+    }
+    if (ret != EVENT_LOG_OK) {
+        return ret;
+    }
+
+    uint32_t room = flash->sector_size - *offset - reserve;
+    uint8_t record[sizeof(record_header_t) + EVENT_LOG_MAX_PAYLOAD];
+
+    // Entries within a sector are in sequence order, so copies stay in order too
+    for (ret = cursor_open(log, from, &cursor); ret == EVENT_LOG_OK && cursor.seq != 0;
+         ret = cursor_advance(log, &cursor)) {
+        uint32_t size = cursor.next - cursor.at;
+        if (live_bytes > room) {
+            // Undelivered entries fill the whole region - give up the oldest.
+            // Acks are cumulative, so older copies in other sectors go with it.
+            log->dropped += cursor.seq - log->acked_seq;
+            log->acked_seq = cursor.seq;
+            live_bytes -= size;
+            continue;
+        }
+
+        // Records are copied verbatim, CRC and sequence included
+        if (flash->read(flash->ctx, sector_base(log, from) + cursor.at, record, size) != 0 ||
+            flash->write(flash->ctx, sector_base(log, to) + *offset, record, size) != 0) {
+            return EVENT_LOG_ERR_IO;
+        }
+        *offset += size;
+        log->compacted++;
+    }
+    return ret;
+}
+
+/**
+ * Erase the next sector round-robin, carry the oldest sector's undelivered
+ * entries into it and make it the active one
+ * @param reserve Room to keep free for the record waiting to be written
+ */
+static int open_next_sector(event_log_t* log, uint32_t reserve) {
+    const event_log_flash_t* flash = log->flash;
+    uint32_t next = (log->active_sector + 1) % flash->sector_count;
+    uint32_t oldest = (next + 1) % flash->sector_count;
+
+    // Anything still needed in the next sector was copied forward when the
+    // active one was opened, so it can go
+    sector_header_t old;
+    bool old_valid;
+    if (read_sector_header(log, next, &old, &old_valid) != EVENT_LOG_OK) {
+        return EVENT_LOG_ERR_IO;
+    }
+    if (flash->erase(flash->ctx, sector_base(log, next), flash->sector_size) != 0) {
+        return EVENT_LOG_ERR_IO;
+    }
+    log->erases++;
+
+    uint32_t offset = sizeof(sector_header_t);
+    int ret = compact_sector(log, oldest, next, &offset, reserve);
+    if (ret != EVENT_LOG_OK) {
+        return ret;
+    }
+
+    // Header last - a sector cut off before it is ignored and opened again
+    sector_header_t header = {
+        .magic = SECTOR_MAGIC,
+        .generation = log->generation + 1,
+        .next_seq = log->next_seq,
+        .acked_seq = log->acked_seq,
+        .erase_count = old_valid ? old.erase_count + 1 : 1,
+    };
+    header.crc = crc32_update(0, &header, offsetof(sector_header_t, crc));
+    if (flash->write(flash->ctx, sector_base(log, next), &header, sizeof(header)) != 0) {
+        return EVENT_LOG_ERR_IO;
+    }
+
+    log->active_sector = next;
+    log->generation = header.generation;
+    log->write_offset = offset;
+    log->committed_ack = log->acked_seq;
+    return EVENT_LOG_OK;
+}
+
+/**
+ * Stage one record behind the ones already waiting
+ */
+static void stage_record(event_log_t* log, uint16_t magic, uint32_t seq, const void* payload, uint16_t len) {
+    record_header_t rec = {
+        .magic = magic,
+        .len = len,
+        .seq = seq,
+    };
+    rec.crc = record_crc(&rec, payload);
+
+    uint8_t* dst = log->stage + log->stage_len;
+    memcpy(dst, &rec, sizeof(rec));
+    memcpy(dst + sizeof(rec), payload, len);
+    memset(dst + sizeof(rec) + len, 0xff, record_size(len) - sizeof(rec) - len);
+    log->stage_len += record_size(len);
+}
+
+/**
+ * Scan the flash region and restore the log state, formatting it if empty
+ */
+int event_log_open(event_log_t* log, const event_log_flash_t* flash) {
+    if (flash->sector_count < 2 || flash->sector_count > EVENT_LOG_MAX_SECTORS ||
+        flash->sector_size < sizeof(sector_header_t) + record_size(EVENT_LOG_MAX_PAYLOAD)) {
+        return EVENT_LOG_ERR_SIZE;
+    }
+
+    memset(log, 0, sizeof(*log));
+    log->flash = flash;
+    log->next_seq = 1;
+
+    bool found = false;
+    bool active_torn = false;
+
+    for (uint32_t s = 0; s < flash->sector_count; s++) {
+        sector_scan_t scan;
+        if (scan_sector(log, s, &scan) != EVENT_LOG_OK) {
+            return EVENT_LOG_ERR_IO;
+        }
+        if (!scan.valid) {
+            continue;
+        }
+
+        if (scan.header.next_seq > log->next_seq) {
+            log->next_seq = scan.header.next_seq;
+        }
+        if (scan.max_seq >= log->next_seq) {
+            log->next_seq = scan.max_seq + 1;
+        }
+        if (scan.max_ack > log->acked_seq) {
+            log->acked_seq = scan.max_ack;
+        }
+        if (!found || scan.header.generation > log->generation) {
+            found = true;
+            log->active_sector = s;
+            log->generation = scan.header.generation;
+            log->write_offset = scan.end;
+            active_torn = scan.torn;
+        }
+    }
+    log->committed_ack = log->acked_seq;
+
+    if (!found) {
+        // Blank region - start the log in sector 0
+        log->active_sector = flash->sector_count - 1;
+        return open_next_sector(log, 0);
+    }
+    if (active_torn) {
+        // Never append behind a torn record
+        return open_next_sector(log, 0);
+    }
+    return EVENT_LOG_OK;
+}
+
+/**
+ * Hand every entry that was never acknowledged to cb, in sequence order
+ */
+int event_log_replay(event_log_t* log, event_log_replay_cb_t cb, void* arg) {
+    uint32_t count = log->flash->sector_count;
+    entry_cursor_t cursors[EVENT_LOG_MAX_SECTORS];
+
+    for (uint32_t s = 0; s < count; s++) {
+        if (cursor_open(log, s, &cursors[s]) != EVENT_LOG_OK) {
+            return EVENT_LOG_ERR_IO;
+        }
+    }
+
+    // Each sector is in sequence order but compaction copies older entries
+    // into newer sectors, so merge them
+    uint32_t last = log->acked_seq;
+    uint8_t payload[EVENT_LOG_MAX_PAYLOAD];
+    while (1) {
+        entry_cursor_t* oldest = NULL;
+        for (uint32_t s = 0; s < count; s++) {
+            if (cursors[s].seq != 0 && (oldest == NULL || cursors[s].seq < oldest->seq)) {
+                oldest = &cursors[s];
+            }
+        }
+        if (oldest == NULL) {
+            break;
+        }
+
+        // A copy interrupted before its source was erased shows up twice
+        if (oldest->seq > last) {
+            record_header_t rec;
+            if (read_record(log, oldest->sector, oldest->at, &rec, payload) != READ_OK) {
+                return EVENT_LOG_ERR_IO;
+            }
+            cb(arg, rec.seq, payload, rec.len);
+            last = rec.seq;
+        }
+        if (cursor_advance(log, oldest) != EVENT_LOG_OK) {
+            return EVENT_LOG_ERR_IO;
+        }
+    }
+    return EVENT_LOG_OK;
+}
+
+/**
+ * Stage an entry for the next commit (commits first if the stage is full)
+ */
+int event_log_append(event_log_t* log, const void* payload, size_t len, uint32_t* seq) {
+    if (len > EVENT_LOG_MAX_PAYLOAD) {
+        return EVENT_LOG_ERR_SIZE;
+    }
+
+    // Always leave room for the acknowledgement record written at commit
+    if (log->stage_len + record_size(len) + record_size(0) > EVENT_LOG_STAGE_SIZE) {
+        int ret = event_log_commit(log);
+        if (ret != EVENT_LOG_OK) {
+            return ret;
+        }
+    }
+
+    *seq = log->next_seq++;
+    stage_record(log, RECORD_ENTRY, *seq, payload, (uint16_t)len);
+    log->staged_entries++;
+    return EVENT_LOG_OK;
+}
+
+/**
+ * Mark every entry up to and including seq as delivered
+ */
+void event_log_ack(event_log_t* log, uint32_t seq) {
+    if (seq > log->acked_seq) {
+        log->acked_seq = seq;
+    }
+}
+
+/**
+ * Write all staged entries and the latest acknowledgement to flash
+ */
+int event_log_commit(event_log_t* log) {
+    const event_log_flash_t* flash = log->flash;
+
+    if (log->acked_seq > log->committed_ack) {
+        stage_record(log, RECORD_ACK, log->acked_seq, "", 0);
+    }
+    if (log->stage_len == 0) {
+        return EVENT_LOG_OK;
+    }
+
+    size_t offset = 0;
+    uint32_t full_opens = 0;
+    while (offset < log->stage_len) {
+        // Take as many whole records as fit in the active sector
+        size_t chunk = 0;
+        while (offset + chunk < log->stage_len) {
+            const record_header_t* rec = (const record_header_t*)(log->stage + offset + chunk);
+            uint32_t size = record_size(rec->len);
+            if (log->write_offset + chunk + size > flash->sector_size) {
+                break;
+            }
+            chunk += size;
+        }
+
+        if (chunk == 0) {
+            // A sector can fill up with entries carried forward - go round
+            // until one has room, and only give entries up once every sector
+            // has come back full
+            const record_header_t* rec = (const record_header_t*)(log->stage + offset);
+            uint32_t reserve = (full_opens < flash->sector_count) ? 0 : record_size(rec->len);
+            int ret = open_next_sector(log, reserve);
+            if (ret != EVENT_LOG_OK) {
+                return ret;
+            }
+            full_opens++;
+            continue;
+        }
+        full_opens = 0;
+
+        uint32_t addr = sector_base(log, log->active_sector) + log->write_offset;
+        if (flash->write(flash->ctx, addr, log->stage + offset, chunk) != 0) {
+            // Keep what was not written for the next attempt, but never
+            // append behind a possibly torn write
+            memmove(log->stage, log->stage + offset, log->stage_len - offset);
+            log->stage_len -= offset;
+            open_next_sector(log, 0);
+            return EVENT_LOG_ERR_IO;
+        }
+        log->write_offset += chunk;
+        offset += chunk;
+    }
+
+    log->stage_len = 0;
+    log->staged_entries = 0;
+    log->committed_ack = log->acked_seq;
+    log->commits++;
+    return EVENT_LOG_OK;
+}
+
+/**
+ * Whether there is anything waiting for event_log_commit()
+ */
+bool event_log_dirty(const event_log_t* log) {
+    return log->stage_len > 0 || log->acked_seq > log->committed_ack;
+}
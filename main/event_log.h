@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Append-only write-ahead log for undelivered events.
+ *
+ * The log lives in a raw flash region split into sectors that are used
+ * round-robin. Every record carries a sequence number and a CRC; a record
+ * torn by power loss fails its CRC and is discarded at replay together with
+ * the rest of its sector. Entries and acknowledgements are staged in RAM
+ * and written in one go by event_log_commit(), so several events cost a
+ * single flash write. Delivered entries are acknowledged cumulatively and
+ * their sectors are erased only when the log wraps back onto them.
+ *
+ * Opening a sector compacts the one after it, the oldest: its entries that
+ * are still unacknowledged are copied into the new sector before its
+ * header is written, so by the time the log wraps onto the oldest sector
+ * nothing in it is needed any more. A sector that fills up with copies
+ * is followed by another, and entries are only dropped (counted in
+ * `dropped`) when every sector comes back full of unacknowledged ones -
+ * oldest first, and since acks are cumulative, everything older than the
+ * last one dropped goes with it. A copy can exist twice after a power
+ * cut; replay merges the sectors by sequence number and hands each entry
+ * over once.
+ *
+ * Pure C with no ESP-IDF dependencies - flash access goes through
+ * event_log_flash_t so power loss can be simulated on a host.
+ */
+
+// Return codes
+#define EVENT_LOG_OK           0
+#define EVENT_LOG_ERR_IO      -1   // A flash operation failed
+#define EVENT_LOG_ERR_SIZE    -2   // Payload too large or bad geometry
+
+#define EVENT_LOG_MAX_PAYLOAD 128
+#define EVENT_LOG_STAGE_SIZE  512
+#define EVENT_LOG_MAX_SECTORS 32
+
+// Flash access - every callback returns 0 on success
+typedef struct {
+    int (*read)(void* ctx, uint32_t offset, void* dst, size_t len);
+    int (*write)(void* ctx, uint32_t offset, const void* src, size_t len);
+    int (*erase)(void* ctx, uint32_t offset, size_t len);
+    void* ctx;
+    uint32_t sector_size;
+    uint32_t sector_count;          // 2 to EVENT_LOG_MAX_SECTORS
+} event_log_flash_t;
+
+typedef struct {
+    const event_log_flash_t* flash;
+    uint32_t active_sector;         // Sector currently appended to
+    uint32_t write_offset;          // Next free byte within the active sector
+    uint32_t generation;            // Generation of the active sector
+    uint32_t next_seq;              // Sequence number for the next entry
+    uint32_t acked_seq;             // Every entry up to here is delivered
+    uint32_t committed_ack;         // acked_seq as last written to flash
+    uint8_t stage[EVENT_LOG_STAGE_SIZE];
+    size_t stage_len;               // Bytes of staged records
+    uint32_t staged_entries;        // Entries waiting for the next commit
+    uint32_t dropped;               // Undelivered entries lost to a full log
+    uint32_t compacted;             // Entries copied forward out of the oldest sector
+    uint32_t commits;               // Flash writes issued by event_log_commit()
+    uint32_t erases;                // Sector erases
+} event_log_t;
+
+// Called for each undelivered entry at replay, oldest first
+typedef void (*event_log_replay_cb_t)(void* arg, uint32_t seq, const void* payload, size_t len);
+
+/**
+ * Scan the flash region and restore the log state, formatting it if empty
+ */
+int event_log_open(event_log_t* log, const event_log_flash_t* flash);
+
+/**
+ * Hand every entry that was never acknowledged to cb, in sequence order
+ */
+int event_log_replay(event_log_t* log, event_log_replay_cb_t cb, void* arg);
+
+/**
+ * Stage an entry for the next commit (commits first if the stage is full)
+ * @param seq Set to the sequence number assigned to the entry
+ */
+int event_log_append(event_log_t* log, const void* payload, size_t len, uint32_t* seq);
+
+/**
+ * Mark every entry up to and including seq as delivered
+ */
+void event_log_ack(event_log_t* log, uint32_t seq);
+
+/**
+ * Write all staged entries and the latest acknowledgement to flash
+ */
+int event_log_commit(event_log_t* log);
+
+/**
+ * Whether there is anything waiting for event_log_commit()
+ */
+bool event_log_dirty(const event_log_t* log);
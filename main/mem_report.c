@@ -0,0 +1,159 @@
+#include "mem_report.h"
+#include "freertos/timers.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+
+#define MEM_STACK_SPARE_WARN_BYTES 512  // Flag stacks whose peak came this close to the end
+#define MEM_EXIT_TRACK_WAIT_TICKS 10    // A task can finish before its creator tracked it
+
+static const char* TAG = "MEMORY";
+
+typedef struct {
+    TaskHandle_t task;
+    const char* name;
+    uint32_t stack_size;
+} tracked_task_t;
+
+static tracked_task_t tracked[MEM_REPORT_MAX_TASKS];
+static portMUX_TYPE tracked_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Track a task created elsewhere (the main task)
+ */
+void mem_report_track_task(TaskHandle_t task, uint32_t stack_size) {
+    portENTER_CRITICAL(&tracked_lock);
+    for (int i = 0; i < MEM_REPORT_MAX_TASKS; i++) {
+        if (tracked[i].task == NULL) {
+            tracked[i].task = task;
+            tracked[i].name = pcTaskGetName(task);
+            tracked[i].stack_size = stack_size;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&tracked_lock);
+}
+
+/**
+ * Create a task and track its stack - statically when stack and tcb are given
+ */
+BaseType_t mem_task_create(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                           UBaseType_t priority, TaskHandle_t* handle, StackType_t* stack, StaticTask_t* tcb) {
+    TaskHandle_t task = NULL;
+    if (stack != NULL && tcb != NULL) {
+        task = xTaskCreateStatic(function, name, stack_size, arg, priority, stack, tcb);
+    } else if (xTaskCreate(function, name, stack_size, arg, priority, &task) != pdPASS) {
+        task = NULL;
+    }
+    if (task == NULL) {
+        return pdFAIL;
+    }
+
+    if (handle != NULL) {
+        *handle = task;
+    }
+    mem_report_track_task(task, stack_size);
+    return pdPASS;
+}
+
+/**
+ * Log the calling task's stack peak, stop tracking it and delete it
+ */
+void mem_task_exit(void) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint32_t stack_size = 0;
+
+    for (int wait = 0; stack_size == 0 && wait <= MEM_EXIT_TRACK_WAIT_TICKS; wait++) {
+        if (wait > 0) {
+            vTaskDelay(1);
+        }
+        portENTER_CRITICAL(&tracked_lock);
+        for (int i = 0; i < MEM_REPORT_MAX_TASKS; i++) {
+            if (tracked[i].task == self) {
+                stack_size = tracked[i].stack_size;
+                tracked[i].task = NULL;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&tracked_lock);
+    }
+
+    if (stack_size > 0) {
+        uint32_t spare = uxTaskGetStackHighWaterMark(NULL);
+        ESP_LOGI(TAG, "%s finished: stack %lu, peak %lu, %lu spare", pcTaskGetName(NULL),
+                 (unsigned long)stack_size, (unsigned long)(stack_size - spare), (unsigned long)spare);
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * Log free heap and every tracked task's stack peak
+ */
+void mem_report_log(const char* phase) {
+    ESP_LOGI(TAG, "After %s: heap %lu free, %lu min, %lu largest block, %lu internal", phase,
+             (unsigned long)esp_get_free_heap_size(),
+             (unsigned long)esp_get_minimum_free_heap_size(),
+             (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+             (unsigned long)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+
+    // Copy first - logging inside the critical section is not allowed
+    tracked_task_t tasks[MEM_REPORT_MAX_TASKS];
+    portENTER_CRITICAL(&tracked_lock);
+    for (int i = 0; i < MEM_REPORT_MAX_TASKS; i++) {
+        tasks[i] = tracked[i];
+    }
+    portEXIT_CRITICAL(&tracked_lock);
+
+    for (int i = 0; i < MEM_REPORT_MAX_TASKS; i++) {
+        if (tasks[i].task == NULL) {
+            continue;
+        }
+        // Stack depths and high-water marks are in bytes on ESP-IDF
+        uint32_t spare = uxTaskGetStackHighWaterMark(tasks[i].task);
+        uint32_t peak = tasks[i].stack_size - spare;
+        if (spare < MEM_STACK_SPARE_WARN_BYTES) {
+            ESP_LOGW(TAG, "  %-14s stack %5lu, peak %5lu, %5lu spare - nearly exhausted", tasks[i].name,
+                     (unsigned long)tasks[i].stack_size, (unsigned long)peak, (unsigned long)spare);
+        } else {
+            ESP_LOGI(TAG, "  %-14s stack %5lu, peak %5lu, %5lu spare", tasks[i].name,
+                     (unsigned long)tasks[i].stack_size, (unsigned long)peak, (unsigned long)spare);
+        }
+    }
+}
+
+#if CONFIG_DOOR_MEMORY_REPORT_INTERVAL_S > 0
+static TaskHandle_t report_task = NULL;
+static uint32_t report_bits = 0;
+
+/**
+ * Timer callback - lightweight, the notified task runs the report
+ */
+static void report_timer_callback(TimerHandle_t timer) {
+    if (report_task != NULL) {
+        xTaskNotify(report_task, report_bits, eSetBits);
+    }
+}
+#endif
+
+/**
+ * Notify a task every DOOR_MEMORY_REPORT_INTERVAL_S so it calls mem_report_log()
+ */
+esp_err_t mem_report_start_periodic(TaskHandle_t task, uint32_t notify_bits) {
+#if CONFIG_DOOR_MEMORY_REPORT_INTERVAL_S > 0
+    report_task = task;
+    report_bits = notify_bits;
+
+    TickType_t period = pdMS_TO_TICKS((uint32_t)CONFIG_DOOR_MEMORY_REPORT_INTERVAL_S * 1000);
+#if CONFIG_DOOR_STATIC_ALLOCATION
+    static StaticTimer_t timer_buffer;
+    TimerHandle_t timer = xTimerCreateStatic("MemReport", period, pdTRUE, NULL, report_timer_callback, &timer_buffer);
+#else
+    TimerHandle_t timer = xTimerCreate("MemReport", period, pdTRUE, NULL, report_timer_callback);
+#endif
+    if (timer == NULL || xTimerStart(timer, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start memory report timer");
+        return ESP_FAIL;
+    }
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * Heap and stack high-water report.
+ *
+ * Every app task is created through mem_task_create(), which records its
+ * stack size so mem_report_log() can print how much of each stack has
+ * ever been used next to the current, minimum and largest free heap. The
+ * report runs at the boot phases (armed, Bluetooth up, first delivery)
+ * and then periodically; the peaks are what stack and buffer sizes should
+ * be trimmed or grown to.
+ *
+ * With DOOR_STATIC_ALLOCATION the app's task stacks, timers, queues and
+ * event groups live in static storage instead of the heap, so free heap
+ * only moves with WiFi, Bluetooth and TLS. Declare a task's storage with
+ * MEM_TASK_STACK() and pass MEM_TASK_BUFFERS() to mem_task_create().
+ */
+
+#define MEM_REPORT_MAX_TASKS 12
+
+#if CONFIG_DOOR_STATIC_ALLOCATION
+#define MEM_TASK_STACK(name, size) \
+    static StackType_t name[size]; \
+    static StaticTask_t name##_tcb
+#define MEM_TASK_BUFFERS(name) name, &name##_tcb
+#else
+#define MEM_TASK_STACK(name, size) struct name##_unused
+#define MEM_TASK_BUFFERS(name) NULL, NULL
+#endif
+
+/**
+ * Create a task and track its stack - statically when stack and tcb are given
+ * @return pdPASS on success
+ */
+BaseType_t mem_task_create(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                           UBaseType_t priority, TaskHandle_t* handle, StackType_t* stack, StaticTask_t* tcb);
+
+/**
+ * Track a task created elsewhere (the main task)
+ */
+void mem_report_track_task(TaskHandle_t task, uint32_t stack_size);
+
+/**
+ * Log the calling task's stack peak, stop tracking it and delete it
+ */
+void mem_task_exit(void);
+
+/**
+ * Log free heap and every tracked task's stack peak
+ * @param phase What just happened, e.g. "Bluetooth up"
+ */
+void mem_report_log(const char* phase);
+
+/**
+ * Notify a task every DOOR_MEMORY_REPORT_INTERVAL_S so it calls mem_report_log()
+ */
+esp_err_t mem_report_start_periodic(TaskHandle_t task, uint32_t notify_bits);
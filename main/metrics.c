@@ -0,0 +1,159 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+
+// Upper bounds in microseconds, and as Prometheus "le" labels in seconds
+static const uint32_t bucket_bound_us[METRICS_BUCKETS] = {
+    100, 500, 1000, 5000, 10000, 50000, 100000, 250000,
+    500000, 1000000, 2500000, 5000000, 10000000, 30000000, 60000000, 120000000,
+};
+static const char* const bucket_le[METRICS_BUCKETS] = {
+    "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05", "0.1", "0.25",
+    "0.5", "1", "2.5", "5", "10", "30", "60", "120",
+};
+
+static const char* const stage_names[METRIC_STAGE_COUNT] = {
+    [METRIC_STAGE_EDGE] = "edge",
+    [METRIC_STAGE_DEBOUNCE] = "debounce",
+    [METRIC_STAGE_BATCH] = "batch",
+    [METRIC_STAGE_AUTH_HOLD] = "auth_hold",
+    [METRIC_STAGE_PROBE] = "probe",
+    [METRIC_STAGE_QUEUE] = "queue",
+    [METRIC_STAGE_RENDER] = "render",
+    [METRIC_STAGE_SEND] = "send",
+};
+
+static const struct {
+    const char* name;
+    const char* help;
+} counter_info[METRIC_COUNTER_COUNT] = {
+    [METRIC_QUEUE_REJECTED] = { "tripwire_queue_rejected_total", "Notifications refused by a full delivery queue" },
+    [METRIC_HTTP_STATUS_FAILED] = { "tripwire_http_status_failures_total", "ntfy answers other than 200" },
+    [METRIC_HTTP_ERRORS] = { "tripwire_http_errors_total", "ntfy requests that got no answer" },
+    [METRIC_PROBE_TIMEOUTS] = { "tripwire_probe_timeouts_total", "Presence probes that ran out of time" },
+    [METRIC_PROBE_SKIPPED] = { "tripwire_probe_skipped_total", "Devices a timed out probe round never paged" },
+    [METRIC_WIFI_DISCONNECTS] = { "tripwire_wifi_disconnects_total", "Access point lost while connected" },
+    [METRIC_WIFI_RECONNECTS] = { "tripwire_wifi_reconnects_total", "IP address regained after a disconnect" },
+    [METRIC_EDGES_DROPPED] = { "tripwire_edges_dropped_total", "Reed switch edges lost to a full edge ring" },
+    [METRIC_MQTT_ERRORS] = { "tripwire_mqtt_errors_total", "MQTT connection errors and refused publishes" },
+};
+
+// 32-bit atomics only - 64-bit ones are not lock-free on every target
+typedef struct {
+    atomic_uint buckets[METRICS_BUCKETS + 1];
+    atomic_uint sum_lo;         // Sum of samples in microseconds, low word
+    atomic_uint sum_hi;         // High word, bumped when the low word wraps
+} stage_histogram_t;
+
+static stage_histogram_t histograms[METRIC_STAGE_COUNT];
+static atomic_uint counters[METRIC_COUNTER_COUNT];
+
+/**
+ * Record one latency sample (negative samples count as zero)
+ */
+void metrics_observe_us(metrics_stage_t stage, int64_t latency_us) {
+    if ((unsigned)stage >= METRIC_STAGE_COUNT) {
+        return;
+    }
+    uint32_t sample = (latency_us < 0) ? 0 : (latency_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency_us;
+
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS && sample > bucket_bound_us[bucket]) {
+        bucket++;
+    }
+
+    stage_histogram_t* h = &histograms[stage];
+    atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+    uint32_t before = atomic_fetch_add_explicit(&h->sum_lo, sample, memory_order_relaxed);
+    if ((uint32_t)(before + sample) < before) {
+        atomic_fetch_add_explicit(&h->sum_hi, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * Add to an event counter
+ */
+void metrics_count(metrics_counter_t counter, uint32_t n) {
+    if ((unsigned)counter < METRIC_COUNTER_COUNT) {
+        atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+    }
+}
+
+/**
+ * snprintf at buf + len, keeping len within size
+ */
+static size_t append(char* buf, size_t size, size_t len, const char* fmt, ...) {
+    if (len + 1 >= size) {
+        return len;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buf + len, size - len, fmt, args);
+    va_end(args);
+    if (written < 0) {
+        return len;
+    }
+    return (len + written >= size) ? size - 1 : len + written;
+}
+
+/**
+ * Render one stage's histogram in Prometheus text format - the first stage
+ * also writes the family header
+ */
+size_t metrics_render_stage(metrics_stage_t stage, char* buf, size_t size) {
+    if ((unsigned)stage >= METRIC_STAGE_COUNT || size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    size_t len = 0;
+    if (stage == 0) {
+        len = append(buf, size, len,
+                     "# HELP tripwire_stage_latency_seconds Time spent in each pipeline stage\n"
+                     "# TYPE tripwire_stage_latency_seconds histogram\n");
+    }
+
+    const stage_histogram_t* h = &histograms[stage];
+    const char* name = stage_names[stage];
+    uint32_t cumulative = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        cumulative += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        len = append(buf, size, len, "tripwire_stage_latency_seconds_bucket{stage=\"%s\",le=\"%s\"} %lu\n",
+                     name, bucket_le[i], (unsigned long)cumulative);
+    }
+    cumulative += atomic_load_explicit(&h->buckets[METRICS_BUCKETS], memory_order_relaxed);
+    len = append(buf, size, len, "tripwire_stage_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n",
+                 name, (unsigned long)cumulative);
+
+    // Re-read the high word until it is stable around the low word
+    uint32_t hi, lo;
+    do {
+        hi = atomic_load_explicit(&h->sum_hi, memory_order_relaxed);
+        lo = atomic_load_explicit(&h->sum_lo, memory_order_relaxed);
+    } while (hi != atomic_load_explicit(&h->sum_hi, memory_order_relaxed));
+    uint64_t sum_us = ((uint64_t)hi << 32) | lo;
+
+    len = append(buf, size, len, "tripwire_stage_latency_seconds_sum{stage=\"%s\"} %lu.%06lu\n",
+                 name, (unsigned long)(sum_us / 1000000), (unsigned long)(sum_us % 1000000));
+    // The +Inf bucket stands in for the count so the two always agree
+    len = append(buf, size, len, "tripwire_stage_latency_seconds_count{stage=\"%s\"} %lu\n",
+                 name, (unsigned long)cumulative);
+    return len;
+}
+
+/**
+ * Render all event counters in Prometheus text format
+ */
+size_t metrics_render_counters(char* buf, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    size_t len = 0;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        len = append(buf, size, len, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n",
+                     counter_info[i].name, counter_info[i].help, counter_info[i].name, counter_info[i].name,
+                     (unsigned long)atomic_load_explicit(&counters[i], memory_order_relaxed));
+    }
+    return len;
+}
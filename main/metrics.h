@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Per-stage latency histograms and event counters for the door pipeline.
+ *
+ * Every stage shares one set of fixed bucket bounds, from 100 us to two
+ * minutes. Recording is a handful of relaxed atomic adds on static storage,
+ * so it never locks or allocates and may be called from any task. Readers
+ * render a Prometheus text exposition; the snapshot is not atomic across
+ * buckets, which scrapers tolerate.
+ * Pure C with no ESP-IDF dependencies so it also builds on a host.
+ */
+
+// Pipeline stages with a latency histogram
+typedef enum {
+    METRIC_STAGE_EDGE,          // GPIO interrupt to the sensor task picking up the edge
+    METRIC_STAGE_DEBOUNCE,      // First edge to the committed door state
+    METRIC_STAGE_BATCH,         // First event of a batch entry to its notification being submitted
+    METRIC_STAGE_AUTH_HOLD,     // Notification held back for its presence probe
+    METRIC_STAGE_PROBE,         // One presence probe round
+    METRIC_STAGE_QUEUE,         // Waiting in the delivery queue
+    METRIC_STAGE_RENDER,        // Rendering notification text from a record
+    METRIC_STAGE_SEND,          // One delivery attempt, including a reconnect or PUBACK wait
+    METRIC_STAGE_COUNT,
+} metrics_stage_t;
+
+// Event counters
+typedef enum {
+    METRIC_QUEUE_REJECTED,      // Notifications refused by a full delivery queue
+    METRIC_HTTP_STATUS_FAILED,  // ntfy answered with a status other than 200
+    METRIC_HTTP_ERRORS,         // ntfy request failed without an answer
+    METRIC_PROBE_TIMEOUTS,      // Presence probes that ran out of time
+    METRIC_PROBE_SKIPPED,       // Devices a timed out probe round never got to page
+    METRIC_WIFI_DISCONNECTS,    // Lost the access point after having an IP address
+    METRIC_WIFI_RECONNECTS,     // Got an IP address back after losing it
+    METRIC_EDGES_DROPPED,       // Edges lost to a full edge ring
+    METRIC_MQTT_ERRORS,         // MQTT connection errors and refused publishes
+    METRIC_COUNTER_COUNT,
+} metrics_counter_t;
+
+// Finite histogram buckets - one more catches everything above the last bound
+#define METRICS_BUCKETS 16
+
+/**
+ * Record one latency sample (negative samples count as zero)
+ */
+void metrics_observe_us(metrics_stage_t stage, int64_t latency_us);
+
+/**
+ * Add to an event counter
+ */
+void metrics_count(metrics_counter_t counter, uint32_t n);
+
+/**
+ * Render one stage's histogram in Prometheus text format
+ * @return length written, truncated to fit size
+ */
+size_t metrics_render_stage(metrics_stage_t stage, char* buf, size_t size);
+
+/**
+ * Render all event counters in Prometheus text format
+ * @return length written, truncated to fit size
+ */
+size_t metrics_render_counters(char* buf, size_t size);
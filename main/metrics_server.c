@@ -0,0 +1,168 @@
+#include "metrics_server.h"
+#include "sdkconfig.h"
+
+#if CONFIG_DOOR_METRICS
+
+#include "metrics.h"
+#include "notifier.h"
+#include "trace.h"
+#include <stdio.h>
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_log.h"
+
+#define METRICS_CHUNK_SIZE 2048     // Fits one stage histogram or all counters
+#define TRACE_CHUNK_WORDS 64
+
+static const char* TAG = "METRICS";
+
+static httpd_handle_t server = NULL;
+
+// Only the server task touches this, and it handles one request at a time
+static char chunk[METRICS_CHUNK_SIZE];
+
+/**
+ * Send one rendered chunk, skipping empty ones (an empty chunk ends the response)
+ */
+static esp_err_t send_chunk(httpd_req_t* req, size_t len) {
+    return (len > 0) ? httpd_resp_send_chunk(req, chunk, len) : ESP_OK;
+}
+
+/**
+ * Render delivery totals and device gauges
+ */
+static size_t render_device(char* buf, size_t size) {
+    notify_stats_t stats;
+    notifier_get_stats(&stats);
+
+    int len = snprintf(buf, size,
+                       "# HELP tripwire_notifications_submitted_total Notifications accepted for delivery\n"
+                       "# TYPE tripwire_notifications_submitted_total counter\n"
+                       "tripwire_notifications_submitted_total %lu\n"
+                       "# HELP tripwire_notifications_delivered_total Notifications confirmed by the server\n"
+                       "# TYPE tripwire_notifications_delivered_total counter\n"
+                       "tripwire_notifications_delivered_total %lu\n"
+                       "# HELP tripwire_notifications_failed_attempts_total Sends that failed and will be retried\n"
+                       "# TYPE tripwire_notifications_failed_attempts_total counter\n"
+                       "tripwire_notifications_failed_attempts_total %lu\n"
+                       "# HELP tripwire_notifications_dropped_total Notifications evicted from a full retry backlog\n"
+                       "# TYPE tripwire_notifications_dropped_total counter\n"
+                       "tripwire_notifications_dropped_total %lu\n"
+                       "# HELP tripwire_send_latency_seconds Per-message delivery latency, by connection reuse\n"
+                       "# TYPE tripwire_send_latency_seconds summary\n"
+                       "tripwire_send_latency_seconds_sum{reused=\"1\"} %lu.%03lu\n"
+                       "tripwire_send_latency_seconds_count{reused=\"1\"} %lu\n"
+                       "tripwire_send_latency_seconds_sum{reused=\"0\"} %lu.%03lu\n"
+                       "tripwire_send_latency_seconds_count{reused=\"0\"} %lu\n"
+                       "# HELP tripwire_notifications_pending Notifications waiting in the delivery queue\n"
+                       "# TYPE tripwire_notifications_pending gauge\n"
+                       "tripwire_notifications_pending %lu\n"
+                       "# HELP tripwire_notifications_backlog Notifications waiting in the retry backlog\n"
+                       "# TYPE tripwire_notifications_backlog gauge\n"
+                       "tripwire_notifications_backlog %lu\n"
+                       "# HELP tripwire_uptime_seconds Time since boot\n"
+                       "# TYPE tripwire_uptime_seconds gauge\n"
+                       "tripwire_uptime_seconds %lu\n"
+                       "# HELP tripwire_free_heap_bytes Free heap\n"
+                       "# TYPE tripwire_free_heap_bytes gauge\n"
+                       "tripwire_free_heap_bytes %lu\n"
+                       "# HELP tripwire_min_free_heap_bytes Lowest free heap since boot\n"
+                       "# TYPE tripwire_min_free_heap_bytes gauge\n"
+                       "tripwire_min_free_heap_bytes %lu\n",
+                       (unsigned long)stats.submitted, (unsigned long)stats.delivered,
+                       (unsigned long)stats.failed_attempts, (unsigned long)stats.dropped,
+                       (unsigned long)(stats.latency_reused_ms / 1000), (unsigned long)(stats.latency_reused_ms % 1000),
+                       (unsigned long)stats.sent_reused,
+                       (unsigned long)(stats.latency_fresh_ms / 1000), (unsigned long)(stats.latency_fresh_ms % 1000),
+                       (unsigned long)stats.sent_fresh,
+                       (unsigned long)stats.pending, (unsigned long)stats.backlog,
+                       (unsigned long)(esp_timer_get_time() / 1000000),
+                       (unsigned long)esp_get_free_heap_size(),
+                       (unsigned long)esp_get_minimum_free_heap_size());
+    if (len < 0) {
+        return 0;
+    }
+    return ((size_t)len >= size) ? size - 1 : (size_t)len;
+}
+
+/**
+ * GET /metrics
+ */
+static esp_err_t metrics_get_handler(httpd_req_t* req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+        if (send_chunk(req, metrics_render_stage(stage, chunk, sizeof(chunk))) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    if (send_chunk(req, metrics_render_counters(chunk, sizeof(chunk))) != ESP_OK ||
+        send_chunk(req, render_device(chunk, sizeof(chunk))) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+#if CONFIG_DOOR_TRACE
+/**
+ * GET /trace - the raw binary trace ring, decoded on the host by host/trace_decode
+ */
+static esp_err_t trace_get_handler(httpd_req_t* req) {
+    httpd_resp_set_type(req, "application/octet-stream");
+
+    trace_cursor_t dump;
+    uint32_t words[TRACE_CHUNK_WORDS];
+    trace_dump_begin(&dump, words);
+    size_t count = TRACE_DUMP_HEADER_WORDS;
+    do {
+        if (httpd_resp_send_chunk(req, (const char*)words, count * sizeof(uint32_t)) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        count = trace_dump_next(&dump, words, TRACE_CHUNK_WORDS);
+    } while (count > 0);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+/**
+ * Start the HTTP server (once WiFi is up)
+ */
+esp_err_t metrics_server_start(void) {
+    if (server != NULL) {
+        return ESP_OK;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_DOOR_METRICS_PORT;
+    config.max_open_sockets = 2;
+    config.max_uri_handlers = 2;
+    config.lru_purge_enable = true;
+
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start metrics server: %s", esp_err_to_name(err));
+        server = NULL;
+        return err;
+    }
+
+    static const httpd_uri_t metrics_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_get_handler,
+    };
+    httpd_register_uri_handler(server, &metrics_uri);
+#if CONFIG_DOOR_TRACE
+    static const httpd_uri_t trace_uri = {
+        .uri = "/trace",
+        .method = HTTP_GET,
+        .handler = trace_get_handler,
+    };
+    httpd_register_uri_handler(server, &trace_uri);
+#endif
+
+    ESP_LOGI(TAG, "Serving metrics on port %d at /metrics", CONFIG_DOOR_METRICS_PORT);
+    return ESP_OK;
+}
+
+#endif // CONFIG_DOOR_METRICS
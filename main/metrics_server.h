@@ -0,0 +1,18 @@
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * Prometheus scrape endpoint.
+ *
+ * Serves GET /metrics on CONFIG_DOOR_METRICS_PORT with the stage latency
+ * histograms and counters from metrics.h, plus delivery totals from the
+ * notifier. The response is streamed in chunks from one small static
+ * buffer, so a scrape costs no heap beyond the HTTP server itself.
+ * With DOOR_TRACE, GET /trace also returns the binary trace log (trace.h).
+ */
+
+/**
+ * Start the HTTP server (once WiFi is up)
+ */
+esp_err_t metrics_server_start(void);
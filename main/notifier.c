@@ -0,0 +1,492 @@
+#include "notifier.h"
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "status_led.h"
+#include "delivery.h"
+#include "metrics.h"
+#include "trace.h"
+#include "mem_report.h"
+#include "notifier_transport.h"
+#if CONFIG_DOOR_EVENT_LOG
+#include "esp_partition.h"
+#include "event_log.h"
+#endif
+
+// Delivery task Configuration
+#define NOTIFIER_TASK_STACK_SIZE 8192
+#define NOTIFIER_TASK_PRIORITY 4
+
+MEM_TASK_STACK(notifier_stack, NOTIFIER_TASK_STACK_SIZE);
+
+// Flash partition holding the write-ahead log (see partitions.csv)
+#define EVENT_LOG_PARTITION_LABEL "eventlog"
+
+static const char* TAG = "NOTIFIER";
+
+// Submit queue item - the submit time measures how long records wait for the delivery task
+typedef struct {
+    door_record_t record;
+    int64_t submitted_us;
+} queued_record_t;
+
+static QueueHandle_t notify_queue = NULL;
+static volatile bool network_online = false;
+static bool first_delivery_reported = false;    // Memory report after the first successful send done
+
+_Static_assert(NOTIFY_TRANSPORT_WINDOW <= DELIVERY_WINDOW_MAX, "transport window exceeds DELIVERY_WINDOW_MAX");
+
+// Delivery decisions and the retry backlog - only touched by the delivery task
+static delivery_t delivery;
+
+#if CONFIG_DOOR_NTFY_COALESCE_BACKLOG
+// Body for a coalesced backlog flush - static to keep it off the task stack
+static char flush_body[CONFIG_DOOR_NTFY_FLUSH_MAX_BYTES + 1];
+#define SEND_WINDOW 1
+#else
+#define SEND_WINDOW NOTIFY_TRANSPORT_WINDOW
+#endif
+
+// Bodies for one send of one message per record
+static char message_bodies[SEND_WINDOW][DOOR_RECORD_TEXT_MAX];
+
+#if CONFIG_DOOR_EVENT_LOG
+// Write-ahead log mirroring the retry backlog - only touched by the delivery task
+static event_log_flash_t log_flash;
+static event_log_t event_log;
+static bool event_log_ready = false;
+static TickType_t log_dirty_since = 0;
+#endif
+
+// Delivery state, guarded by stats_lock
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static notify_stats_t stats = { .state = NOTIFY_STATE_IDLE };
+
+/**
+ * Record a delivery state transition
+ */
+static void set_state(notify_state_t state) {
+    portENTER_CRITICAL(&stats_lock);
+    bool changed = stats.state != state;
+    stats.state = state;
+    stats.backlog = delivery.backlog.count;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (changed) {
+        ESP_LOGD(TAG, "Delivery state: %s (backlog: %d)", notifier_state_name(state), delivery.backlog.count);
+    }
+}
+
+/**
+ * Hand messages to the transport and account for the outcome
+ * @return How many messages from the start were confirmed
+ */
+static int deliver(const notify_message_t* messages, int count) {
+    if (!network_online) {
+        ESP_LOGW(TAG, "Cannot send notification - WiFi not connected");
+        return 0;
+    }
+
+    TRACE(NOTIFY_SEND, strlen(messages[0].text), delivery.backlog.count);
+    set_state(NOTIFY_STATE_IN_FLIGHT);
+
+    notify_send_info_t info = { 0 };
+    int64_t send_start_us = esp_timer_get_time();
+    int confirmed = notify_transport_send(messages, count, &info);
+    metrics_observe_us(METRIC_STAGE_SEND, esp_timer_get_time() - send_start_us);
+
+    if (confirmed > 0 && !first_delivery_reported) {
+        // TLS and transport buffers are at their largest now - see what is left
+        first_delivery_reported = true;
+        mem_report_log("first delivery");
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.delivered += confirmed;
+    if (info.reused) {
+        stats.sent_reused += confirmed;
+        stats.latency_reused_ms += (uint64_t)info.latency_ms * confirmed;
+    } else {
+        stats.sent_fresh += confirmed;
+        stats.latency_fresh_ms += (uint64_t)info.latency_ms * confirmed;
+    }
+    if (confirmed < count) {
+        stats.failed_attempts++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    return confirmed;
+}
+
+#if CONFIG_DOOR_EVENT_LOG
+static int log_flash_read(void* ctx, uint32_t offset, void* dst, size_t len) {
+    return esp_partition_read(ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int log_flash_write(void* ctx, uint32_t offset, const void* src, size_t len) {
+    return esp_partition_write(ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int log_flash_erase(void* ctx, uint32_t offset, size_t len) {
+    return esp_partition_erase_range(ctx, offset, len) == ESP_OK ? 0 : -1;
+}
+
+/**
+ * Note that the log is about to change, starting the commit delay if it was clean
+ */
+static void log_touch(void) {
+    if (!event_log_dirty(&event_log)) {
+        log_dirty_since = xTaskGetTickCount();
+    }
+}
+
+/**
+ * Commit staged log records once the batch is full or the commit delay has passed
+ */
+static void log_sync(void) {
+    if (!event_log_ready || !event_log_dirty(&event_log)) {
+        return;
+    }
+
+    bool batch_full = event_log.staged_entries >= CONFIG_DOOR_EVENT_LOG_COMMIT_BATCH;
+    bool delay_passed = (xTaskGetTickCount() - log_dirty_since) >= pdMS_TO_TICKS(CONFIG_DOOR_EVENT_LOG_COMMIT_MS);
+#if CONFIG_DOOR_DEEP_SLEEP
+    // The device sleeps as soon as the submit queue drains, so don't hold records back
+    bool drained = uxQueueMessagesWaiting(notify_queue) == 0;
+#else
+    bool drained = false;
+#endif
+    if (!batch_full && !delay_passed && !drained) {
+        return;
+    }
+
+    uint32_t dropped = event_log.dropped;
+    int ret = event_log_commit(&event_log);
+    if (ret != EVENT_LOG_OK) {
+        ESP_LOGE(TAG, "Event log commit failed: %d", ret);
+    } else {
+        ESP_LOGD(TAG, "Event log committed (seq %lu, acked %lu, %lu erases, %lu copied forward)",
+                 (unsigned long)event_log.next_seq - 1, (unsigned long)event_log.acked_seq,
+                 (unsigned long)event_log.erases, (unsigned long)event_log.compacted);
+    }
+    if (event_log.dropped != dropped) {
+        ESP_LOGW(TAG, "Event log full - %lu oldest undelivered entries no longer kept in flash",
+                 (unsigned long)(event_log.dropped - dropped));
+    }
+}
+
+/**
+ * Shorten a wait so a pending log commit is not delayed past its deadline
+ */
+static TickType_t log_wait_ticks(TickType_t wait_ticks) {
+    if (!event_log_ready || !event_log_dirty(&event_log)) {
+        return wait_ticks;
+    }
+
+    TickType_t elapsed = xTaskGetTickCount() - log_dirty_since;
+    TickType_t delay = pdMS_TO_TICKS(CONFIG_DOOR_EVENT_LOG_COMMIT_MS);
+    TickType_t remaining = (elapsed < delay) ? delay - elapsed : 0;
+    return (remaining < wait_ticks) ? remaining : wait_ticks;
+}
+
+/**
+ * Stage a backlog record in the log so it survives a reboot
+ */
+static void log_persist(backlog_entry_t* entry) {
+    if (!event_log_ready) {
+        return;
+    }
+
+    log_touch();
+    if (event_log_append(&event_log, &entry->record, sizeof(entry->record), &entry->log_seq) != EVENT_LOG_OK) {
+        ESP_LOGE(TAG, "Failed to append to event log");
+        entry->log_seq = 0;
+    }
+}
+
+/**
+ * Record that every logged message up to seq is delivered or abandoned
+ */
+static void log_ack(uint32_t seq) {
+    if (event_log_ready && seq > event_log.acked_seq) {
+        log_touch();
+        event_log_ack(&event_log, seq);
+    }
+}
+#else
+static void log_sync(void) {}
+static TickType_t log_wait_ticks(TickType_t wait_ticks) { return wait_ticks; }
+static void log_persist(backlog_entry_t* entry) {}
+static void log_ack(uint32_t seq) {}
+#endif
+
+/**
+ * A record went into the retry backlog - mirror it to the write-ahead log
+ */
+static void backlog_stored(void* ctx, backlog_entry_t* entry) {
+    log_persist(entry);
+
+    TRACE(NTFY_BACKLOG_PUSH, delivery.backlog.count);
+    status_led_request(LED_PATTERN_QUEUE_BACKLOG);
+}
+
+/**
+ * A record was delivered - it no longer needs replaying after a reset
+ */
+static void backlog_delivered(void* ctx, const backlog_entry_t* entry) {
+    log_ack(entry->log_seq);
+}
+
+/**
+ * The backlog was full and gave up its oldest record
+ */
+static void backlog_evicted(void* ctx, const backlog_entry_t* entry) {
+    ESP_LOGW(TAG, "Message queue full, dropping oldest message");
+    log_ack(entry->log_seq);
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.dropped++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+#if CONFIG_DOOR_EVENT_LOG
+/**
+ * Replay callback - put a record that never got delivered back in the backlog
+ */
+static void log_replay_cb(void* arg, uint32_t seq, const void* payload, size_t len) {
+    // Entries written by older firmware held pre-rendered text - skip them
+    if (len != sizeof(door_record_t)) {
+        return;
+    }
+
+    backlog_entry_t entry = { .log_seq = seq };
+    memcpy(&entry.record, payload, sizeof(entry.record));
+
+    delivery_restore(&delivery, &entry);
+    (*(uint32_t*)arg)++;
+}
+
+/**
+ * Open the write-ahead log and restore records left over from before a reset
+ */
+static void event_log_init(void) {
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY,
+                                                                EVENT_LOG_PARTITION_LABEL);
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition - queued notifications will not survive a reset",
+                 EVENT_LOG_PARTITION_LABEL);
+        return;
+    }
+
+    log_flash = (event_log_flash_t) {
+        .read = log_flash_read,
+        .write = log_flash_write,
+        .erase = log_flash_erase,
+        .ctx = (void*)partition,
+        .sector_size = partition->erase_size,
+        .sector_count = partition->size / partition->erase_size,
+    };
+
+    int ret = event_log_open(&event_log, &log_flash);
+    if (ret != EVENT_LOG_OK) {
+        ESP_LOGE(TAG, "Failed to open event log: %d", ret);
+        return;
+    }
+
+    uint32_t restored = 0;
+    if (event_log_replay(&event_log, log_replay_cb, &restored) != EVENT_LOG_OK) {
+        ESP_LOGE(TAG, "Event log replay failed");
+    }
+    event_log_ready = true;
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.restored = restored;
+    portEXIT_CRITICAL(&stats_lock);
+
+    ESP_LOGI(TAG, "Event log ready: %lu undelivered records restored (next seq %lu)",
+             (unsigned long)restored, (unsigned long)event_log.next_seq);
+}
+#endif
+
+/**
+ * Render and send what the delivery plan picked
+ * @param render_start_us When picking the send began - a coalesced body is rendered by then
+ * @return How many messages from the start were confirmed
+ */
+static int send_planned(const delivery_send_t* send, int64_t render_start_us) {
+    notify_message_t messages[SEND_WINDOW];
+    if (send->body != NULL) {
+        messages[0] = (notify_message_t) { .text = send->body, .record = NULL };
+    } else {
+        for (int i = 0; i < send->count; i++) {
+            const door_record_t* record = &send->entries[i]->record;
+            door_record_render(record, message_bodies[i], sizeof(message_bodies[i]));
+            messages[i] = (notify_message_t) { .text = message_bodies[i], .record = record };
+        }
+    }
+    metrics_observe_us(METRIC_STAGE_RENDER, esp_timer_get_time() - render_start_us);
+
+    if (send->from_backlog) {
+        ESP_LOGI(TAG, "Sending %d of %d queued messages via %s", delivery.packed, delivery.backlog.count,
+                 NOTIFY_TRANSPORT_NAME);
+    }
+    int confirmed = deliver(messages, send->count);
+
+    if (!send->from_backlog) {
+        if (confirmed == 1) {
+            ESP_LOGI(TAG, "Notification sent immediately via %s", NOTIFY_TRANSPORT_NAME);
+        }
+    } else if (confirmed < send->count) {
+        ESP_LOGW(TAG, "Failed to send queued notification, will retry later (%d sent)", confirmed);
+    } else {
+        ESP_LOGI(TAG, "%d queued notification(s) sent successfully via %s", delivery.packed, NOTIFY_TRANSPORT_NAME);
+    }
+    return confirmed;
+}
+
+/**
+ * Delivery task - the only place that waits on network I/O
+ */
+static void notifier_task(void* arg) {
+    while (1) {
+        set_state(delivery.backlog.count > 0 ? NOTIFY_STATE_RETRYING : NOTIFY_STATE_IDLE);
+        log_sync();
+
+        // Sleep until a new message arrives, it is time to retry the backlog or a log commit is due
+        uint32_t wait_ms = delivery_wait_ms(&delivery);
+        TickType_t wait_ticks = (wait_ms == DELIVERY_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+        wait_ticks = log_wait_ticks(wait_ticks);
+        queued_record_t queued;
+        if (xQueueReceive(notify_queue, &queued, wait_ticks) == pdTRUE) {
+            metrics_observe_us(METRIC_STAGE_QUEUE, esp_timer_get_time() - queued.submitted_us);
+            backlog_entry_t entry = { .record = queued.record, .log_seq = 0 };
+            delivery_receive(&delivery, &entry);
+        } else {
+            delivery_wake(&delivery);
+        }
+
+        // Send until the backlog is empty or a send fails
+        while (1) {
+            int64_t render_start_us = esp_timer_get_time();
+            delivery_send_t send;
+            if (!delivery_next(&delivery, network_online, &send)) {
+                break;
+            }
+            int confirmed = send_planned(&send, render_start_us);
+            if (!delivery_sent(&delivery, confirmed, network_online)) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(NOTIFY_TRANSPORT_SEND_GAP_MS));
+        }
+    }
+}
+
+/**
+ * Create the submit queue and start the delivery task
+ */
+esp_err_t notifier_start(void) {
+    esp_err_t err = notify_transport_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up %s delivery: %s", NOTIFY_TRANSPORT_NAME, esp_err_to_name(err));
+        return err;
+    }
+
+    static const delivery_hooks_t hooks = {
+        .stored = backlog_stored,
+        .delivered = backlog_delivered,
+        .evicted = backlog_evicted,
+    };
+#if CONFIG_DOOR_NTFY_COALESCE_BACKLOG
+    delivery_init(&delivery, SEND_WINDOW, flush_body, CONFIG_DOOR_NTFY_FLUSH_MAX_BYTES, &hooks);
+#else
+    delivery_init(&delivery, SEND_WINDOW, NULL, 0, &hooks);
+#endif
+
+#if CONFIG_DOOR_EVENT_LOG
+    event_log_init();
+#endif
+
+#if CONFIG_DOOR_STATIC_ALLOCATION
+    static StaticQueue_t notify_queue_buffer;
+    static uint8_t notify_queue_storage[CONFIG_DOOR_NOTIFY_QUEUE_LEN * sizeof(queued_record_t)];
+    notify_queue = xQueueCreateStatic(CONFIG_DOOR_NOTIFY_QUEUE_LEN, sizeof(queued_record_t),
+                                      notify_queue_storage, &notify_queue_buffer);
+#else
+    notify_queue = xQueueCreate(CONFIG_DOOR_NOTIFY_QUEUE_LEN, sizeof(queued_record_t));
+#endif
+    if (notify_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create notification queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (mem_task_create(notifier_task, "notifier", NOTIFIER_TASK_STACK_SIZE, NULL,
+                        NOTIFIER_TASK_PRIORITY, NULL, MEM_TASK_BUFFERS(notifier_stack)) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create notifier task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Hand a door record to the delivery task without blocking
+ */
+bool notifier_submit(const door_record_t* record) {
+    queued_record_t queued = { .record = *record, .submitted_us = esp_timer_get_time() };
+    bool accepted = notify_queue != NULL && xQueueSend(notify_queue, &queued, 0) == pdTRUE;
+
+    portENTER_CRITICAL(&stats_lock);
+    if (accepted) {
+        stats.submitted++;
+    } else {
+        stats.rejected++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (!accepted) {
+        metrics_count(METRIC_QUEUE_REJECTED, 1);
+    }
+
+    return accepted;
+}
+
+/**
+ * Tell the delivery task whether the network is usable
+ */
+void notifier_set_online(bool online) {
+    notify_transport_set_online(online);
+    network_online = online;
+}
+
+/**
+ * Copy the current delivery state and counters
+ */
+void notifier_get_stats(notify_stats_t* out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+    out->pending = (notify_queue != NULL) ? uxQueueMessagesWaiting(notify_queue) : 0;
+#if CONFIG_DOOR_EVENT_LOG
+    // Racy read of delivery task state, only used as a hint before sleeping
+    out->log_dirty = event_log_ready && event_log_dirty(&event_log);
+#endif
+}
+
+/**
+ * Human readable name for a delivery state
+ */
+const char* notifier_state_name(notify_state_t state) {
+    switch (state) {
+        case NOTIFY_STATE_IDLE:
+            return "idle";
+        case NOTIFY_STATE_IN_FLIGHT:
+            return "in-flight";
+        case NOTIFY_STATE_RETRYING:
+            return "retrying";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "door_record.h"
+#include "backlog.h"
+
+/**
+ * Asynchronous notification delivery.
+ *
+ * Producers hand compact door records to a bounded FreeRTOS queue and
+ * return immediately. Notification text is rendered only when a request
+ * body is built. A dedicated delivery task owns all network I/O: it sends
+ * each message through the configured transport (ntfy.sh over a keep-alive
+ * HTTPS connection, or MQTT over a persistent session - see
+ * notifier_transport.h) and keeps failed ones in a retry backlog until
+ * WiFi is back. The backlog is
+ * mirrored to a flash write-ahead log so it survives resets and brownouts.
+ */
+
+// What the delivery task is doing right now
+typedef enum {
+    NOTIFY_STATE_IDLE,          // Nothing to send
+    NOTIFY_STATE_IN_FLIGHT,     // A request is on the wire
+    NOTIFY_STATE_RETRYING,      // Backlog waiting for WiFi or a retry delay
+} notify_state_t;
+
+// Snapshot of delivery progress
+typedef struct {
+    notify_state_t state;
+    uint32_t submitted;         // Accepted by notifier_submit()
+    uint32_t rejected;          // Refused by notifier_submit() - queue full
+    uint32_t delivered;         // Confirmed by the server or broker
+    uint32_t failed_attempts;   // Sends that failed and will be retried
+    uint32_t dropped;           // Evicted from a full retry backlog
+    uint32_t pending;           // Waiting in the submit queue
+    uint32_t backlog;           // Waiting in the retry backlog
+    uint32_t restored;          // Undelivered records replayed from flash at boot
+    uint32_t sent_reused;       // Delivered over an already open connection
+    uint32_t sent_fresh;        // Delivered on a newly opened connection
+    uint64_t latency_reused_ms; // Sum of per-message latency over sent_reused
+    uint64_t latency_fresh_ms;  // Sum of per-message latency over sent_fresh
+    bool log_dirty;             // Backlog changes not yet written to flash
+} notify_stats_t;
+
+/**
+ * Create the submit queue and start the delivery task
+ */
+esp_err_t notifier_start(void);
+
+/**
+ * Hand a door record to the delivery task without blocking
+ * @return false if the submit queue is full (backpressure)
+ */
+bool notifier_submit(const door_record_t* record);
+
+/**
+ * Tell the delivery task whether the network is usable
+ */
+void notifier_set_online(bool online);
+
+/**
+ * Copy the current delivery state and counters
+ */
+void notifier_get_stats(notify_stats_t* stats);
+
+/**
+ * Human readable name for a delivery state
+ */
+const char* notifier_state_name(notify_state_t state);
@@ -0,0 +1,275 @@
+#include "notifier_transport.h"
+
+#if CONFIG_DOOR_NOTIFY_TRANSPORT_MQTT
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_crt_bundle.h"
+#include "mqtt_client.h"
+#include "metrics.h"
+#include "trace.h"
+
+// MQTT Configuration (from Kconfig)
+#define MQTT_BROKER_URI CONFIG_DOOR_MQTT_BROKER_URI
+#define MQTT_USERNAME CONFIG_DOOR_MQTT_USERNAME
+#define MQTT_PASSWORD CONFIG_DOOR_MQTT_PASSWORD
+#define MQTT_TOPIC_PREFIX CONFIG_DOOR_MQTT_TOPIC
+#define MQTT_KEEPALIVE_S CONFIG_DOOR_MQTT_KEEPALIVE_S
+
+#define MQTT_QOS 1                      // At least once - the broker acknowledges every publish
+#define MQTT_CONNECT_WAIT_MS 5000       // How long a send waits for the broker connection
+#define MQTT_ACK_TIMEOUT_MS 10000       // How long a send waits for its PUBACKs
+#define MQTT_RECONNECT_MS 5000
+#define MQTT_TOPIC_MAX 64
+#define MQTT_ACK_HISTORY 16             // Recent PUBACKs remembered - more than a window plus state updates
+
+#define MQTT_STATUS_ONLINE "online"
+#define MQTT_STATUS_OFFLINE "offline"
+
+// Event group bits
+#define MQTT_CONNECTED_BIT BIT0
+#define MQTT_ACK_BIT       BIT1
+
+static const char* TAG = "MQTT";
+
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static EventGroupHandle_t mqtt_events = NULL;
+static volatile bool client_started = false;
+
+// Topics, built once from the prefix
+static char client_id[24];
+static char status_topic[MQTT_TOPIC_MAX];
+static char event_topic[MQTT_TOPIC_MAX];
+
+// PUBACKs seen by the MQTT task, guarded by ack_lock. A PUBACK can come
+// back before the publish call returns its msg_id, so the delivery task
+// looks ids up here rather than having the handler match them.
+static portMUX_TYPE ack_lock = portMUX_INITIALIZER_UNLOCKED;
+static int acked_ids[MQTT_ACK_HISTORY];
+static unsigned acked_next = 0;
+
+// Connection the last send went out on, to tell reused from fresh ones
+static volatile uint32_t connection_count = 0;
+static uint32_t last_send_connection = 0;
+
+// Last retained state per channel - only touched by the delivery task
+static const char* channel_state[DOOR_RECORD_MAX_CHANNELS];
+
+/**
+ * Remember a PUBACK for the delivery task
+ */
+static void ack_record(int msg_id) {
+    portENTER_CRITICAL(&ack_lock);
+    acked_ids[acked_next] = msg_id;
+    acked_next = (acked_next + 1) % MQTT_ACK_HISTORY;
+    portEXIT_CRITICAL(&ack_lock);
+}
+
+/**
+ * Whether the broker has acknowledged a publish
+ */
+static bool ack_seen(int msg_id) {
+    bool seen = false;
+    portENTER_CRITICAL(&ack_lock);
+    for (int i = 0; i < MQTT_ACK_HISTORY && !seen; i++) {
+        seen = acked_ids[i] == msg_id;
+    }
+    portEXIT_CRITICAL(&ack_lock);
+    return seen;
+}
+
+/**
+ * MQTT event handler - runs in the esp-mqtt task
+ */
+static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
+    esp_mqtt_event_handle_t event = event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            TRACE(MQTT_CONNECTED, event->session_present);
+            connection_count++;
+            // Replaces the last will left by an earlier disconnect
+            esp_mqtt_client_enqueue(mqtt_client, status_topic, MQTT_STATUS_ONLINE, 0, MQTT_QOS, 1, true);
+            xEventGroupSetBits(mqtt_events, MQTT_CONNECTED_BIT);
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            TRACE(MQTT_DISCONNECTED);
+            xEventGroupClearBits(mqtt_events, MQTT_CONNECTED_BIT);
+            break;
+        case MQTT_EVENT_PUBLISHED:
+            TRACE(MQTT_PUBACK, event->msg_id);
+            ack_record(event->msg_id);
+            xEventGroupSetBits(mqtt_events, MQTT_ACK_BIT);
+            break;
+        case MQTT_EVENT_ERROR:
+            ESP_LOGW(TAG, "MQTT error (type %d)", event->error_handle ? (int)event->error_handle->error_type : -1);
+            metrics_count(METRIC_MQTT_ERRORS, 1);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Retained door state a record leaves behind, NULL if it cannot tell
+ */
+static const char* record_door_state(const door_record_t* record) {
+    switch (record->pattern) {
+        case DOOR_PATTERN_OPENED:
+            return "open";
+        case DOOR_PATTERN_CLOSED:
+        case DOOR_PATTERN_OPEN_CLOSE:
+        case DOOR_PATTERN_CYCLES:
+            return "closed";
+        default:
+            return NULL;        // A summarized run of events, its final state is not kept
+    }
+}
+
+/**
+ * Update a channel's retained state topic if a delivered record changed it
+ */
+static void publish_door_state(const door_record_t* record) {
+    uint8_t channel = DOOR_RECORD_CHANNEL(record);
+    const char* state = record_door_state(record);
+    if (state == NULL || channel >= DOOR_RECORD_MAX_CHANNELS || channel_state[channel] == state) {
+        return;
+    }
+
+    char topic[MQTT_TOPIC_MAX];
+    snprintf(topic, sizeof(topic), "%s/%u/state", MQTT_TOPIC_PREFIX, (unsigned)channel);
+    // Not awaited - the outbox retries it, and the next change corrects it
+    if (esp_mqtt_client_publish(mqtt_client, topic, state, 0, MQTT_QOS, 1) >= 0) {
+        channel_state[channel] = state;
+    }
+}
+
+/**
+ * Create the client with a fixed id, persistent session and last will
+ */
+esp_err_t notify_transport_init(void) {
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    // The broker keeps the session for this id - it must not change across reboots
+    snprintf(client_id, sizeof(client_id), "tripwire-%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(status_topic, sizeof(status_topic), "%s/status", MQTT_TOPIC_PREFIX);
+    snprintf(event_topic, sizeof(event_topic), "%s/event", MQTT_TOPIC_PREFIX);
+
+#if CONFIG_DOOR_STATIC_ALLOCATION
+    static StaticEventGroup_t mqtt_events_buffer;
+    mqtt_events = xEventGroupCreateStatic(&mqtt_events_buffer);
+#else
+    mqtt_events = xEventGroupCreate();
+#endif
+    if (mqtt_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_mqtt_client_config_t config = {
+        .broker.address.uri = MQTT_BROKER_URI,
+        .broker.verification.crt_bundle_attach = esp_crt_bundle_attach,  // Only used for mqtts:// brokers
+        .credentials.client_id = client_id,
+        .credentials.username = (MQTT_USERNAME[0] != '\0') ? MQTT_USERNAME : NULL,
+        .credentials.authentication.password = (MQTT_PASSWORD[0] != '\0') ? MQTT_PASSWORD : NULL,
+        .session.keepalive = MQTT_KEEPALIVE_S,
+        .session.disable_clean_session = true,  // Unacknowledged publishes survive a reconnect
+        .session.last_will = {
+            .topic = status_topic,
+            .msg = MQTT_STATUS_OFFLINE,
+            .qos = MQTT_QOS,
+            .retain = 1,
+        },
+        .network.reconnect_timeout_ms = MQTT_RECONNECT_MS,
+    };
+
+    mqtt_client = esp_mqtt_client_init(&config);
+    if (mqtt_client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize MQTT client");
+        return ESP_FAIL;
+    }
+    esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+
+    ESP_LOGI(TAG, "Delivering to %s as %s (topics %s/...)", MQTT_BROKER_URI, client_id, MQTT_TOPIC_PREFIX);
+    return ESP_OK;
+}
+
+/**
+ * Publish the window at QoS 1 and wait for the broker to acknowledge it
+ */
+int notify_transport_send(const notify_message_t* messages, int count, notify_send_info_t* info) {
+    EventBits_t bits = xEventGroupWaitBits(mqtt_events, MQTT_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(MQTT_CONNECT_WAIT_MS));
+    if (!(bits & MQTT_CONNECTED_BIT)) {
+        ESP_LOGW(TAG, "Not connected to the broker");
+        return 0;
+    }
+
+    uint32_t connection = connection_count;
+    info->reused = (connection == last_send_connection);
+    last_send_connection = connection;
+
+    // Every publish of the window goes out before the first PUBACK is awaited
+    int msg_ids[NOTIFY_TRANSPORT_WINDOW];
+    int published = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (; published < count; published++) {
+        int len = strlen(messages[published].text);
+        int msg_id = esp_mqtt_client_publish(mqtt_client, event_topic, messages[published].text, len, MQTT_QOS, 0);
+        if (msg_id < 0) {
+            ESP_LOGW(TAG, "Publish refused (%d)", msg_id);
+            metrics_count(METRIC_MQTT_ERRORS, 1);
+            break;
+        }
+        TRACE(MQTT_PUBLISH, msg_id, len);
+        msg_ids[published] = msg_id;
+    }
+
+    // Confirm in order - a later PUBACK only counts once the earlier ones are in
+    int confirmed = 0;
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(MQTT_ACK_TIMEOUT_MS);
+    while (confirmed < published) {
+        if (ack_seen(msg_ids[confirmed])) {
+            confirmed++;
+            continue;
+        }
+        TickType_t remaining = deadline - xTaskGetTickCount();
+        if ((int32_t)remaining <= 0) {
+            ESP_LOGW(TAG, "No PUBACK for %d of %d publishes", published - confirmed, published);
+            break;
+        }
+        xEventGroupWaitBits(mqtt_events, MQTT_ACK_BIT, pdTRUE, pdFALSE, remaining);
+    }
+    info->latency_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+    for (int i = 0; i < confirmed; i++) {
+        if (messages[i].record != NULL) {
+            publish_door_state(messages[i].record);
+        }
+    }
+    return confirmed;
+}
+
+/**
+ * Start the client once the network is first up - it reconnects by itself after that
+ */
+void notify_transport_set_online(bool online) {
+    if (!online || client_started || mqtt_client == NULL) {
+        return;
+    }
+
+    esp_err_t err = esp_mqtt_client_start(mqtt_client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(err));
+        return;
+    }
+    client_started = true;
+}
+
+#endif // CONFIG_DOOR_NOTIFY_TRANSPORT_MQTT
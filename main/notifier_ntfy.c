@@ -0,0 +1,194 @@
+#include "notifier_transport.h"
+
+#if !CONFIG_DOOR_NOTIFY_TRANSPORT_MQTT
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "metrics.h"
+#include "trace.h"
+
+// ntfy.sh Configuration (from Kconfig)
+#define NTFY_URL CONFIG_DOOR_NTFY_URL
+#define NTFY_PRIORITY CONFIG_DOOR_NTFY_PRIORITY_VALUE
+
+static const char* TAG = "NTFY";
+
+static volatile bool connection_stale = false;   // Link dropped since the socket was opened
+
+// Long-lived ntfy.sh client - only touched by the delivery task
+static esp_http_client_handle_t ntfy_client = NULL;
+static bool ntfy_new_connection = false;        // Set when the current request opened a socket
+static bool ntfy_request_sent = false;          // Set once the current request's headers went out
+
+/**
+ * HTTP event handler for ntfy.sh requests
+ */
+static esp_err_t ntfy_http_event_handler(esp_http_client_event_t *evt) {
+    switch(evt->event_id) {
+        case HTTP_EVENT_ERROR:
+            ESP_LOGE(TAG, "HTTP Error");
+            break;
+        case HTTP_EVENT_ON_CONNECTED:
+            TRACE(NTFY_CONNECTED);
+            ntfy_new_connection = true;
+            break;
+        case HTTP_EVENT_HEADER_SENT:
+            TRACE(NTFY_HEADERS_SENT);
+            ntfy_request_sent = true;
+            break;
+        case HTTP_EVENT_ON_FINISH:
+            TRACE(NTFY_FINISHED);
+            break;
+        case HTTP_EVENT_DISCONNECTED:
+            TRACE(NTFY_DISCONNECTED);
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Get the long-lived ntfy.sh client, creating it on first use
+ */
+static esp_http_client_handle_t ntfy_client_get(void) {
+    if (ntfy_client != NULL) {
+        return ntfy_client;
+    }
+
+    esp_http_client_config_t config = {
+        .url = NTFY_URL,
+        .event_handler = ntfy_http_event_handler,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = 10000,  // 10 second timeout
+        .crt_bundle_attach = esp_crt_bundle_attach,  // Use certificate bundle for HTTPS
+        .keep_alive_enable = true,  // TCP keep-alive so idle drops are noticed
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = true,  // Resume the TLS session after a reconnect
+#endif
+    };
+
+    ntfy_client = esp_http_client_init(&config);
+    if (!ntfy_client) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return NULL;
+    }
+
+    // Headers persist on the handle across requests
+    esp_http_client_set_header(ntfy_client, "Content-Type", "text/plain");
+    esp_http_client_set_header(ntfy_client, "Priority", NTFY_PRIORITY);
+    esp_http_client_set_header(ntfy_client, "Title", "Door Monitor");
+    esp_http_client_set_header(ntfy_client, "Tags", "door,security");
+    return ntfy_client;
+}
+
+/**
+ * Drop the current connection (the handle and TLS session are kept)
+ */
+static void ntfy_client_close(void) {
+    if (ntfy_client != NULL) {
+        esp_http_client_close(ntfy_client);
+    }
+}
+
+/**
+ * Post one message on the long-lived client
+ */
+static esp_err_t ntfy_post(esp_http_client_handle_t client, const char* message) {
+    ntfy_new_connection = false;
+    ntfy_request_sent = false;
+    esp_http_client_set_post_field(client, message, strlen(message));
+    return esp_http_client_perform(client);
+}
+
+/**
+ * Send notification via ntfy.sh
+ */
+static bool send_ntfy_notification(const char* message, notify_send_info_t* info) {
+    ESP_LOGD(TAG, "Sending ntfy notification: %s", message);
+
+    esp_http_client_handle_t client = ntfy_client_get();
+    if (!client) {
+        return false;
+    }
+
+    // A socket opened before the link dropped is dead - reconnect up front
+    if (connection_stale) {
+        ntfy_client_close();
+        connection_stale = false;
+    }
+
+    // Perform the request
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = ntfy_post(client, message);
+
+    // The server may have closed an idle keep-alive socket - retry once on a
+    // fresh one, but only if the request never got out (the write failed).
+    // Once its headers are written the server may act on it even though the
+    // answer is lost, so it goes back to the backlog rather than post twice.
+    if (err != ESP_OK && !ntfy_new_connection && !ntfy_request_sent) {
+        TRACE(NTFY_REUSE_FAILED, err);
+        ntfy_client_close();
+        start_us = esp_timer_get_time();
+        err = ntfy_post(client, message);
+    }
+
+    info->latency_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    info->reused = !ntfy_new_connection;
+    bool success = false;
+
+    if (err == ESP_OK) {
+        int status_code = esp_http_client_get_status_code(client);
+        if (status_code == 200) {
+            TRACE(NTFY_SENT, info->latency_ms, info->reused);
+            success = true;
+        } else {
+            ESP_LOGW(TAG, "ntfy request failed with status: %d", status_code);
+            metrics_count(METRIC_HTTP_STATUS_FAILED, 1);
+        }
+    } else {
+        ESP_LOGE(TAG, "ntfy HTTP request failed: %s", esp_err_to_name(err));
+        metrics_count(METRIC_HTTP_ERRORS, 1);
+    }
+
+#if CONFIG_DOOR_NTFY_KEEP_ALIVE
+    if (!success) {
+        ntfy_client_close();
+    }
+#else
+    // One connection per message - the old behaviour, kept for comparison
+    esp_http_client_cleanup(ntfy_client);
+    ntfy_client = NULL;
+#endif
+
+    return success;
+}
+
+/**
+ * Nothing to prepare - the client is created on first use
+ */
+esp_err_t notify_transport_init(void) {
+    ESP_LOGI(TAG, "Delivering to %s", NTFY_URL);
+    return ESP_OK;
+}
+
+/**
+ * Post the message (the window is one request)
+ */
+int notify_transport_send(const notify_message_t* messages, int count, notify_send_info_t* info) {
+    return (count > 0 && send_ntfy_notification(messages[0].text, info)) ? 1 : 0;
+}
+
+/**
+ * A socket opened before a drop is dead - reconnect before the next request
+ */
+void notify_transport_set_online(bool online) {
+    if (!online) {
+        connection_stale = true;
+    }
+}
+
+#endif // !CONFIG_DOOR_NOTIFY_TRANSPORT_MQTT
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "door_record.h"
+
+/**
+ * Network transports behind the delivery task (internal to the notifier).
+ *
+ * Exactly one transport is compiled in, chosen with DOOR_NOTIFY_TRANSPORT_*.
+ * The core in notifier.c owns the submit queue, the retry backlog and the
+ * flash log; a transport only gets messages to the server and reports
+ * which of them the server confirmed. Transports are only called from the
+ * delivery task, except notify_transport_set_online().
+ */
+
+#if CONFIG_DOOR_NOTIFY_TRANSPORT_MQTT
+#define NOTIFY_TRANSPORT_NAME "MQTT"
+#define NOTIFY_TRANSPORT_WINDOW CONFIG_DOOR_MQTT_INFLIGHT_MAX  // QoS 1 publishes awaiting PUBACK at once
+#define NOTIFY_TRANSPORT_SEND_GAP_MS 0  // Broker takes back-to-back publishes
+#else
+#define NOTIFY_TRANSPORT_NAME "ntfy.sh"
+#define NOTIFY_TRANSPORT_WINDOW 1       // One HTTP request at a time
+#define NOTIFY_TRANSPORT_SEND_GAP_MS 500  // Small delay between backlog messages to avoid rate limiting
+#endif
+
+// One message to deliver
+typedef struct {
+    const char* text;               // Rendered notification
+    const door_record_t* record;    // Record it was rendered from, NULL for a coalesced backlog
+} notify_message_t;
+
+// How a send went, for the delivery statistics
+typedef struct {
+    bool reused;                    // Went out on a connection that was already open
+    uint32_t latency_ms;            // Last attempt, from the first byte out to the confirmation
+} notify_send_info_t;
+
+/**
+ * Prepare the transport (before the delivery task starts)
+ */
+esp_err_t notify_transport_init(void);
+
+/**
+ * Deliver messages in order, with at most NOTIFY_TRANSPORT_WINDOW of them
+ * unconfirmed at once - blocks until they are confirmed or the attempt fails
+ * @param count At most NOTIFY_TRANSPORT_WINDOW
+ * @return How many messages from the start were confirmed
+ */
+int notify_transport_send(const notify_message_t* messages, int count, notify_send_info_t* info);
+
+/**
+ * The network came up or went down (any task)
+ */
+void notify_transport_set_online(bool online);
@@ -0,0 +1,500 @@
+#include "presence.h"
+#include "presence_backend.h"
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "door_record.h"
+#include "ble_match.h"
+#include "probe_plan.h"
+#include "metrics.h"
+#include "trace.h"
+#include "mem_report.h"
+
+// Bluetooth Configuration (from Kconfig)
+#define AUTHORIZED_DEVICES CONFIG_DOOR_AUTHORIZED_DEVICES
+#define PHONE_BT_MAC CONFIG_DOOR_PHONE_BT_MAC
+
+#define PRESENCE_TASK_STACK_SIZE 4096
+#define PRESENCE_TASK_PRIORITY 3
+
+MEM_TASK_STACK(presence_stack, PRESENCE_TASK_STACK_SIZE);
+
+// Task notification bits
+#define PROBE_NOW_BIT       (1UL << 0)  // Door activity - probe right away
+#define PROBE_ANSWER_BIT    (1UL << 1)  // Backend heard from a device during a round
+
+// Prefix of an identity resolving key in DOOR_AUTHORIZED_DEVICES
+#define IRK_PREFIX "irk:"
+
+_Static_assert(PRESENCE_MAX_DEVICES <= DOOR_RECORD_MAX_PEOPLE,
+               "every authorized device needs a person index in door records");
+_Static_assert(PRESENCE_MAX_DEVICES <= PROBE_PLAN_MAX_DEVICES, "every authorized device needs a probe plan slot");
+
+static const char* TAG = "PRESENCE";
+
+static presence_device_t devices[PRESENCE_MAX_DEVICES];
+static int device_count = 0;
+
+static TaskHandle_t presence_task_handle = NULL;
+static TaskHandle_t listener_task = NULL;
+static uint32_t listener_notify_bits = 0;
+
+// Presence cache and probe round state, guarded by presence_lock. last_seen
+// is in RTC memory so a recent answer still counts after waking from deep sleep.
+static portMUX_TYPE presence_lock = portMUX_INITIALIZER_UNLOCKED;
+static presence_status_t status = { .state = PRESENCE_UNKNOWN };
+static RTC_DATA_ATTR time_t last_seen[PRESENCE_MAX_DEVICES];
+static int8_t last_rssi[PRESENCE_MAX_DEVICES];
+static int64_t last_activity_us = 0;
+static uint32_t probes_started = 0;     // Probe numbers double as lookup tickets
+static bool round_active = false;       // A probe round is waiting for an answer
+static int round_answer = -1;           // First device heard from this round
+static bool round_complete = false;     // Backend has nothing more to hear this round
+static probe_plan_t probe_plan;         // Which devices each round pages - presence task only
+
+/**
+ * Parse MAC address string into a 6-byte address
+ */
+static bool parse_mac_address(const char* mac_str, uint8_t mac_addr[6]) {
+    int values[6];
+    int result = sscanf(mac_str, "%x:%x:%x:%x:%x:%x",
+                        &values[0], &values[1], &values[2],
+                        &values[3], &values[4], &values[5]);
+
+    if (result == 6) {
+        for (int i = 0; i < 6; i++) {
+            mac_addr[i] = (uint8_t)values[i];
+        }
+        return true;
+    }
+
+    ESP_LOGW(TAG, "MAC parsing failed for '%s': only %d fields parsed", mac_str, result);
+    // Set to all zeros on failure
+    memset(mac_addr, 0, 6);
+    return false;
+}
+
+/**
+ * Parse 32 hex digits, most significant byte first, into an IRK
+ */
+static bool parse_irk(const char* hex, uint8_t irk[16]) {
+    if (strlen(hex) != 32) {
+        ESP_LOGW(TAG, "IRK must be 32 hex digits: '%s'", hex);
+        return false;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        unsigned int byte;
+        if (sscanf(&hex[i * 2], "%2x", &byte) != 1) {
+            ESP_LOGW(TAG, "IRK parsing failed for '%s'", hex);
+            return false;
+        }
+        irk[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+/**
+ * Strip leading and trailing spaces in place
+ */
+static char* trim(char* str) {
+    while (*str == ' ') {
+        str++;
+    }
+    size_t len = strlen(str);
+    while (len > 0 && str[len - 1] == ' ') {
+        str[--len] = '\0';
+    }
+    return str;
+}
+
+/**
+ * Fill the device table from "Name=AA:BB:CC:DD:EE:FF,Name=irk:<hex>,..." or the single phone MAC
+ */
+static void parse_device_list(void) {
+    const char* p = AUTHORIZED_DEVICES;
+
+    while (*p != '\0' && device_count < PRESENCE_MAX_DEVICES) {
+        size_t len = strcspn(p, ",;");
+        char entry[PRESENCE_NAME_MAX + 48];
+
+        if (len >= sizeof(entry)) {
+            ESP_LOGW(TAG, "Skipping authorized device entry longer than %d characters", (int)sizeof(entry) - 1);
+        } else if (len > 0) {
+            memcpy(entry, p, len);
+            entry[len] = '\0';
+
+            // "Name=MAC", "Name=irk:KEY" or a bare MAC
+            char* name = "";
+            char* id = strchr(entry, '=');
+            if (id != NULL) {
+                *id++ = '\0';
+                name = trim(entry);
+            } else {
+                id = entry;
+            }
+            id = trim(id);
+
+            presence_device_t* device = &devices[device_count];
+            memset(device, 0, sizeof(*device));
+            if (strncmp(id, IRK_PREFIX, strlen(IRK_PREFIX)) == 0) {
+                device->has_irk = parse_irk(id + strlen(IRK_PREFIX), device->irk);
+            } else {
+                device->has_addr = parse_mac_address(id, device->addr);
+            }
+            if (device->has_addr || device->has_irk) {
+                strlcpy(device->name, name, sizeof(device->name));
+                device_count++;
+            }
+        }
+
+        p += len;
+        if (*p != '\0') {
+            p++;
+        }
+    }
+
+    if (device_count == 0 && parse_mac_address(PHONE_BT_MAC, devices[0].addr)) {
+        devices[0].has_addr = true;
+        device_count = 1;
+    }
+
+    for (int i = 0; i < device_count; i++) {
+        door_record_set_person_name(i + 1, devices[i].name);
+        if (devices[i].has_addr) {
+            ESP_LOGI(TAG, "Authorized device %d: %02x:%02x:%02x:%02x:%02x:%02x %s", i + 1,
+                     devices[i].addr[0], devices[i].addr[1], devices[i].addr[2],
+                     devices[i].addr[3], devices[i].addr[4], devices[i].addr[5], devices[i].name);
+        } else {
+            ESP_LOGI(TAG, "Authorized device %d: IRK %s", i + 1, devices[i].name);
+        }
+    }
+}
+
+/**
+ * Number of authorized devices
+ */
+int presence_device_count(void) {
+    return device_count;
+}
+
+/**
+ * Authorized device by table index
+ */
+const presence_device_t* presence_device(int index) {
+    return &devices[index];
+}
+
+/**
+ * Printable name of a device for logs
+ */
+const char* presence_device_label(int index) {
+    return (index >= 0 && devices[index].name[0] != '\0') ? devices[index].name : "phone";
+}
+
+/**
+ * Record that a device was heard from (any task or Bluetooth callback context)
+ */
+void presence_device_seen(int index, int rssi) {
+    if (index < 0 || index >= device_count) {
+        return;
+    }
+
+    time_t now;
+    time(&now);
+
+    portENTER_CRITICAL(&presence_lock);
+    last_seen[index] = now;
+    last_rssi[index] = (int8_t)rssi;
+    bool first_answer = round_active && round_answer < 0;
+    if (first_answer) {
+        round_answer = index;
+    }
+    portEXIT_CRITICAL(&presence_lock);
+
+    // Wake the probing task waiting for an answer
+    if (first_answer && presence_task_handle != NULL) {
+        xTaskNotify(presence_task_handle, PROBE_ANSWER_BIT, eSetBits);
+    }
+}
+
+/**
+ * Every device of the current round was paged and refused
+ */
+void presence_round_complete(void) {
+    portENTER_CRITICAL(&presence_lock);
+    bool counted = round_active && !round_complete;
+    if (counted) {
+        round_complete = true;
+    }
+    portEXIT_CRITICAL(&presence_lock);
+
+    if (counted && presence_task_handle != NULL) {
+        xTaskNotify(presence_task_handle, PROBE_ANSWER_BIT, eSetBits);
+    }
+}
+
+/**
+ * One probe round: hand the devices of the round plan to the backend, the
+ * likeliest first, and stop at the first answer, when the backend has
+ * heard every one of them refuse, or after PRESENCE_PROBE_TIMEOUT_MS.
+ * A paging backend gets at most probe_plan.per_round devices, as many as
+ * fit in that time - with more listed, the others get their turn in later
+ * rounds (logged at start)
+ * @param answer Set to the index of the device that answered, -1 if none did
+ * @param skipped Set to the devices of the round the deadline came before
+ */
+static presence_probe_result_t probe_devices(int* answer, int* skipped) {
+    *answer = -1;
+    *skipped = 0;
+    if (device_count == 0) {
+        return PRESENCE_PROBE_ABSENT;
+    }
+
+    int order[PRESENCE_MAX_DEVICES];
+    portENTER_CRITICAL(&presence_lock);
+    int count = probe_plan_next(&probe_plan, last_seen, order);
+    round_answer = -1;
+    round_complete = false;
+    round_active = true;
+    portEXIT_CRITICAL(&presence_lock);
+    ulTaskNotifyValueClear(NULL, PROBE_ANSWER_BIT);
+
+    presence_backend_probe_start(order, count);
+
+    // Sleep until the backend reports an answer or the round times out
+    int64_t deadline_us = esp_timer_get_time() + PRESENCE_PROBE_TIMEOUT_MS * 1000LL;
+    while (1) {
+        portENTER_CRITICAL(&presence_lock);
+        bool done = round_answer >= 0 || round_complete;
+        portEXIT_CRITICAL(&presence_lock);
+
+        int64_t remaining_us = deadline_us - esp_timer_get_time();
+        if (done || remaining_us <= 0) {
+            break;
+        }
+        xTaskNotifyWait(0, PROBE_ANSWER_BIT, NULL, pdMS_TO_TICKS(remaining_us / 1000) + 1);
+    }
+
+    portENTER_CRITICAL(&presence_lock);
+    round_active = false;
+    *answer = round_answer;
+    bool complete = round_complete;
+    portEXIT_CRITICAL(&presence_lock);
+
+    int unpaged = presence_backend_probe_end();
+    if (*answer >= 0) {
+        return PRESENCE_PROBE_PRESENT;
+    }
+    if (complete) {
+        return PRESENCE_PROBE_ABSENT;
+    }
+    *skipped = unpaged;
+    return PRESENCE_PROBE_TIMEOUT;
+}
+
+/**
+ * Probe and record the result in the cache
+ */
+static void run_probe(void) {
+    portENTER_CRITICAL(&presence_lock);
+    status.probing = true;
+    probes_started++;
+    portEXIT_CRITICAL(&presence_lock);
+
+    int64_t start_us = esp_timer_get_time();
+    int answer, skipped;
+    presence_probe_result_t result = probe_devices(&answer, &skipped);
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    uint32_t elapsed_ms = (uint32_t)(elapsed_us / 1000);
+    metrics_observe_us(METRIC_STAGE_PROBE, elapsed_us);
+    if (result == PRESENCE_PROBE_TIMEOUT) {
+        metrics_count(METRIC_PROBE_TIMEOUTS, 1);
+        metrics_count(METRIC_PROBE_SKIPPED, skipped);
+    }
+    bool answered = result == PRESENCE_PROBE_PRESENT;
+    time_t now;
+    time(&now);
+
+    portENTER_CRITICAL(&presence_lock);
+    presence_state_t previous = status.state;
+    status.state = answered ? PRESENCE_PRESENT : PRESENCE_ABSENT;
+    status.last_probe = now;
+    status.last_result = result;
+    status.last_probe_ms = elapsed_ms;
+    status.probes++;
+    if (answered) {
+        status.answers++;
+        status.last_person = (uint8_t)(answer + 1);
+    }
+    status.probing = false;
+    portEXIT_CRITICAL(&presence_lock);
+
+    TRACE(PROBE_DONE, answered ? answer : -1, result, elapsed_ms);
+    if (status.state != previous) {
+        ESP_LOGI(TAG, "%s (probe %s after %lu ms)", answered ? presence_device_label(answer) : "No device answering",
+                 result == PRESENCE_PROBE_TIMEOUT ? "timed out" : "finished", (unsigned long)elapsed_ms);
+    }
+
+    // Events held back for this probe can go out now
+    if (listener_task != NULL) {
+        xTaskNotify(listener_task, listener_notify_bits, eSetBits);
+    }
+}
+
+/**
+ * Time until the next scheduled probe - short right after door activity
+ */
+static TickType_t probe_interval_ticks(void) {
+#if !PRESENCE_BACKEND_PERIODIC
+    // The backend keeps listening between rounds, only door activity needs one
+    return portMAX_DELAY;
+#else
+    portENTER_CRITICAL(&presence_lock);
+    int64_t activity_us = last_activity_us;
+    portEXIT_CRITICAL(&presence_lock);
+
+    bool active = activity_us != 0 &&
+                  esp_timer_get_time() - activity_us < CONFIG_DOOR_PRESENCE_ACTIVE_WINDOW_S * 1000000LL;
+    uint32_t interval_s = active ? CONFIG_DOOR_PRESENCE_ACTIVE_INTERVAL_S : CONFIG_DOOR_PRESENCE_IDLE_INTERVAL_S;
+    return pdMS_TO_TICKS(interval_s * 1000);
+#endif
+}
+
+/**
+ * Presence task - probe on schedule or as soon as the door moves
+ */
+static void presence_task(void* arg) {
+    while (1) {
+        run_probe();
+        xTaskNotifyWait(0, PROBE_NOW_BIT, NULL, probe_interval_ticks());
+    }
+}
+
+/**
+ * Bring up Bluetooth and start the probing task
+ */
+esp_err_t presence_start(TaskHandle_t listener, uint32_t listener_bits) {
+    listener_task = listener;
+    listener_notify_bits = listener_bits;
+
+    parse_device_list();
+    ESP_LOGI(TAG, "Presence backend: %s", PRESENCE_BACKEND_NAME);
+
+    // A Classic page needs the MAC address, IRK-only devices are never paged
+    bool probe[PRESENCE_MAX_DEVICES];
+    for (int i = 0; i < device_count; i++) {
+        probe[i] = !PRESENCE_BACKEND_PAGES || devices[i].has_addr;
+    }
+    probe_plan_init(&probe_plan, probe, device_count, PRESENCE_PROBE_TIMEOUT_MS, PRESENCE_BACKEND_PAGES);
+    if (probe_plan.per_round < probe_plan.candidate_count) {
+        ESP_LOGW(TAG, "%d devices to page, %d per %d ms round at %lu ms each - each one is paged at least every "
+                 "%d rounds", probe_plan.candidate_count, probe_plan.per_round, PRESENCE_PROBE_TIMEOUT_MS,
+                 (unsigned long)probe_plan.page_ms, probe_plan.rounds_to_cover);
+    } else if (PRESENCE_BACKEND_PAGES) {
+        ESP_LOGI(TAG, "%d devices to page at %lu ms each, all in every round", probe_plan.candidate_count,
+                 (unsigned long)probe_plan.page_ms);
+    }
+
+    if (presence_backend_init(probe_plan.page_ms) != ESP_OK) {
+        ESP_LOGW(TAG, "Bluetooth unavailable - every event will be unauthenticated");
+        return ESP_FAIL;
+    }
+
+    if (mem_task_create(presence_task, "presence", PRESENCE_TASK_STACK_SIZE, NULL,
+                        PRESENCE_TASK_PRIORITY, &presence_task_handle, MEM_TASK_BUFFERS(presence_stack)) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create presence task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Device seen most recently within the TTL
+ * @return 1-based device index, 0 if none
+ */
+static uint8_t most_recent_person(void) {
+    time_t now;
+    time(&now);
+
+    portENTER_CRITICAL(&presence_lock);
+    int index = ble_match_most_recent(last_seen, device_count, now, CONFIG_DOOR_PRESENCE_TTL_S);
+    portEXIT_CRITICAL(&presence_lock);
+    return (uint8_t)(index + 1);
+}
+
+/**
+ * Whether any authorized device answered within the configured TTL (cache lookup only)
+ */
+bool presence_is_present(void) {
+    return most_recent_person() != 0;
+}
+
+/**
+ * Report door activity - probes immediately and keeps probing often for a while
+ */
+uint32_t presence_note_activity(void) {
+    if (presence_task_handle == NULL) {
+        return 0;
+    }
+
+    // A probe already on the air covers this activity, otherwise the next one will
+    portENTER_CRITICAL(&presence_lock);
+    last_activity_us = esp_timer_get_time();
+    uint32_t ticket = status.probing ? probes_started : probes_started + 1;
+    portEXIT_CRITICAL(&presence_lock);
+
+    xTaskNotify(presence_task_handle, PROBE_NOW_BIT, eSetBits);
+    return ticket;
+}
+
+/**
+ * Look up presence for an event, taking the probe behind its ticket into account
+ */
+presence_result_t presence_lookup(uint32_t ticket, uint8_t* person) {
+    *person = most_recent_person();
+    if (*person != 0) {
+        return PRESENCE_RESULT_PRESENT;
+    }
+
+    portENTER_CRITICAL(&presence_lock);
+    uint32_t completed = status.probes;
+    portEXIT_CRITICAL(&presence_lock);
+
+    // Ticketed probe not finished yet - it may still find the phone
+    if (ticket != 0 && (int32_t)(completed - ticket) < 0) {
+        return PRESENCE_RESULT_PENDING;
+    }
+    return PRESENCE_RESULT_ABSENT;
+}
+
+/**
+ * Whether a probe is in progress
+ */
+bool presence_busy(void) {
+    portENTER_CRITICAL(&presence_lock);
+    bool probing = status.probing;
+    portEXIT_CRITICAL(&presence_lock);
+    return probing;
+}
+
+/**
+ * Copy the current presence cache
+ */
+void presence_get_status(presence_status_t* out) {
+    portENTER_CRITICAL(&presence_lock);
+    *out = status;
+    out->last_seen = 0;
+    out->last_rssi = 0;
+    for (int i = 0; i < device_count; i++) {
+        if (last_seen[i] > out->last_seen) {
+            out->last_seen = last_seen[i];
+            out->last_rssi = last_rssi[i];
+        }
+    }
+    portEXIT_CRITICAL(&presence_lock);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * Background phone presence tracking.
+ *
+ * A dedicated task probes every authorized device on an adaptive schedule -
+ * often while the door is in use, rarely when it is idle - and caches when
+ * each one last answered. Authenticating a door event is a lookup in that
+ * cache and never waits on the radio.
+ *
+ * The radio side is a build-time backend: Classic remote-name requests,
+ * Classic SPP connects, or a passive BLE scan that hears devices between
+ * probes as well.
+ */
+
+// Authorized device table limits
+#define PRESENCE_MAX_DEVICES 8
+#define PRESENCE_NAME_MAX 16
+
+// How long a probe round waits for any device to answer
+#define PRESENCE_PROBE_TIMEOUT_MS 3000
+
+// Result of the most recent probe
+typedef enum {
+    PRESENCE_UNKNOWN,           // Not probed yet
+    PRESENCE_PRESENT,           // A device answered
+    PRESENCE_ABSENT,            // No device answered in time
+} presence_state_t;
+
+// Outcome of a probe round
+typedef enum {
+    PRESENCE_PROBE_NONE,        // No round finished yet
+    PRESENCE_PROBE_PRESENT,     // A device answered
+    PRESENCE_PROBE_ABSENT,      // Every device was paged and none answered
+    PRESENCE_PROBE_TIMEOUT,     // The round ran out of time without an answer
+} presence_probe_result_t;
+
+// Answer to presence_lookup()
+typedef enum {
+    PRESENCE_RESULT_ABSENT,     // Not seen within the TTL and the probe is done
+    PRESENCE_RESULT_PRESENT,    // Seen within the TTL
+    PRESENCE_RESULT_PENDING,    // Not seen yet, but the probe is still running
+} presence_result_t;
+
+// Snapshot of the presence cache
+typedef struct {
+    presence_state_t state;
+    time_t last_seen;           // Wall clock of the last answer from any device, 0 if never
+    time_t last_probe;          // Wall clock the last probe finished
+    presence_probe_result_t last_result;
+    uint32_t last_probe_ms;     // How long the last probe took to reach its result
+    int8_t last_rssi;           // Signal strength of that answer in dBm, 0 if unknown
+    uint8_t last_person;        // 1-based device that answered last, 0 if none yet
+    bool probing;               // A probe is on the air right now
+    uint32_t probes;
+    uint32_t answers;
+} presence_status_t;
+
+/**
+ * Bring up Bluetooth and start the probing task
+ * @param listener Task notified with listener_bits whenever a probe finishes
+ */
+esp_err_t presence_start(TaskHandle_t listener, uint32_t listener_bits);
+
+/**
+ * Whether any authorized device answered within the configured TTL (cache lookup only)
+ */
+bool presence_is_present(void);
+
+/**
+ * Report door activity - probes immediately and keeps probing often for a while
+ * @return Ticket for the probe covering this activity, to pass to presence_lookup()
+ */
+uint32_t presence_note_activity(void);
+
+/**
+ * Look up presence for an event, taking the probe behind its ticket into account
+ * @param ticket From presence_note_activity(), or 0 for a plain cache lookup
+ * @param person Set to the 1-based device seen most recently, 0 if none
+ */
+presence_result_t presence_lookup(uint32_t ticket, uint8_t* person);
+
+/**
+ * Whether a probe is in progress
+ */
+bool presence_busy(void);
+
+/**
+ * Copy the current presence cache
+ */
+void presence_get_status(presence_status_t* status);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "presence.h"
+
+/**
+ * Radio backends behind the presence cache (internal to the presence module).
+ *
+ * Exactly one backend is compiled in, chosen with DOOR_PRESENCE_BACKEND_*.
+ * The core in presence.c owns the device table, the cache and the probe
+ * rounds; a backend only talks to the radio and reports every device it
+ * hears from through presence_device_seen().
+ */
+
+#if CONFIG_DOOR_PRESENCE_BACKEND_BLE
+#define PRESENCE_BACKEND_NAME "BLE passive scan"
+#define PRESENCE_BACKEND_PERIODIC 0     // Listens all the time, probe rounds only on door activity
+#define PRESENCE_BACKEND_PAGES 0        // Hears every device at once
+#elif CONFIG_DOOR_PRESENCE_BACKEND_SPP
+#define PRESENCE_BACKEND_NAME "Classic SPP"
+#define PRESENCE_BACKEND_PERIODIC 1     // Nothing is heard unless a device is paged
+#define PRESENCE_BACKEND_PAGES 1        // One device at a time, by MAC address
+#else
+#define PRESENCE_BACKEND_NAME "Classic remote-name request"
+#define PRESENCE_BACKEND_PERIODIC 1     // Nothing is heard unless a device is paged
+#define PRESENCE_BACKEND_PAGES 1        // One device at a time, by MAC address
+#endif
+
+// Authorized device, from DOOR_AUTHORIZED_DEVICES
+typedef struct {
+    char name[PRESENCE_NAME_MAX];
+    uint8_t addr[6];            // Bluetooth address, most significant byte first
+    bool has_addr;
+    uint8_t irk[16];            // BLE identity resolving key, most significant byte first
+    bool has_irk;
+} presence_device_t;
+
+/**
+ * Number of authorized devices
+ */
+int presence_device_count(void);
+
+/**
+ * Authorized device by table index
+ */
+const presence_device_t* presence_device(int index);
+
+/**
+ * Printable name of a device for logs
+ */
+const char* presence_device_label(int index);
+
+/**
+ * Record that a device was heard from (any task or Bluetooth callback context)
+ * @param rssi Signal strength in dBm, 0 if unknown
+ */
+void presence_device_seen(int index, int rssi);
+
+/**
+ * Every device of the current round was paged and refused - the round is
+ * over without waiting for its timeout (any task or Bluetooth callback context)
+ */
+void presence_round_complete(void);
+
+/**
+ * Bring up the radio
+ * @param page_timeout_ms How long one page may take, 0 if the backend does not page
+ */
+esp_err_t presence_backend_init(uint32_t page_timeout_ms);
+
+/**
+ * Start a probe round - the core waits for presence_device_seen() or its timeout
+ * @param order Device indices to page this round, the likeliest to answer first
+ */
+void presence_backend_probe_start(const int* order, int count);
+
+/**
+ * The probe round is over
+ * @return devices of the round not paged yet, 0 if the backend does not page
+ */
+int presence_backend_probe_end(void);
@@ -0,0 +1,249 @@
+#include "presence_backend.h"
+
+#if CONFIG_DOOR_PRESENCE_BACKEND_BLE
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "mbedtls/aes.h"
+#include "ble_match.h"
+#include "trace.h"
+
+/**
+ * Presence backend listening to BLE advertisements.
+ *
+ * Nothing is transmitted: a passive scan runs all the time at a low duty
+ * cycle and every advertisement from a known address, or from a private
+ * address that resolves to a known IRK, refreshes that device in the
+ * presence cache. A probe round only raises the scan to full duty until it
+ * ends, so door activity is matched against a fresh sighting.
+ */
+
+static const char* TAG = "PRESENCE_BLE";
+
+// Scan timing in 0.625 ms units
+#define IDLE_SCAN_INTERVAL  0x0640  // 1 s
+#define IDLE_SCAN_WINDOW    0x0050  // 50 ms - 5% duty between rounds
+#define FAST_SCAN_INTERVAL  0x0050  // 50 ms
+#define FAST_SCAN_WINDOW    0x0050  // Continuous during a probe round
+
+static bool bt_initialized = false;
+static ble_match_t matcher;             // Only touched from the Bluetooth task once scanning
+
+// Scan mode switching, guarded by scan_lock. Parameters cannot change while
+// scanning, so a switch goes stop -> set parameters -> start, one stack
+// event at a time.
+static portMUX_TYPE scan_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool scan_fast_wanted = false;
+static bool scan_fast_applied = false;
+static bool scan_running = false;
+static bool scan_switching = false;     // A stop/set/start sequence is under way
+
+/**
+ * AES-128 block encryption for address resolution
+ */
+static void aes128_encrypt(const uint8_t key[16], const uint8_t in[16], uint8_t out[16]) {
+    mbedtls_aes_context ctx;
+    mbedtls_aes_init(&ctx);
+    mbedtls_aes_setkey_enc(&ctx, key, 128);
+    mbedtls_aes_crypt_ecb(&ctx, MBEDTLS_AES_ENCRYPT, in, out);
+    mbedtls_aes_free(&ctx);
+}
+
+/**
+ * Hand the scan parameters for the wanted mode to the stack (Bluetooth task context)
+ */
+static void apply_scan_params(void) {
+    portENTER_CRITICAL(&scan_lock);
+    bool fast = scan_fast_wanted;
+    scan_fast_applied = fast;
+    portEXIT_CRITICAL(&scan_lock);
+
+    esp_ble_scan_params_t params = {
+        .scan_type = BLE_SCAN_TYPE_PASSIVE,
+        .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+        .scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+        .scan_interval = fast ? FAST_SCAN_INTERVAL : IDLE_SCAN_INTERVAL,
+        .scan_window = fast ? FAST_SCAN_WINDOW : IDLE_SCAN_WINDOW,
+        .scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE,   // Every packet refreshes last seen
+    };
+    esp_err_t ret = esp_ble_gap_set_scan_params(&params);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Set scan params failed: %s", esp_err_to_name(ret));
+        portENTER_CRITICAL(&scan_lock);
+        scan_switching = false;
+        portEXIT_CRITICAL(&scan_lock);
+    }
+}
+
+/**
+ * Switch between idle and probe round duty cycle
+ */
+static void set_scan_fast(bool fast) {
+    portENTER_CRITICAL(&scan_lock);
+    scan_fast_wanted = fast;
+    bool stop = !scan_switching && scan_running && scan_fast_applied != fast;
+    bool restart = !scan_switching && !scan_running;     // An earlier start failed
+    if (stop || restart) {
+        scan_switching = true;
+    }
+    portEXIT_CRITICAL(&scan_lock);
+
+    // A switch already under way picks up the new mode when it completes
+    if (stop) {
+        esp_ble_gap_stop_scanning();
+    } else if (restart) {
+        apply_scan_params();
+    }
+}
+
+/**
+ * Match an advertiser against the authorized devices (Bluetooth task context)
+ */
+static void handle_scan_result(const struct ble_scan_result_evt_param* result) {
+    if (result->search_evt != ESP_GAP_SEARCH_INQ_RES_EVT) {
+        return;
+    }
+
+    bool random = result->ble_addr_type == BLE_ADDR_TYPE_RANDOM ||
+                  result->ble_addr_type == BLE_ADDR_TYPE_RPA_RANDOM;
+    int index = ble_match_resolve(&matcher, result->bda, random);
+    if (index >= 0) {
+        TRACE(BLE_ADV, index, result->rssi);
+        presence_device_seen(index, result->rssi);
+    }
+}
+
+/**
+ * GAP callback - drives the scan mode switches and receives advertisements
+ */
+static void gap_callback(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+    switch (event) {
+        case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT:
+            if (param->scan_param_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGE(TAG, "Scan params rejected: %d", param->scan_param_cmpl.status);
+            }
+            esp_ble_gap_start_scanning(0);  // Scan until told to stop
+            break;
+        case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT: {
+            bool ok = param->scan_start_cmpl.status == ESP_BT_STATUS_SUCCESS;
+            if (!ok) {
+                ESP_LOGE(TAG, "Scan start failed: %d", param->scan_start_cmpl.status);
+            }
+            portENTER_CRITICAL(&scan_lock);
+            scan_running = ok;
+            scan_switching = false;
+            bool stale = ok && scan_fast_applied != scan_fast_wanted;
+            if (stale) {
+                scan_switching = true;
+            }
+            portEXIT_CRITICAL(&scan_lock);
+
+            // The mode changed again while this switch was in flight
+            if (stale) {
+                esp_ble_gap_stop_scanning();
+            }
+            break;
+        }
+        case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT:
+            portENTER_CRITICAL(&scan_lock);
+            scan_running = false;
+            portEXIT_CRITICAL(&scan_lock);
+            apply_scan_params();
+            break;
+        case ESP_GAP_BLE_SCAN_RESULT_EVT:
+            handle_scan_result(&param->scan_rst);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Bring up the controller in BLE mode and start the idle scan
+ */
+esp_err_t presence_backend_init(uint32_t page_timeout_ms) {
+    if (bt_initialized) return ESP_OK;
+
+    ESP_LOGI(TAG, "Initializing Bluetooth LE scanning for phone authentication");
+
+    ble_match_init(&matcher, aes128_encrypt);
+    for (int i = 0; i < presence_device_count(); i++) {
+        const presence_device_t* device = presence_device(i);
+        ble_match_add(&matcher, device->has_addr ? device->addr : NULL, device->has_irk ? device->irk : NULL);
+    }
+
+    // Classic Bluetooth is never used - give its memory back
+    if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_IDLE) {
+        esp_err_t ret = esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "BT controller Classic mem release failed: %s", esp_err_to_name(ret));
+        }
+    }
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    esp_err_t ret = esp_bt_controller_init(&bt_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "BT controller init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "BT controller enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Bluedroid init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Bluedroid enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gap_register_callback(gap_callback);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "GAP callback register failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Idle scan - PARAM_SET_COMPLETE starts it
+    portENTER_CRITICAL(&scan_lock);
+    scan_switching = true;
+    portEXIT_CRITICAL(&scan_lock);
+    apply_scan_params();
+
+    bt_initialized = true;
+    ESP_LOGI(TAG, "Passive scan running (%d/%d ms idle duty)",
+             IDLE_SCAN_WINDOW * 5 / 8, IDLE_SCAN_INTERVAL * 5 / 8);
+    return ESP_OK;
+}
+
+/**
+ * Listen at full duty until the round ends - the order does not matter to a scan
+ */
+void presence_backend_probe_start(const int* order, int count) {
+    if (bt_initialized) {
+        set_scan_fast(true);
+    }
+}
+
+/**
+ * Back to the idle duty cycle
+ */
+int presence_backend_probe_end(void) {
+    if (bt_initialized) {
+        set_scan_fast(false);
+    }
+    return 0;
+}
+
+#endif // CONFIG_DOOR_PRESENCE_BACKEND_BLE
@@ -0,0 +1,209 @@
+#include "presence_backend.h"
+
+#if CONFIG_DOOR_PRESENCE_BACKEND_NAME_REQUEST
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_bt_api.h"
+#include "trace.h"
+
+/**
+ * Presence backend paging every device with a GAP remote-name request.
+ *
+ * A phone in range answers the page and returns its name whatever
+ * profiles it accepts, and a page timeout is a definite no - there is no
+ * RFCOMM channel to open, refuse or tear down. The stack runs one name
+ * request at a time, so the devices of a round are paged back to back from
+ * the callback, and the round ends early once every one of them refused.
+ * The page timeout comes from the core's round plan (probe_plan.h), which
+ * shares the round between the devices it hands over.
+ */
+
+static const char* TAG = "PRESENCE_GAP";
+
+#define PAGE_SLOT_US 625                // Page timeout unit
+
+static bool bt_initialized = false;
+
+// Round state, guarded by gap_lock
+static portMUX_TYPE gap_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool round_open = false;
+static int round_order[PRESENCE_MAX_DEVICES];
+static int round_count = 0;
+static int round_next = 0;              // Position of the next device to page
+static int request_index = -1;          // Device whose name request is on the air
+static int64_t request_start_us = 0;
+
+/**
+ * Page the next device of the round, if the stack is free and the round still open
+ */
+static void request_next(void) {
+    while (1) {
+        portENTER_CRITICAL(&gap_lock);
+        int index = -1;
+        bool done = false;
+        if (round_open && request_index < 0) {
+            while (round_next < round_count && !presence_device(round_order[round_next])->has_addr) {
+                round_next++;   // IRK-only devices cannot be paged
+            }
+            if (round_next < round_count) {
+                index = round_order[round_next++];
+                request_index = index;
+                request_start_us = esp_timer_get_time();
+            } else {
+                done = true;
+            }
+        }
+        portEXIT_CRITICAL(&gap_lock);
+
+        if (done) {
+            presence_round_complete();
+        }
+        if (index < 0) {
+            return;
+        }
+
+        esp_bd_addr_t addr;
+        memcpy(addr, presence_device(index)->addr, sizeof(addr));
+        esp_err_t ret = esp_bt_gap_read_remote_name(addr);
+        if (ret == ESP_OK) {
+            return;
+        }
+
+        // Counts as a refusal - move on to the next device
+        ESP_LOGW(TAG, "Name request to %s failed: %s", presence_device_label(index), esp_err_to_name(ret));
+        portENTER_CRITICAL(&gap_lock);
+        request_index = -1;
+        portEXIT_CRITICAL(&gap_lock);
+    }
+}
+
+/**
+ * GAP callback - one name request finished
+ */
+static void gap_callback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t* param) {
+    if (event != ESP_BT_GAP_READ_REMOTE_NAME_EVT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&gap_lock);
+    int index = request_index;
+    long latency_ms = (long)((esp_timer_get_time() - request_start_us) / 1000);
+    request_index = -1;
+    portEXIT_CRITICAL(&gap_lock);
+
+    if (index < 0 || memcmp(presence_device(index)->addr, param->read_rmt_name.bda, sizeof(esp_bd_addr_t)) != 0) {
+        ESP_LOGW(TAG, "Name response from an unexpected device");
+    } else if (param->read_rmt_name.stat == ESP_BT_STATUS_SUCCESS) {
+        TRACE(GAP_NAME_PRESENT, index, latency_ms);
+        presence_device_seen(index, 0);
+    } else {
+        TRACE(GAP_NAME_ABSENT, index, latency_ms, param->read_rmt_name.stat);
+    }
+
+    request_next();
+}
+
+/**
+ * Bring up Classic Bluetooth with GAP only
+ */
+esp_err_t presence_backend_init(uint32_t page_timeout_ms) {
+    if (bt_initialized) return ESP_OK;
+
+    ESP_LOGI(TAG, "Initializing Bluetooth name requests for phone authentication");
+
+    // BLE is never used - give its memory back
+    if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_IDLE) {
+        esp_err_t ret = esp_bt_controller_mem_release(ESP_BT_MODE_BLE);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "BT controller BLE mem release failed: %s", esp_err_to_name(ret));
+        }
+    }
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    esp_err_t ret = esp_bt_controller_init(&bt_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "BT controller init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_CLASSIC_BT);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "BT controller enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Bluedroid init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Bluedroid enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_gap_register_callback(gap_callback);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "GAP callback register failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_gap_set_page_timeout((uint16_t)(page_timeout_ms * 1000 / PAGE_SLOT_US));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Page timeout not set: %s", esp_err_to_name(ret));
+    }
+
+    for (int i = 0; i < presence_device_count(); i++) {
+        if (!presence_device(i)->has_addr) {
+            ESP_LOGW(TAG, "%s has only an IRK - name requests need its MAC address, it will never answer",
+                     presence_device_label(i));
+        }
+    }
+
+    bt_initialized = true;
+    return ESP_OK;
+}
+
+/**
+ * Page the devices one after the other, in the order given
+ */
+void presence_backend_probe_start(const int* order, int count) {
+    if (!bt_initialized) {
+        return;
+    }
+
+    portENTER_CRITICAL(&gap_lock);
+    memcpy(round_order, order, count * sizeof(order[0]));
+    round_count = count;
+    round_next = 0;
+    round_open = true;
+    portEXIT_CRITICAL(&gap_lock);
+
+    // A request left over from the last round starts this one when it finishes
+    request_next();
+}
+
+/**
+ * Page no further devices - a request still on the air finishes on its own
+ */
+int presence_backend_probe_end(void) {
+    portENTER_CRITICAL(&gap_lock);
+    round_open = false;
+    int skipped = 0;
+    for (int i = round_next; i < round_count; i++) {
+        if (presence_device(round_order[i])->has_addr) {
+            skipped++;
+        }
+    }
+    portEXIT_CRITICAL(&gap_lock);
+    return skipped;
+}
+
+#endif // CONFIG_DOOR_PRESENCE_BACKEND_NAME_REQUEST
@@ -0,0 +1,309 @@
+#include "presence_backend.h"
+
+#if CONFIG_DOOR_PRESENCE_BACKEND_SPP
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_bt_device.h"
+#include "esp_gap_bt_api.h"
+#include "esp_spp_api.h"
+#include "trace.h"
+
+/**
+ * Presence backend paging every device with an SPP connect.
+ *
+ * Any response to the page - an open channel or a refused one - proves the
+ * phone is in range. The connects of one round are queued up front and the
+ * stack reports them back in order, so handles are matched to devices
+ * through a FIFO of attempts waiting for their ESP_SPP_CL_INIT_EVT.
+ */
+
+static const char* TAG = "PRESENCE_SPP";
+
+#define PAGE_SLOT_US 625                // Page timeout unit
+
+// Connect attempt state per device, guarded by spp_lock
+typedef struct {
+    uint32_t handle;            // SPP handle of the attempt in flight, 0 until known
+    bool in_flight;             // Connect issued and not closed yet
+} spp_attempt_t;
+
+static bool bt_initialized = false;
+static portMUX_TYPE spp_lock = portMUX_INITIALIZER_UNLOCKED;
+static spp_attempt_t attempts[PRESENCE_MAX_DEVICES];
+static bool round_open = false;         // Answers only count while a round is running
+
+// Connects waiting for their ESP_SPP_CL_INIT_EVT, in the order they were issued
+static int8_t pending_init[PRESENCE_MAX_DEVICES];
+static int pending_init_count = 0;
+
+/**
+ * Table index of the device with this address, -1 if unknown
+ */
+static int device_by_addr(const esp_bd_addr_t addr) {
+    for (int i = 0; i < presence_device_count(); i++) {
+        const presence_device_t* device = presence_device(i);
+        if (device->has_addr && memcmp(device->addr, addr, sizeof(esp_bd_addr_t)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Table index of the device whose attempt owns this SPP handle, -1 if none (lock held)
+ */
+static int device_by_handle(uint32_t handle) {
+    for (int i = 0; i < presence_device_count(); i++) {
+        if (attempts[i].in_flight && attempts[i].handle == handle) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Credit an answer to a device if a probe round is listening (Bluetooth callback context)
+ */
+static void spp_answered(int index) {
+    portENTER_CRITICAL(&spp_lock);
+    bool counted = round_open;
+    portEXIT_CRITICAL(&spp_lock);
+
+    // A page timing out after its round ended says nothing about now
+    if (counted) {
+        presence_device_seen(index, 0);
+    }
+}
+
+/**
+ * SPP callback function
+ */
+static void spp_callback(esp_spp_cb_event_t event, esp_spp_cb_param_t *param) {
+    switch (event) {
+        case ESP_SPP_INIT_EVT:
+            TRACE(SPP_READY);
+            break;
+        case ESP_SPP_CL_INIT_EVT: {
+            // Pair the handle with the oldest connect still waiting for one
+            portENTER_CRITICAL(&spp_lock);
+            int index = -1;
+            if (pending_init_count > 0) {
+                index = pending_init[0];
+                pending_init_count--;
+                memmove(pending_init, &pending_init[1], pending_init_count);
+                if (param->cl_init.status == ESP_SPP_SUCCESS) {
+                    attempts[index].handle = param->cl_init.handle;
+                } else {
+                    attempts[index].in_flight = false;
+                }
+            }
+            portEXIT_CRITICAL(&spp_lock);
+            break;
+        }
+        case ESP_SPP_OPEN_EVT: {
+            int index = device_by_addr(param->open.rem_bda);
+            TRACE(SPP_OPEN, index, param->open.status);
+            if (param->open.status == ESP_SPP_SUCCESS) {
+                // Presence is all we wanted - hang up right away
+                esp_spp_disconnect(param->open.handle);
+            }
+            spp_answered(index);  // Any response means the device is present
+            break;
+        }
+        case ESP_SPP_CLOSE_EVT: {
+            portENTER_CRITICAL(&spp_lock);
+            int index = device_by_handle(param->close.handle);
+            if (index >= 0) {
+                attempts[index].in_flight = false;
+                attempts[index].handle = 0;
+            }
+            portEXIT_CRITICAL(&spp_lock);
+
+            TRACE(SPP_CLOSE, index, param->close.handle);
+            // Only count as authenticated if we had a real connection attempt
+            if (param->close.handle != 0) {
+                spp_answered(index);  // Connection attempt got a response, device is present
+            }
+            break;
+        }
+        case ESP_SPP_CONG_EVT:
+            TRACE(SPP_CONGESTED, param->cong.cong);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Initialize Bluetooth SPP
+ */
+esp_err_t presence_backend_init(uint32_t page_timeout_ms) {
+    if (bt_initialized) return ESP_OK;
+
+    ESP_LOGI(TAG, "Initializing Bluetooth SPP for phone authentication");
+
+    // Check current controller status
+    esp_bt_controller_status_t status = esp_bt_controller_get_status();
+
+    // Release BLE memory to save RAM (only if controller is in IDLE state)
+    if (status == ESP_BT_CONTROLLER_STATUS_IDLE) {
+        esp_err_t ret = esp_bt_controller_mem_release(ESP_BT_MODE_BLE);
+        TRACE(BT_MEM_RELEASED, ret);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "BT controller BLE mem release failed: %s", esp_err_to_name(ret));
+        }
+    } else {
+        ESP_LOGW(TAG, "Skipping BLE memory release - controller not in IDLE state");
+    }
+
+    // Initialize BT controller
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+
+    // Try absolute defaults first to isolate the issue
+    // bt_cfg.controller_task_stack_size = 3072;  // Commented out for testing
+    // bt_cfg.controller_task_prio = 20;          // Commented out for testing
+    TRACE(BT_CONTROLLER_CONFIG, status, bt_cfg.controller_task_stack_size, bt_cfg.controller_task_prio, bt_cfg.mode);
+
+    esp_err_t ret = esp_bt_controller_init(&bt_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "BT controller init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    TRACE(BT_CONTROLLER_INIT);
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_CLASSIC_BT);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "BT controller enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    TRACE(BT_CONTROLLER_ENABLED);
+
+    // Initialize Bluedroid stack
+    ret = esp_bluedroid_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Bluedroid init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    TRACE(BLUEDROID_INIT);
+
+    ret = esp_bluedroid_enable();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Bluedroid enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    TRACE(BLUEDROID_ENABLED);
+
+    // Initialize SPP (now that Bluedroid is ready)
+    ret = esp_spp_register_callback(spp_callback);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "SPP callback register failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    TRACE(SPP_CALLBACK_REGISTERED);
+
+    ret = esp_spp_init(ESP_SPP_MODE_CB);  // Use older, stable API instead of enhanced
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "SPP init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    TRACE(SPP_INIT);
+
+    // The connects of a round are paged one after the other - share the round between them
+    ret = esp_bt_gap_set_page_timeout((uint16_t)(page_timeout_ms * 1000 / PAGE_SLOT_US));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Page timeout not set: %s", esp_err_to_name(ret));
+    }
+
+    for (int i = 0; i < presence_device_count(); i++) {
+        if (!presence_device(i)->has_addr) {
+            ESP_LOGW(TAG, "%s has only an IRK - SPP needs its MAC address, it will never answer",
+                     presence_device_label(i));
+        }
+    }
+
+    bt_initialized = true;
+    ESP_LOGI(TAG, "Bluetooth SPP initialization completed successfully!");
+    return ESP_OK;
+}
+
+/**
+ * Remove a connect that never reached the stack from the CL_INIT queue (lock held)
+ */
+static void pending_init_remove(int index) {
+    for (int i = pending_init_count - 1; i >= 0; i--) {
+        if (pending_init[i] == index) {
+            pending_init_count--;
+            memmove(&pending_init[i], &pending_init[i + 1], pending_init_count - i);
+            return;
+        }
+    }
+}
+
+/**
+ * Page the devices of the round, in the order given - the controller pages one at a time,
+ * so queueing every connect up front lets it move on to the next page without
+ * a trip through the presence task
+ */
+void presence_backend_probe_start(const int* order, int count) {
+    if (!bt_initialized) {
+        return;
+    }
+
+    portENTER_CRITICAL(&spp_lock);
+    round_open = true;
+    portEXIT_CRITICAL(&spp_lock);
+
+    for (int i = 0; i < count; i++) {
+        int index = order[i];
+        const presence_device_t* device = presence_device(index);
+        if (!device->has_addr) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&spp_lock);
+        bool busy = attempts[index].in_flight;  // Still paging from an earlier round
+        if (!busy) {
+            attempts[index].in_flight = true;
+            attempts[index].handle = 0;
+            pending_init[pending_init_count++] = (int8_t)index;
+        }
+        portEXIT_CRITICAL(&spp_lock);
+        if (busy) {
+            continue;
+        }
+
+        esp_bd_addr_t addr;
+        memcpy(addr, device->addr, sizeof(addr));
+        esp_err_t ret = esp_spp_connect(ESP_SPP_SEC_NONE, ESP_SPP_ROLE_MASTER, 1, addr);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "SPP connect to %s failed: %s", presence_device_label(index), esp_err_to_name(ret));
+            portENTER_CRITICAL(&spp_lock);
+            attempts[index].in_flight = false;
+            pending_init_remove(index);
+            portEXIT_CRITICAL(&spp_lock);
+        }
+    }
+}
+
+/**
+ * Stop crediting answers - pages still in flight finish on their own
+ * @return connects queued behind the one being paged
+ */
+int presence_backend_probe_end(void) {
+    portENTER_CRITICAL(&spp_lock);
+    round_open = false;
+    int in_flight = 0;
+    for (int i = 0; i < presence_device_count(); i++) {
+        if (attempts[i].in_flight) {
+            in_flight++;
+        }
+    }
+    portEXIT_CRITICAL(&spp_lock);
+    return (in_flight > 1) ? in_flight - 1 : 0;
+}
+
+#endif // CONFIG_DOOR_PRESENCE_BACKEND_SPP
@@ -0,0 +1,98 @@
+#include "probe_plan.h"
+
+/**
+ * Plan rounds over the devices with probe[i] set
+ */
+void probe_plan_init(probe_plan_t* plan, const bool* probe, int count, uint32_t round_ms, bool paged) {
+    plan->candidate_count = 0;
+    plan->cursor = 0;
+    for (int i = 0; i < count && i < PROBE_PLAN_MAX_DEVICES; i++) {
+        if (probe[i]) {
+            plan->candidates[plan->candidate_count++] = i;
+        }
+    }
+    int n = plan->candidate_count;
+
+    if (!paged) {
+        plan->page_ms = 0;
+        plan->per_round = n;
+        plan->rounds_to_cover = 1;
+        return;
+    }
+
+    // Share the round between the devices, but never below one page scan interval
+    uint32_t page_ms = (n > 0) ? round_ms / (uint32_t)n : PROBE_PLAN_MAX_PAGE_MS;
+    if (page_ms < PROBE_PLAN_MIN_PAGE_MS) {
+        page_ms = PROBE_PLAN_MIN_PAGE_MS;
+    } else if (page_ms > PROBE_PLAN_MAX_PAGE_MS) {
+        page_ms = PROBE_PLAN_MAX_PAGE_MS;
+    }
+    plan->page_ms = page_ms;
+
+    int per_round = (int)(round_ms / page_ms);
+    plan->per_round = (per_round < 1) ? 1 : (per_round > n) ? n : per_round;
+
+    // Worst case the most recent device takes a slot of every round
+    if (n <= plan->per_round) {
+        plan->rounds_to_cover = 1;
+    } else {
+        int rotating = (plan->per_round >= 2) ? plan->per_round - 1 : 1;
+        plan->rounds_to_cover = (n + rotating - 1) / rotating;
+    }
+}
+
+/**
+ * Sort device indices by last answer, most recent first, keeping table order on ties
+ */
+static void sort_by_recency(int* order, int count, const time_t* last_seen) {
+    for (int i = 1; i < count; i++) {
+        int index = order[i];
+        int j = i;
+        while (j > 0 && last_seen[order[j - 1]] < last_seen[index]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = index;
+    }
+}
+
+/**
+ * Order of the next round
+ */
+int probe_plan_next(probe_plan_t* plan, const time_t* last_seen, int* order) {
+    int n = plan->candidate_count;
+    if (n <= plan->per_round) {
+        for (int i = 0; i < n; i++) {
+            order[i] = plan->candidates[i];
+        }
+        sort_by_recency(order, n, last_seen);
+        return n;
+    }
+
+    // The device seen last goes first - it is the likeliest to answer
+    int first = -1;
+    if (plan->per_round >= 2) {
+        for (int i = 0; i < n; i++) {
+            int index = plan->candidates[i];
+            if (last_seen[index] != 0 && (first < 0 || last_seen[index] > last_seen[first])) {
+                first = index;
+            }
+        }
+    }
+    int count = 0;
+    if (first >= 0) {
+        order[count++] = first;
+    }
+
+    // The other slots go round-robin, so the rest of the table gets its turn
+    int picked = count;
+    for (int steps = 0; steps < n && count < plan->per_round; steps++) {
+        int index = plan->candidates[plan->cursor];
+        plan->cursor = (plan->cursor + 1) % n;
+        if (index != first) {
+            order[count++] = index;
+        }
+    }
+    sort_by_recency(&order[picked], count - picked, last_seen);
+    return count;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+/**
+ * Which authorized devices a presence probe round pages, and in what order.
+ *
+ * A Classic backend pages one device at a time and an absent phone holds
+ * the radio for the whole page timeout, so a round of fixed length reaches
+ * only so many devices. The page timeout is shortened to share the round
+ * between the devices, down to one page scan interval of a phone. If they
+ * still do not all fit, each round pages the device seen most recently and
+ * fills the rest round-robin from the device table, so every device - one
+ * never seen before too - is paged within rounds_to_cover rounds.
+ * A backend that only listens gets every device every round, most recently
+ * seen first.
+ * Pure C with no ESP-IDF dependencies so round plans can be checked on a host.
+ */
+
+#define PROBE_PLAN_MAX_DEVICES 8
+#define PROBE_PLAN_MIN_PAGE_MS 1280     // A phone in page scan mode R1 listens every 1.28 s
+#define PROBE_PLAN_MAX_PAGE_MS 2000     // Longer buys nothing once R1 is covered
+
+typedef struct {
+    int candidates[PROBE_PLAN_MAX_DEVICES];     // Device table indices worth probing, in table order
+    int candidate_count;
+    uint32_t page_ms;           // Page timeout per device, 0 if the backend only listens
+    int per_round;              // Devices a round has time for
+    int rounds_to_cover;        // Rounds without an answer until every device was paged
+    int cursor;                 // Next candidate of the round-robin part
+} probe_plan_t;
+
+/**
+ * Plan rounds over the devices with probe[i] set
+ * @param round_ms Length of a probe round
+ * @param paged Whether the backend pages devices one at a time
+ */
+void probe_plan_init(probe_plan_t* plan, const bool* probe, int count, uint32_t round_ms, bool paged);
+
+/**
+ * Order of the next round
+ * @param last_seen Wall clock of each device's last answer, 0 if never
+ * @param order Filled with device table indices, the likeliest to answer first
+ * @return number of devices in order, at most per_round
+ */
+int probe_plan_next(probe_plan_t* plan, const time_t* last_seen, int* order);
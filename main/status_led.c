@@ -0,0 +1,138 @@
+#include "status_led.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#define LED_PATTERN_QUEUE_LEN 8
+
+static const char* TAG = "STATUS_LED";
+
+// Pattern steps in ms, alternating on/off, terminated by 0
+static const uint16_t pattern_open[] = {200, 200, 0};
+static const uint16_t pattern_close[] = {200, 200, 200, 200, 0};
+static const uint16_t pattern_unauthenticated[] = {80, 80, 80, 80, 80, 80, 0};
+static const uint16_t pattern_offline[] = {1000, 300, 0};
+static const uint16_t pattern_queue_backlog[] = {40, 120, 40, 400, 0};
+
+static const uint16_t* const pattern_steps[LED_PATTERN_COUNT] = {
+    [LED_PATTERN_OPEN] = pattern_open,
+    [LED_PATTERN_CLOSE] = pattern_close,
+    [LED_PATTERN_UNAUTHENTICATED] = pattern_unauthenticated,
+    [LED_PATTERN_OFFLINE] = pattern_offline,
+    [LED_PATTERN_QUEUE_BACKLOG] = pattern_queue_backlog,
+};
+
+static gpio_num_t led_pin = GPIO_NUM_NC;
+static esp_timer_handle_t led_timer = NULL;
+static portMUX_TYPE led_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Pending patterns and playback state, guarded by led_lock
+static led_pattern_t pending_patterns[LED_PATTERN_QUEUE_LEN];
+static int pending_head = 0;
+static int pending_count = 0;
+static const uint16_t* active_steps = NULL;
+static int active_step = 0;
+static bool led_running = false;
+
+/**
+ * Advance to the next step, pulling the next queued pattern when needed
+ * @return false once every queued pattern has been played
+ */
+static bool led_next_step(bool* on, uint32_t* duration_ms) {
+    bool has_step = false;
+
+    portENTER_CRITICAL(&led_lock);
+    while (!has_step) {
+        if (active_steps != NULL && active_steps[active_step] != 0) {
+            *on = (active_step % 2) == 0;
+            *duration_ms = active_steps[active_step];
+            active_step++;
+            has_step = true;
+        } else if (pending_count > 0) {
+            active_steps = pattern_steps[pending_patterns[pending_head]];
+            active_step = 0;
+            pending_head = (pending_head + 1) % LED_PATTERN_QUEUE_LEN;
+            pending_count--;
+        } else {
+            active_steps = NULL;
+            led_running = false;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&led_lock);
+
+    return has_step;
+}
+
+/**
+ * Timer callback - drive the LED for the next step and re-arm the timer
+ */
+static void led_timer_callback(void* arg) {
+    bool on = false;
+    uint32_t duration_ms = 0;
+
+    if (led_next_step(&on, &duration_ms)) {
+        gpio_set_level(led_pin, on ? 1 : 0);
+        esp_timer_start_once(led_timer, (uint64_t)duration_ms * 1000);
+    } else {
+        gpio_set_level(led_pin, 0);
+    }
+}
+
+/**
+ * Configure the LED pin and create the pattern timer
+ */
+esp_err_t status_led_init(gpio_num_t pin) {
+    gpio_config_t led_config = {
+        .pin_bit_mask = (1ULL << pin),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    esp_err_t ret = gpio_config(&led_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Initialize LED to off state
+    led_pin = pin;
+    gpio_set_level(led_pin, 0);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = led_timer_callback,
+        .name = "status_led",
+    };
+    return esp_timer_create(&timer_args, &led_timer);
+}
+
+/**
+ * Queue a pattern for playback and return immediately
+ */
+bool status_led_request(led_pattern_t pattern) {
+    if (led_timer == NULL || pattern >= LED_PATTERN_COUNT) {
+        return false;
+    }
+
+    bool start_timer = false;
+
+    portENTER_CRITICAL(&led_lock);
+    if (pending_count >= LED_PATTERN_QUEUE_LEN) {
+        portEXIT_CRITICAL(&led_lock);
+        ESP_LOGD(TAG, "Pattern queue full, dropping pattern %d", pattern);
+        return false;
+    }
+    pending_patterns[(pending_head + pending_count) % LED_PATTERN_QUEUE_LEN] = pattern;
+    pending_count++;
+    if (!led_running) {
+        led_running = true;
+        start_timer = true;
+    }
+    portEXIT_CRITICAL(&led_lock);
+
+    // All LED updates happen in the timer callback, so just kick it
+    if (start_timer) {
+        esp_timer_start_once(led_timer, 0);
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+/**
+ * Asynchronous status LED pattern engine.
+ *
+ * Patterns are queued and played back from an esp_timer callback, so
+ * requesting one never blocks the caller.
+ */
+
+typedef enum {
+    LED_PATTERN_OPEN,               // One blink - door opened
+    LED_PATTERN_CLOSE,              // Two blinks - door closed
+    LED_PATTERN_UNAUTHENTICATED,    // Three fast blinks - phone not found
+    LED_PATTERN_OFFLINE,            // One long blink - WiFi lost
+    LED_PATTERN_QUEUE_BACKLOG,      // Short flicker - notification queued for retry
+    LED_PATTERN_COUNT
+} led_pattern_t;
+
+/**
+ * Configure the LED pin and create the pattern timer
+ */
+esp_err_t status_led_init(gpio_num_t pin);
+
+/**
+ * Queue a pattern for playback and return immediately
+ * @return false if the pattern queue is full and the request was dropped
+ */
+bool status_led_request(led_pattern_t pattern);
@@ -0,0 +1,298 @@
+#include "time_sync.h"
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_sntp.h"
+#include "mem_report.h"
+
+// NTP Configuration
+#define NTP_SERVER "pool.ntp.org"
+#define TIMEZONE "PST8PDT,M3.2.0/2,M11.1.0"  // Pacific Time - change as needed
+
+// Sync task Configuration
+#define TIME_SYNC_TASK_STACK_SIZE 3072
+#define TIME_SYNC_TASK_PRIORITY 2
+#define TIME_SYNC_RETRY_MS 60000            // Ask again when a due sync got no answer
+#define TIME_SYNC_STEP_THRESHOLD_MS 5000    // Larger offsets are stepped, slewing would take too long
+
+MEM_TASK_STACK(time_sync_stack, TIME_SYNC_TASK_STACK_SIZE);
+
+// Task notification bits
+#define ONLINE_BIT (1UL << 0)
+#define SYNC_BIT   (1UL << 1)
+
+// Event group bit - set once the clock has been synced
+#define SYNCED_BIT BIT0
+
+static const char* TAG = "TIME_SYNC";
+
+// Drift estimate, kept through deep sleep (zeroed on power-on: never synced)
+static RTC_DATA_ATTR clock_drift_t drift;
+static portMUX_TYPE drift_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Last sync reported by the SNTP callback, guarded by drift_lock
+static struct {
+    bool valid;
+    bool slewed;                // Smooth sync started adjtime() - the local clock was not stepped
+    int64_t local_us;
+    int64_t reference_us;
+} landed;
+
+static TaskHandle_t sync_task_handle = NULL;
+static EventGroupHandle_t sync_events = NULL;
+static volatile bool network_online = false;
+
+// Sync task state
+static bool sntp_running = false;
+static int64_t requested_us = 0;    // Monotonic time of the unanswered request, 0 if none
+
+/**
+ * Current wall clock time in microseconds
+ */
+static int64_t wall_time_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/**
+ * SNTP callback (lwIP task) - note the offset and leave the bookkeeping to the sync task
+ */
+static void on_time_sync(struct timeval* tv) {
+    int64_t local_us = wall_time_us();
+    int64_t reference_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    bool slewed = sntp_get_sync_status() == SNTP_SYNC_STATUS_IN_PROGRESS;
+
+    portENTER_CRITICAL(&drift_lock);
+    landed.valid = true;
+    landed.slewed = slewed;
+    landed.local_us = local_us;
+    landed.reference_us = reference_us;
+    portEXIT_CRITICAL(&drift_lock);
+
+    if (sync_task_handle != NULL) {
+        xTaskNotify(sync_task_handle, SYNC_BIT, eSetBits);
+    }
+}
+
+/**
+ * Fold a landed sync into the drift estimate
+ */
+static void record_sync(void) {
+    portENTER_CRITICAL(&drift_lock);
+    bool valid = landed.valid;
+    bool slewed = landed.slewed;
+    int64_t local_us = landed.local_us;
+    int64_t reference_us = landed.reference_us;
+    landed.valid = false;
+    portEXIT_CRITICAL(&drift_lock);
+    if (!valid) {
+        return;
+    }
+
+    int64_t offset_us = reference_us - local_us;
+    if (slewed && llabs(offset_us) > (int64_t)TIME_SYNC_STEP_THRESHOLD_MS * 1000) {
+        // Cancel the slew and step instead, keeping the time that passed since the callback
+        struct timeval zero = { 0 };
+        adjtime(&zero, NULL);
+        int64_t now_us = wall_time_us() + offset_us;
+        struct timeval tv = { .tv_sec = (time_t)(now_us / 1000000), .tv_usec = (suseconds_t)(now_us % 1000000) };
+        settimeofday(&tv, NULL);
+    }
+
+    portENTER_CRITICAL(&drift_lock);
+    bool first = drift.last_sync_us == 0;
+    clock_drift_sync(&drift, local_us, reference_us, slewed);
+    clock_drift_t snapshot = drift;
+    portEXIT_CRITICAL(&drift_lock);
+
+    requested_us = 0;
+    xEventGroupSetBits(sync_events, SYNCED_BIT);
+
+    if (first || !slewed) {
+        time_t now = (time_t)(reference_us / 1000000);
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
+        char strftime_buf[64];
+        strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
+        ESP_LOGI(TAG, "Clock set: %s", strftime_buf);
+    } else {
+        ESP_LOGI(TAG, "Clock off by %ld ms, slewing", (long)(offset_us / 1000));
+    }
+    ESP_LOGI(TAG, "Drift %ld ppb (%u samples), next sync in %ld s",
+             (long)snapshot.drift_ppb, (unsigned)snapshot.samples,
+             (long)((clock_drift_next_sync_us(&snapshot) - reference_us) / 1000000));
+}
+
+/**
+ * Whether a sync request should go out now
+ */
+static bool sync_due(void) {
+    if (!network_online) {
+        return false;
+    }
+    if (requested_us != 0) {
+        return esp_timer_get_time() - requested_us >= (int64_t)TIME_SYNC_RETRY_MS * 1000;
+    }
+
+    portENTER_CRITICAL(&drift_lock);
+    int64_t due_us = clock_drift_next_sync_us(&drift);
+    portEXIT_CRITICAL(&drift_lock);
+    return wall_time_us() >= due_us;
+}
+
+/**
+ * Send an SNTP request - starts SNTP on first use
+ */
+static void request_sync(void) {
+    if (!sntp_running) {
+        esp_sntp_init();
+        sntp_running = true;
+    } else {
+        esp_sntp_restart();
+    }
+    requested_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Requesting time from %s", NTP_SERVER);
+}
+
+/**
+ * How long the sync task may sleep before a resync could be due
+ */
+static TickType_t sync_wait_ticks(void) {
+    if (!network_online) {
+        return portMAX_DELAY;
+    }
+
+    int64_t wait_ms;
+    if (requested_us != 0) {
+        wait_ms = TIME_SYNC_RETRY_MS - (esp_timer_get_time() - requested_us) / 1000;
+    } else {
+        portENTER_CRITICAL(&drift_lock);
+        int64_t due_us = clock_drift_next_sync_us(&drift);
+        portEXIT_CRITICAL(&drift_lock);
+        wait_ms = (due_us - wall_time_us()) / 1000;
+    }
+
+    // Wake at least hourly in case the wall clock was stepped meanwhile
+    if (wait_ms > 3600 * 1000) {
+        wait_ms = 3600 * 1000;
+    }
+    return (wait_ms > 0) ? pdMS_TO_TICKS(wait_ms) + 1 : 0;
+}
+
+/**
+ * Sync task - the only place that drives SNTP
+ */
+static void time_sync_task(void* arg) {
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, ULONG_MAX, &bits, sync_wait_ticks());
+
+        if (bits & SYNC_BIT) {
+            record_sync();
+        }
+        if (sync_due()) {
+            request_sync();
+        } else if ((bits & ONLINE_BIT) && network_online && requested_us == 0) {
+            ESP_LOGI(TAG, "Clock within %lu ms tolerance - resync skipped", (unsigned long)drift.tolerance_ms);
+        }
+    }
+}
+
+/**
+ * Set the timezone, configure SNTP and start the sync task
+ */
+esp_err_t time_sync_start(void) {
+    setenv("TZ", TIMEZONE, 1);
+    tzset();
+
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED) {
+        // Power-on or reset - only a deep sleep wake keeps the estimate
+        clock_drift_init(&drift, CONFIG_DOOR_TIME_TOLERANCE_MS);
+    }
+    drift.tolerance_ms = CONFIG_DOOR_TIME_TOLERANCE_MS;
+
+#if CONFIG_DOOR_STATIC_ALLOCATION
+    static StaticEventGroup_t sync_events_buffer;
+    sync_events = xEventGroupCreateStatic(&sync_events_buffer);
+#else
+    sync_events = xEventGroupCreate();
+#endif
+    if (sync_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (drift.last_sync_us != 0) {
+        // Woke from deep sleep - the RTC kept the clock running
+        xEventGroupSetBits(sync_events, SYNCED_BIT);
+    }
+
+    // Small offsets are slewed; lwIP's own polling is only a fallback behind the schedule here
+    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, NTP_SERVER);
+    esp_sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
+    esp_sntp_set_time_sync_notification_cb(on_time_sync);
+    sntp_set_sync_interval((uint32_t)CLOCK_DRIFT_MAX_INTERVAL_S * 1000);
+
+    if (mem_task_create(time_sync_task, "time_sync", TIME_SYNC_TASK_STACK_SIZE, NULL,
+                        TIME_SYNC_TASK_PRIORITY, &sync_task_handle, MEM_TASK_BUFFERS(time_sync_stack)) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create time sync task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Tell the sync task whether the network is usable
+ */
+void time_sync_set_online(bool online) {
+    network_online = online;
+    if (online && sync_task_handle != NULL) {
+        xTaskNotify(sync_task_handle, ONLINE_BIT, eSetBits);
+    }
+}
+
+/**
+ * Wait until the clock has been synced at least once
+ */
+bool time_sync_wait(uint32_t timeout_ms) {
+    if (sync_events == NULL) {
+        return false;
+    }
+    EventBits_t bits = xEventGroupWaitBits(sync_events, SYNCED_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & SYNCED_BIT) != 0;
+}
+
+/**
+ * Quality of a timestamp taken now
+ */
+time_quality_t time_sync_quality(void) {
+    int64_t now_us = wall_time_us();
+    portENTER_CRITICAL(&drift_lock);
+    time_quality_t quality = clock_drift_quality(&drift, now_us);
+    portEXIT_CRITICAL(&drift_lock);
+    return quality;
+}
+
+/**
+ * Short name for a timestamp quality
+ */
+const char* time_sync_quality_name(time_quality_t quality) {
+    switch (quality) {
+        case TIME_QUALITY_SYNCED:
+            return "synced";
+        case TIME_QUALITY_DRIFTING:
+            return "drifting";
+        case TIME_QUALITY_UNSYNCED:
+            return "unsynced";
+        default:
+            return "unknown";
+    }
+}
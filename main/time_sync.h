@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "clock_drift.h"
+
+/**
+ * Background wall clock sync over SNTP.
+ *
+ * A dedicated task owns SNTP so nothing else ever waits on it. Syncs use
+ * smooth mode: small offsets are slewed with adjtime() instead of stepping
+ * the clock under running timers, and only the first sync (or a huge
+ * offset) steps it. Each sync feeds a drift estimate (clock_drift.h) that
+ * schedules the next one, and reconnects skip the resync while the clock
+ * is still within tolerance. The estimate is kept in RTC memory so it
+ * carries over deep sleep.
+ */
+
+/**
+ * Set the timezone, configure SNTP and start the sync task
+ */
+esp_err_t time_sync_start(void);
+
+/**
+ * Tell the sync task whether the network is usable - a resync starts once
+ * it is and one is due
+ */
+void time_sync_set_online(bool online);
+
+/**
+ * Wait until the clock has been synced at least once
+ * @return false on timeout
+ */
+bool time_sync_wait(uint32_t timeout_ms);
+
+/**
+ * Quality of a timestamp taken now
+ */
+time_quality_t time_sync_quality(void);
+
+/**
+ * Short name for a timestamp quality
+ */
+const char* time_sync_quality_name(time_quality_t quality);
@@ -0,0 +1,193 @@
+#include "trace.h"
+#include "sdkconfig.h"
+
+#if CONFIG_DOOR_TRACE
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mem_report.h"
+#if CONFIG_ESP_CONSOLE_UART
+#include "driver/uart.h"
+#endif
+
+// Console Configuration
+#define TRACE_CONSOLE_UART CONFIG_ESP_CONSOLE_UART_NUM
+#define TRACE_CONSOLE_RX_BUFFER 256
+#define TRACE_CONSOLE_TASK_STACK_SIZE 3072
+#define TRACE_CONSOLE_TASK_PRIORITY 1
+#define TRACE_DUMP_WORDS_PER_LINE 8
+
+static const char* TAG = "TRACE";
+
+static uint32_t trace_words[CONFIG_DOOR_TRACE_BUFFER_SIZE / sizeof(uint32_t)];
+static trace_ring_t ring;
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Set up the ring - records written before this are dropped
+ */
+void trace_init(void) {
+    portENTER_CRITICAL(&trace_lock);
+    trace_ring_init(&ring, trace_words, sizeof(trace_words) / sizeof(uint32_t));
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+/**
+ * Append a record (any task or ISR)
+ */
+void trace_write(uint16_t id, const uint32_t* args, unsigned nargs) {
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&trace_lock);
+    if (ring.words != NULL) {
+        trace_ring_write(&ring, now_us, id, args, nargs);
+    }
+    portEXIT_CRITICAL_SAFE(&trace_lock);
+}
+
+/**
+ * Start a dump of everything recorded so far
+ */
+void trace_dump_begin(trace_cursor_t* dump, uint32_t header[TRACE_DUMP_HEADER_WORDS]) {
+    uint64_t now_us = (uint64_t)esp_timer_get_time();
+    portENTER_CRITICAL(&trace_lock);
+    dump->cursor = ring.tail;
+    dump->end = ring.head;
+    header[4] = ring.overwritten;
+    portEXIT_CRITICAL(&trace_lock);
+
+    header[0] = TRACE_DUMP_MAGIC;
+    header[1] = TRACE_EVENT_COUNT;
+    header[2] = (uint32_t)now_us;
+    header[3] = (uint32_t)(now_us >> 32);
+}
+
+/**
+ * Next whole records of a dump
+ */
+size_t trace_dump_next(trace_cursor_t* dump, uint32_t* out, size_t max_words) {
+    portENTER_CRITICAL(&trace_lock);
+    size_t copied = (ring.words != NULL) ? trace_ring_read(&ring, &dump->cursor, dump->end, out, max_words) : 0;
+    portEXIT_CRITICAL(&trace_lock);
+    return copied;
+}
+
+#if CONFIG_DOOR_TRACE_CONSOLE && CONFIG_ESP_CONSOLE_UART
+
+MEM_TASK_STACK(trace_console_stack, TRACE_CONSOLE_TASK_STACK_SIZE);
+
+/**
+ * Print words as one line of hex for the host decoder
+ */
+static void print_hex_line(const uint32_t* words, size_t count) {
+    char line[TRACE_DUMP_WORDS_PER_LINE * 9 + 1];
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s%08lx", (i > 0) ? " " : "", (unsigned long)words[i]);
+    }
+    printf("%s\n", line);
+}
+
+/**
+ * Write the ring to the console between markers host/trace_decode looks for
+ */
+static void dump_to_console(void) {
+    trace_cursor_t dump;
+    uint32_t header[TRACE_DUMP_HEADER_WORDS];
+    trace_dump_begin(&dump, header);
+
+    printf("=== TRACE BEGIN ===\n");
+    print_hex_line(header, TRACE_DUMP_HEADER_WORDS);
+
+    // Whole records are read together, but lines need not end on a record
+    uint32_t words[TRACE_DUMP_WORDS_PER_LINE + TRACE_RING_RECORD_MAX_WORDS];
+    size_t pending = 0;
+    size_t copied;
+    do {
+        copied = trace_dump_next(&dump, words + pending, TRACE_RING_RECORD_MAX_WORDS);
+        pending += copied;
+        while (pending >= TRACE_DUMP_WORDS_PER_LINE || (copied == 0 && pending > 0)) {
+            size_t count = (pending < TRACE_DUMP_WORDS_PER_LINE) ? pending : TRACE_DUMP_WORDS_PER_LINE;
+            print_hex_line(words, count);
+            pending -= count;
+            memmove(words, words + count, pending * sizeof(uint32_t));
+        }
+    } while (copied > 0);
+
+    printf("=== TRACE END ===\n");
+    fflush(stdout);
+}
+
+/**
+ * Run one console command line
+ */
+static void handle_command(const char* line) {
+    if (strcmp(line, "trace") == 0) {
+        dump_to_console();
+    } else if (strcmp(line, "trace clear") == 0) {
+        trace_init();
+        ESP_LOGI(TAG, "Trace cleared");
+    }
+}
+
+/**
+ * Console task - reads command lines from the console UART
+ */
+static void trace_console_task(void* arg) {
+    char line[16];
+    size_t len = 0;
+
+    while (1) {
+        uint8_t c;
+        if (uart_read_bytes(TRACE_CONSOLE_UART, &c, 1, portMAX_DELAY) != 1) {
+            continue;
+        }
+        if (c == '\r' || c == '\n') {
+            line[len] = '\0';
+            if (len > 0) {
+                handle_command(line);
+            }
+            len = 0;
+        } else if (len < sizeof(line) - 1) {
+            line[len++] = (char)c;
+        }
+    }
+}
+
+/**
+ * Listen for the "trace" and "trace clear" commands on the console UART
+ */
+esp_err_t trace_console_start(void) {
+    if (!uart_is_driver_installed(TRACE_CONSOLE_UART)) {
+        esp_err_t err = uart_driver_install(TRACE_CONSOLE_UART, TRACE_CONSOLE_RX_BUFFER, 0, 0, NULL, 0);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Console UART driver install failed: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    if (mem_task_create(trace_console_task, "trace_console", TRACE_CONSOLE_TASK_STACK_SIZE, NULL,
+                        TRACE_CONSOLE_TASK_PRIORITY, NULL, MEM_TASK_BUFFERS(trace_console_stack)) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create trace console task");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Type 'trace' on the console to dump the trace log (%u bytes)",
+             (unsigned)(sizeof(trace_words)));
+    return ESP_OK;
+}
+
+#else
+
+/**
+ * No UART console to listen on
+ */
+esp_err_t trace_console_start(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_DOOR_TRACE_CONSOLE && CONFIG_ESP_CONSOLE_UART
+
+#endif // CONFIG_DOOR_TRACE
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "trace_events.h"
+#include "trace_ring.h"
+
+/**
+ * Binary trace log for hot-path diagnostics.
+ *
+ * TRACE(EVENT, args...) stores the event ID, a microsecond timestamp and
+ * up to four raw 32-bit arguments in a RAM ring - no formatting and no
+ * UART output, so it is cheap enough for callbacks and tight loops and can
+ * stay on in production. Events and their format strings are listed in
+ * trace_events.h. The ring is read out on demand, over the console UART
+ * ("trace" command) or GET /trace on the metrics server, and turned back
+ * into text on the host by host/trace_decode.
+ */
+
+#define TRACE_ARGS(...) ((const uint32_t[]){ 0, ##__VA_ARGS__ })
+
+#if CONFIG_DOOR_TRACE
+#define TRACE(event, ...) \
+    trace_write(TRACE_##event, TRACE_ARGS(__VA_ARGS__) + 1, sizeof(TRACE_ARGS(__VA_ARGS__)) / sizeof(uint32_t) - 1)
+#else
+// Arguments are not evaluated, only referenced so they do not become unused
+#define TRACE(event, ...) ((void)sizeof(TRACE_ARGS(__VA_ARGS__)))
+#endif
+
+// Position of a dump in progress
+typedef struct {
+    uint32_t cursor;
+    uint32_t end;
+} trace_cursor_t;
+
+/**
+ * Set up the ring - records written before this are dropped
+ */
+void trace_init(void);
+
+/**
+ * Append a record (any task or ISR) - use the TRACE() macro
+ */
+void trace_write(uint16_t id, const uint32_t* args, unsigned nargs);
+
+/**
+ * Start a dump of everything recorded so far
+ * @param header Filled with the TRACE_DUMP_HEADER_WORDS dump header
+ */
+void trace_dump_begin(trace_cursor_t* dump, uint32_t header[TRACE_DUMP_HEADER_WORDS]);
+
+/**
+ * Next whole records of a dump
+ * @return Words copied, 0 once the dump is complete
+ */
+size_t trace_dump_next(trace_cursor_t* dump, uint32_t* out, size_t max_words);
+
+/**
+ * Listen for the "trace" and "trace clear" commands on the console UART
+ */
+esp_err_t trace_console_start(void);
@@ -0,0 +1,59 @@
+#pragma once
+
+/**
+ * Trace event table shared by the firmware and the host decoder.
+ *
+ * The firmware only uses the ID; the format string is compiled into the
+ * host decoder alone, so trace points cost no flash for their text. Each
+ * argument is stored as 32 bits, so formats may only use %d, %u, %x, %X
+ * and %c (with flags and width) - no %s, %l or floating point.
+ *
+ * Dumps are decoded by position in this list: append new events at the
+ * end and never reorder or remove one, or older dumps decode wrongly.
+ */
+#define TRACE_EVENTS(X) \
+    /* Door pipeline */ \
+    X(DOOR_COMMITTED,          "channel %u open %u committed %u us after the first edge (%u bounces)") \
+    X(BATCH_ADD,               "channel %u open %u batched (%u entries)") \
+    X(BATCH_PAIR,              "channel %u open/close pair sent at once") \
+    X(BATCH_HELD,              "channel %u held entry sent (kind %u, %u cycles)") \
+    X(BATCH_TIMER_ARMED,       "channel %u batch timer armed for %u ms (restart %u)") \
+    X(BATCH_TIMER_STOPPED,     "channel %u batch empty, timer stopped") \
+    /* Delivery and ntfy */ \
+    X(NOTIFY_SEND,             "send: %u byte first body, backlog %u") \
+    X(NTFY_CONNECTED,          "ntfy connected") \
+    X(NTFY_HEADERS_SENT,       "ntfy headers sent") \
+    X(NTFY_FINISHED,           "ntfy request finished") \
+    X(NTFY_DISCONNECTED,       "ntfy disconnected") \
+    X(NTFY_REUSE_FAILED,       "ntfy reused connection failed (err 0x%x), reconnecting") \
+    X(NTFY_SENT,               "ntfy sent in %u ms (reused connection %u)") \
+    X(NTFY_BACKLOG_PUSH,       "notification queued for retry (backlog %u)") \
+    /* Presence */ \
+    X(PROBE_DONE,              "probe round: device %d, result %u, %u ms") \
+    X(GAP_NAME_PRESENT,        "device %d present, name answer in %u ms") \
+    X(GAP_NAME_ABSENT,         "device %d absent after %u ms (status %u)") \
+    X(BLE_ADV,                 "device %d advertising at %d dBm") \
+    X(SPP_OPEN,                "device %d SPP open, status %u") \
+    X(SPP_CLOSE,               "device %d SPP closed (handle %u)") \
+    X(SPP_CONGESTED,           "SPP congestion %u") \
+    X(BT_CONTROLLER_CONFIG,    "BT controller status %u, task stack %u, prio %u, mode %u") \
+    X(BT_MEM_RELEASED,         "BT controller memory released (err 0x%x)") \
+    X(BT_CONTROLLER_INIT,      "BT controller initialized") \
+    X(BT_CONTROLLER_ENABLED,   "BT controller enabled") \
+    X(BLUEDROID_INIT,          "Bluedroid initialized") \
+    X(BLUEDROID_ENABLED,       "Bluedroid enabled") \
+    X(SPP_CALLBACK_REGISTERED, "SPP callback registered") \
+    X(SPP_INIT,                "SPP init requested") \
+    X(SPP_READY,               "SPP stack ready") \
+    /* MQTT delivery */ \
+    X(MQTT_CONNECTED,          "MQTT connected (session present %u)") \
+    X(MQTT_DISCONNECTED,       "MQTT disconnected") \
+    X(MQTT_PUBLISH,            "MQTT publish msg %d, %u bytes") \
+    X(MQTT_PUBACK,             "MQTT puback msg %d")
+
+typedef enum {
+#define TRACE_EVENT_ID(name, format) TRACE_##name,
+    TRACE_EVENTS(TRACE_EVENT_ID)
+#undef TRACE_EVENT_ID
+    TRACE_EVENT_COUNT
+} trace_event_t;
@@ -0,0 +1,73 @@
+#include "trace_ring.h"
+
+/**
+ * Use a word buffer as an empty ring
+ */
+void trace_ring_init(trace_ring_t* ring, uint32_t* words, size_t size_words) {
+    size_t capacity = 1;
+    while (capacity * 2 <= size_words) {
+        capacity *= 2;
+    }
+    ring->words = words;
+    ring->mask = (uint32_t)capacity - 1;
+    trace_ring_clear(ring);
+}
+
+/**
+ * Drop every record
+ */
+void trace_ring_clear(trace_ring_t* ring) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overwritten = 0;
+}
+
+/**
+ * Length in words of the record starting at index
+ */
+static uint32_t record_words(const trace_ring_t* ring, uint32_t index) {
+    return 2 + TRACE_RING_HEADER_NARGS(ring->words[index & ring->mask]);
+}
+
+/**
+ * Append a record, overwriting the oldest ones if needed
+ */
+void trace_ring_write(trace_ring_t* ring, uint32_t timestamp_us, uint16_t id, const uint32_t* args, unsigned nargs) {
+    if (nargs > TRACE_RING_MAX_ARGS) {
+        nargs = TRACE_RING_MAX_ARGS;
+    }
+    uint32_t need = 2 + nargs;
+
+    while (ring->head - ring->tail + need > ring->mask + 1) {
+        ring->tail += record_words(ring, ring->tail);
+        ring->overwritten++;
+    }
+
+    ring->words[ring->head++ & ring->mask] = TRACE_RING_HEADER(id, nargs);
+    ring->words[ring->head++ & ring->mask] = timestamp_us;
+    for (unsigned i = 0; i < nargs; i++) {
+        ring->words[ring->head++ & ring->mask] = args[i];
+    }
+}
+
+/**
+ * Copy whole records starting at *cursor, stopping at end or when out is full
+ */
+size_t trace_ring_read(const trace_ring_t* ring, uint32_t* cursor, uint32_t end, uint32_t* out, size_t max_words) {
+    if ((int32_t)(*cursor - ring->tail) < 0) {
+        *cursor = ring->tail;
+    }
+
+    size_t copied = 0;
+    while ((int32_t)(end - *cursor) > 0 && (int32_t)(ring->head - *cursor) > 0) {
+        uint32_t len = record_words(ring, *cursor);
+        if (copied + len > max_words) {
+            break;
+        }
+        for (uint32_t i = 0; i < len; i++) {
+            out[copied++] = ring->words[(*cursor + i) & ring->mask];
+        }
+        *cursor += len;
+    }
+    return copied;
+}
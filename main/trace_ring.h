@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Ring of binary trace records.
+ *
+ * A record is a header word (event ID and argument count), a timestamp
+ * word and up to TRACE_RING_MAX_ARGS raw 32-bit arguments. Nothing is
+ * formatted on the device: the format string for each event ID lives only
+ * in the host decoder. When the ring is full the oldest whole records are
+ * overwritten, so it always holds the most recent history.
+ *
+ * Head and tail are free-running word counters masked on access. The
+ * caller serialises writers and readers; this file is pure C with no
+ * ESP-IDF dependencies so it also builds on a host.
+ */
+
+#define TRACE_RING_MAX_ARGS 4
+#define TRACE_RING_RECORD_MAX_WORDS (2 + TRACE_RING_MAX_ARGS)
+
+// Header word layout
+#define TRACE_RING_HEADER(id, nargs) ((uint32_t)(id) | ((uint32_t)(nargs) << 16))
+#define TRACE_RING_HEADER_ID(header) ((uint16_t)((header) & 0xFFFF))
+#define TRACE_RING_HEADER_NARGS(header) (((header) >> 16) & 0xFF)
+
+// Dump layout: these header words, then the records oldest first, all
+// 32-bit little-endian
+#define TRACE_DUMP_MAGIC 0x31435254     // "TRC1"
+#define TRACE_DUMP_HEADER_WORDS 5       // Magic, event count, now_us low, now_us high, overwritten records
+
+typedef struct {
+    uint32_t* words;
+    uint32_t mask;          // Capacity in words minus one
+    uint32_t head;          // Next word to write
+    uint32_t tail;          // First word of the oldest record
+    uint32_t overwritten;   // Records lost to wraparound
+} trace_ring_t;
+
+/**
+ * Use a word buffer as an empty ring - only the largest power of two
+ * words that fits is used
+ */
+void trace_ring_init(trace_ring_t* ring, uint32_t* words, size_t size_words);
+
+/**
+ * Drop every record
+ */
+void trace_ring_clear(trace_ring_t* ring);
+
+/**
+ * Append a record, overwriting the oldest ones if needed
+ * @param nargs Argument count, extra arguments beyond TRACE_RING_MAX_ARGS are dropped
+ */
+void trace_ring_write(trace_ring_t* ring, uint32_t timestamp_us, uint16_t id, const uint32_t* args, unsigned nargs);
+
+/**
+ * Copy whole records starting at *cursor, stopping at end or when out is full
+ *
+ * A cursor the writer has overtaken restarts at the oldest record. Start a
+ * read with *cursor = ring->tail and end = ring->head, then call repeatedly
+ * until it returns 0 - the ring may be written between calls.
+ * @return Words copied
+ */
+size_t trace_ring_read(const trace_ring_t* ring, uint32_t* cursor, uint32_t end, uint32_t* out, size_t max_words);
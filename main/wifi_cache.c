@@ -0,0 +1,105 @@
+#include "wifi_cache.h"
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+
+#define WIFI_CACHE_NAMESPACE "wifi_cache"
+#define WIFI_CACHE_KEY "assoc"
+
+static const char* TAG = "WIFI_CACHE";
+
+// RAM copy of what is in NVS, so unchanged values are never rewritten
+static wifi_cache_t cached;
+static bool cached_valid = false;
+
+/**
+ * Load the cached association
+ */
+bool wifi_cache_load(wifi_cache_t* cache) {
+    nvs_handle_t handle;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+
+    size_t len = sizeof(cached);
+    esp_err_t ret = nvs_get_blob(handle, WIFI_CACHE_KEY, &cached, &len);
+    nvs_close(handle);
+
+    // A blob of another size was written by an older layout - ignore it
+    cached_valid = (ret == ESP_OK && len == sizeof(cached));
+    if (cached_valid) {
+        *cache = cached;
+    }
+    return cached_valid;
+}
+
+/**
+ * Copy of the association as last loaded or saved, without reading NVS
+ */
+bool wifi_cache_get(wifi_cache_t* cache) {
+    if (cached_valid) {
+        *cache = cached;
+    }
+    return cached_valid;
+}
+
+/**
+ * Write the RAM copy to NVS
+ */
+static void wifi_cache_store(const wifi_cache_t* cache) {
+    if (cached_valid && memcmp(cache, &cached, sizeof(cached)) == 0) {
+        return;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    ret = nvs_set_blob(handle, WIFI_CACHE_KEY, cache, sizeof(*cache));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save WiFi cache: %s", esp_err_to_name(ret));
+        return;
+    }
+    cached = *cache;
+    cached_valid = true;
+}
+
+/**
+ * Remember the access point the station associated with
+ */
+void wifi_cache_save_ap(const uint8_t bssid[6], uint8_t channel) {
+    wifi_cache_t cache = cached_valid ? cached : (wifi_cache_t){0};
+
+    // A different AP most likely means a different subnet too
+    if (memcmp(cache.bssid, bssid, sizeof(cache.bssid)) != 0) {
+        cache.has_ip = 0;
+    }
+    memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+    cache.channel = channel;
+    wifi_cache_store(&cache);
+}
+
+/**
+ * Remember the IP configuration handed out by DHCP
+ */
+void wifi_cache_save_ip(uint32_t ip, uint32_t netmask, uint32_t gw, uint32_t dns) {
+    if (!cached_valid) {
+        return;     // Always follows wifi_cache_save_ap()
+    }
+
+    wifi_cache_t cache = cached;
+    cache.has_ip = 1;
+    cache.ip = ip;
+    cache.netmask = netmask;
+    cache.gw = gw;
+    cache.dns = dns;
+    wifi_cache_store(&cache);
+}
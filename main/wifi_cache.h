@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Last known good WiFi association, kept in NVS.
+ *
+ * Remembering the access point's BSSID and channel lets the station skip
+ * the scan, and remembering the IP lease lets it skip DHCP, on the next
+ * boot, wake or reconnect. Values are only written when they change.
+ */
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t has_ip;             // ip/netmask/gw/dns below are valid
+    uint32_t ip;                // IPv4 addresses in network byte order
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_cache_t;
+
+/**
+ * Load the cached association
+ * @return false if nothing has been cached yet
+ */
+bool wifi_cache_load(wifi_cache_t* cache);
+
+/**
+ * Copy of the association as last loaded or saved, without reading NVS
+ * @return false if nothing has been cached yet
+ */
+bool wifi_cache_get(wifi_cache_t* cache);
+
+/**
+ * Remember the access point the station associated with
+ */
+void wifi_cache_save_ap(const uint8_t bssid[6], uint8_t channel);
+
+/**
+ * Remember the IP configuration handed out by DHCP
+ */
+void wifi_cache_save_ip(uint32_t ip, uint32_t netmask, uint32_t gw, uint32_t dns);